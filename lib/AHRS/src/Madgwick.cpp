@@ -45,181 +45,151 @@ Madgwick::Madgwick() {
 }
 
 void Madgwick::update(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz) {
-	float recipNorm;
-	float s0, s1, s2, s3;
-	float qDot1, qDot2, qDot3, qDot4;
-	float hx, hy;
-	float _2q0mx, _2q0my, _2q0mz, _2q1mx, _2bx, _2bz, _4bx, _4bz, _2q0, _2q1, _2q2, _2q3, _2q0q2, _2q2q3, q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;
-
 	// Use IMU algorithm if magnetometer measurement invalid (avoids NaN in magnetometer normalisation)
 	if((mx == 0.0f) && (my == 0.0f) && (mz == 0.0f)) {
 		update(gx, gy, gz, ax, ay, az);
 		return;
 	}
 
-	// Convert gyroscope degrees/sec to radians/sec
-	//gx *= 0.0174533f;
-	//gy *= 0.0174533f;
-	//gz *= 0.0174533f;
-
-	// Rate of change of quaternion from gyroscope
-	qDot1 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
-	qDot2 = 0.5f * ( q0 * gx + q2 * gz - q3 * gy);
-	qDot3 = 0.5f * ( q0 * gy - q1 * gz + q3 * gx);
-	qDot4 = 0.5f * ( q0 * gz + q1 * gy - q2 * gx);
+	// Quaternion increment from gyroscope, half step pre-multiplied
+	const float h = 0.5f * invSampleFreq;
+	gx *= h;
+	gy *= h;
+	gz *= h;
+	float d0 = -q1 * gx - q2 * gy - q3 * gz;
+	float d1 =  q0 * gx + q2 * gz - q3 * gy;
+	float d2 =  q0 * gy - q1 * gz + q3 * gx;
+	float d3 =  q0 * gz + q1 * gy - q2 * gx;
 
 	// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
 	if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
 
-		// Normalise accelerometer measurement
-		recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+		// Normalise accelerometer and magnetometer measurement
+		float recipNorm = invSqrt(ax * ax + ay * ay + az * az);
 		ax *= recipNorm;
 		ay *= recipNorm;
 		az *= recipNorm;
-
-		// Normalise magnetometer measurement
 		recipNorm = invSqrt(mx * mx + my * my + mz * mz);
 		mx *= recipNorm;
 		my *= recipNorm;
 		mz *= recipNorm;
 
 		// Auxiliary variables to avoid repeated arithmetic
-		_2q0mx = 2.0f * q0 * mx;
-		_2q0my = 2.0f * q0 * my;
-		_2q0mz = 2.0f * q0 * mz;
-		_2q1mx = 2.0f * q1 * mx;
-		_2q0 = 2.0f * q0;
-		_2q1 = 2.0f * q1;
-		_2q2 = 2.0f * q2;
-		_2q3 = 2.0f * q3;
-		_2q0q2 = 2.0f * q0 * q2;
-		_2q2q3 = 2.0f * q2 * q3;
-		q0q0 = q0 * q0;
-		q0q1 = q0 * q1;
-		q0q2 = q0 * q2;
-		q0q3 = q0 * q3;
-		q1q1 = q1 * q1;
-		q1q2 = q1 * q2;
-		q1q3 = q1 * q3;
-		q2q2 = q2 * q2;
-		q2q3 = q2 * q3;
-		q3q3 = q3 * q3;
+		const float q0q1 = q0 * q1;
+		const float q0q2 = q0 * q2;
+		const float q0q3 = q0 * q3;
+		const float q1q1 = q1 * q1;
+		const float q1q2 = q1 * q2;
+		const float q1q3 = q1 * q3;
+		const float q2q2 = q2 * q2;
+		const float q2q3 = q2 * q3;
+		const float q3q3 = q3 * q3;
+
+		// Rotation matrix terms shared by gravity, earth field and objective function
+		const float r00 = 0.5f - q2q2 - q3q3;
+		const float r01 = q1q2 - q0q3;
+		const float r02 = q1q3 + q0q2;
+		const float r10 = q1q2 + q0q3;
+		const float r11 = 0.5f - q1q1 - q3q3;
+		const float r12 = q2q3 - q0q1;
+		const float r20 = q1q3 - q0q2;
+		const float r21 = q2q3 + q0q1;
+		const float r22 = 0.5f - q1q1 - q2q2;
 
 		// Reference direction of Earth's magnetic field
-		hx = mx * q0q0 - _2q0my * q3 + _2q0mz * q2 + mx * q1q1 + _2q1 * my * q2 + _2q1 * mz * q3 - mx * q2q2 - mx * q3q3;
-		hy = _2q0mx * q3 + my * q0q0 - _2q0mz * q1 + _2q1mx * q2 - my * q1q1 + my * q2q2 + _2q2 * mz * q3 - my * q3q3;
-		_2bx = sqrtf(hx * hx + hy * hy);
-		_2bz = -_2q0mx * q2 + _2q0my * q1 + mz * q0q0 + _2q1mx * q3 - mz * q1q1 + _2q2 * my * q3 - mz * q2q2 + mz * q3q3;
-		_4bx = 2.0f * _2bx;
-		_4bz = 2.0f * _2bz;
-
-		// Gradient decent algorithm corrective step
-		s0 = -_2q2 * (2.0f * q1q3 - _2q0q2 - ax) + _2q1 * (2.0f * q0q1 + _2q2q3 - ay) - _2bz * q2 * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) + (-_2bx * q3 + _2bz * q1) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) + _2bx * q2 * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
-		s1 = _2q3 * (2.0f * q1q3 - _2q0q2 - ax) + _2q0 * (2.0f * q0q1 + _2q2q3 - ay) - 4.0f * q1 * (1 - 2.0f * q1q1 - 2.0f * q2q2 - az) + _2bz * q3 * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) + (_2bx * q2 + _2bz * q0) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) + (_2bx * q3 - _4bz * q1) * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
-		s2 = -_2q0 * (2.0f * q1q3 - _2q0q2 - ax) + _2q3 * (2.0f * q0q1 + _2q2q3 - ay) - 4.0f * q2 * (1 - 2.0f * q1q1 - 2.0f * q2q2 - az) + (-_4bx * q2 - _2bz * q0) * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) + (_2bx * q1 + _2bz * q3) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) + (_2bx * q0 - _4bz * q2) * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
-		s3 = _2q1 * (2.0f * q1q3 - _2q0q2 - ax) + _2q2 * (2.0f * q0q1 + _2q2q3 - ay) + (-_4bx * q3 + _2bz * q1) * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) + (-_2bx * q0 + _2bz * q2) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) + _2bx * q1 * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
-		recipNorm = invSqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3); // normalise step magnitude
-		s0 *= recipNorm;
-		s1 *= recipNorm;
-		s2 *= recipNorm;
-		s3 *= recipNorm;
-
-		// Apply feedback step
-		qDot1 -= beta * s0;
-		qDot2 -= beta * s1;
-		qDot3 -= beta * s2;
-		qDot4 -= beta * s3;
+		const float hx = 2.0f * (mx * r00 + my * r01 + mz * r02);
+		const float hy = 2.0f * (mx * r10 + my * r11 + mz * r12);
+		const float _2bx = sqrtf(hx * hx + hy * hy);
+		const float _2bz = 2.0f * (mx * r20 + my * r21 + mz * r22);
+		const float _4bx = 2.0f * _2bx;
+		const float _4bz = 2.0f * _2bz;
+
+		// Objective function, evaluated once instead of per gradient term
+		const float fg0 = 2.0f * r20 - ax;
+		const float fg1 = 2.0f * r21 - ay;
+		const float fg2 = 2.0f * r22 - az;
+		const float fb0 = _2bx * r00 + _2bz * r20 - mx;
+		const float fb1 = _2bx * r01 + _2bz * r21 - my;
+		const float fb2 = _2bx * r02 + _2bz * r22 - mz;
+		const float _2q0 = 2.0f * q0;
+		const float _2q1 = 2.0f * q1;
+		const float _2q2 = 2.0f * q2;
+		const float _2q3 = 2.0f * q3;
+
+		// Gradient decent algorithm corrective step, J' f
+		float s0 = -_2q2 * fg0 + _2q1 * fg1 - _2bz * q2 * fb0 + (-_2bx * q3 + _2bz * q1) * fb1 + _2bx * q2 * fb2;
+		float s1 =  _2q3 * fg0 + _2q0 * fg1 - 2.0f * _2q1 * fg2 + _2bz * q3 * fb0 + (_2bx * q2 + _2bz * q0) * fb1 + (_2bx * q3 - _4bz * q1) * fb2;
+		float s2 = -_2q0 * fg0 + _2q3 * fg1 - 2.0f * _2q2 * fg2 + (-_4bx * q2 - _2bz * q0) * fb0 + (_2bx * q1 + _2bz * q3) * fb1 + (_2bx * q0 - _4bz * q2) * fb2;
+		float s3 =  _2q1 * fg0 + _2q2 * fg1 + (-_4bx * q3 + _2bz * q1) * fb0 + (-_2bx * q0 + _2bz * q2) * fb1 + _2bx * q1 * fb2;
+
+		// Apply normalised feedback step
+		const float norm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+		if(norm > 0.0f) {
+			const float step = beta * invSampleFreq * invSqrt(norm);
+			d0 -= step * s0;
+			d1 -= step * s1;
+			d2 -= step * s2;
+			d3 -= step * s3;
+		}
 	}
 
-	// Integrate rate of change of quaternion to yield quaternion
-	q0 += qDot1 * invSampleFreq;
-	q1 += qDot2 * invSampleFreq;
-	q2 += qDot3 * invSampleFreq;
-	q3 += qDot4 * invSampleFreq;
-
-	// Normalise quaternion
-	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
-	q0 *= recipNorm;
-	q1 *= recipNorm;
-	q2 *= recipNorm;
-	q3 *= recipNorm;
-	anglesComputed = 0;
+	integrate(d0, d1, d2, d3);
 }
 
 //-------------------------------------------------------------------------------------------
 // IMU algorithm update
 
 void Madgwick::update(float gx, float gy, float gz, float ax, float ay, float az) {
-	float recipNorm;
-	float s0, s1, s2, s3;
-	float qDot1 = 0, qDot2 = 0, qDot3 = 0, qDot4 = 0;
-	float _2q0, _2q1, _2q2, _2q3, _4q0, _4q1, _4q2 ,_8q1, _8q2, q0q0, q1q1, q2q2, q3q3;
-
-	// Convert gyroscope degrees/sec to radians/sec
-	//gx *= 0.0174533f;
-	//gy *= 0.0174533f;
-	//gz *= 0.0174533f;
-
-	bool hasGyro  = !((gx == 0.0f) && (gy == 0.0f) && (gz == 0.0f));
-	bool hasAccel = !((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f));
-
-	// Rate of change of quaternion from gyroscope
-	if(hasGyro) {
-		qDot1 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
-		qDot2 = 0.5f * ( q0 * gx + q2 * gz - q3 * gy);
-		qDot3 = 0.5f * ( q0 * gy - q1 * gz + q3 * gx);
-		qDot4 = 0.5f * ( q0 * gz + q1 * gy - q2 * gx);
-	}
+	// Quaternion increment from gyroscope, half step pre-multiplied, zero rate gives zero increment
+	const float h = 0.5f * invSampleFreq;
+	gx *= h;
+	gy *= h;
+	gz *= h;
+	float d0 = -q1 * gx - q2 * gy - q3 * gz;
+	float d1 =  q0 * gx + q2 * gz - q3 * gy;
+	float d2 =  q0 * gy - q1 * gz + q3 * gx;
+	float d3 =  q0 * gz + q1 * gy - q2 * gx;
 
 	// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
-	if(hasAccel) {
+	if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
 		// Normalise accelerometer measurement
-		recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+		const float recipNorm = invSqrt(ax * ax + ay * ay + az * az);
 		ax *= recipNorm;
 		ay *= recipNorm;
 		az *= recipNorm;
 
-		// Auxiliary variables to avoid repeated arithmetic
-		_2q0 = 2.0f * q0;
-		_2q1 = 2.0f * q1;
-		_2q2 = 2.0f * q2;
-		_2q3 = 2.0f * q3;
-		_4q0 = 4.0f * q0;
-		_4q1 = 4.0f * q1;
-		_4q2 = 4.0f * q2;
-		_8q1 = 8.0f * q1;
-		_8q2 = 8.0f * q2;
-		q0q0 = q0 * q0;
-		q1q1 = q1 * q1;
-		q2q2 = q2 * q2;
-		q3q3 = q3 * q3;
-
-		// Gradient decent algorithm corrective step
-		s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
-		s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
-		s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
-		s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
-		recipNorm = invSqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3); // normalise step magnitude
-		s0 *= recipNorm;
-		s1 *= recipNorm;
-		s2 *= recipNorm;
-		s3 *= recipNorm;
-
-		// Apply feedback step
-		qDot1 -= beta * s0;
-		qDot2 -= beta * s1;
-		qDot3 -= beta * s2;
-		qDot4 -= beta * s3;
+		// Gradient decent algorithm corrective step, factored form,
+		// common factor 2 dropped as step is normalised
+		const float k = q1 * q1 + q2 * q2;
+		const float c = q0 * q0 + q3 * q3 + 2.0f * k + az - 1.0f;
+		const float s0 = 2.0f * q0 * k + q2 * ax - q1 * ay;
+		const float s1 = 2.0f * q1 * c - q3 * ax - q0 * ay;
+		const float s2 = 2.0f * q2 * c + q0 * ax - q3 * ay;
+		const float s3 = 2.0f * q3 * k - q1 * ax - q2 * ay;
+
+		// Apply normalised feedback step
+		const float norm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+		if(norm > 0.0f) {
+			const float step = beta * invSampleFreq * invSqrt(norm);
+			d0 -= step * s0;
+			d1 -= step * s1;
+			d2 -= step * s2;
+			d3 -= step * s3;
+		}
 	}
 
-	// Integrate rate of change of quaternion to yield quaternion
-	q0 += qDot1 * invSampleFreq;
-	q1 += qDot2 * invSampleFreq;
-	q2 += qDot3 * invSampleFreq;
-	q3 += qDot4 * invSampleFreq;
+	integrate(d0, d1, d2, d3);
+}
 
-	// Normalise quaternion
-	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+//-------------------------------------------------------------------------------------------
+// Apply increment, quaternion stays close to unit length so single newton step renormalises it
+
+void Madgwick::integrate(float d0, float d1, float d2, float d3) {
+	q0 += d0;
+	q1 += d1;
+	q2 += d2;
+	q3 += d3;
+	const float recipNorm = invSqrtNearOne(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
 	q0 *= recipNorm;
 	q1 *= recipNorm;
 	q2 *= recipNorm;
@@ -30,6 +30,7 @@ class Madgwick {
     bool anglesComputed;
 
     void computeAngles();
+    void integrate(float d0, float d1, float d2, float d3);
 
 //-------------------------------------------------------------------------------------------
 // Function declarations
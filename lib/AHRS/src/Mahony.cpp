@@ -53,13 +53,6 @@ Mahony::Mahony()
 
 void Mahony::update(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz)
 {
-	float recipNorm;
-	float q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;
-	float hx, hy, bx, bz;
-	float halfvx, halfvy, halfvz, halfwx, halfwy, halfwz;
-	float halfex, halfey, halfez;
-	float qa, qb, qc;
-
 	// Use IMU algorithm if magnetometer measurement invalid
 	// (avoids NaN in magnetometer normalisation)
 	if((mx == 0.0f) && (my == 0.0f) && (mz == 0.0f)) {
@@ -67,99 +60,63 @@ void Mahony::update(float gx, float gy, float gz, float ax, float ay, float az,
 		return;
 	}
 
-	// Convert gyroscope degrees/sec to radians/sec
-	//gx *= 0.0174533f;
-	//gy *= 0.0174533f;
-	//gz *= 0.0174533f;
-
 	// Compute feedback only if accelerometer measurement valid
 	// (avoids NaN in accelerometer normalisation)
 	if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
 
-		// Normalise accelerometer measurement
-		recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+		// Normalise accelerometer and magnetometer measurement
+		float recipNorm = invSqrt(ax * ax + ay * ay + az * az);
 		ax *= recipNorm;
 		ay *= recipNorm;
 		az *= recipNorm;
-
-		// Normalise magnetometer measurement
 		recipNorm = invSqrt(mx * mx + my * my + mz * mz);
 		mx *= recipNorm;
 		my *= recipNorm;
 		mz *= recipNorm;
 
 		// Auxiliary variables to avoid repeated arithmetic
-		q0q0 = q0 * q0;
-		q0q1 = q0 * q1;
-		q0q2 = q0 * q2;
-		q0q3 = q0 * q3;
-		q1q1 = q1 * q1;
-		q1q2 = q1 * q2;
-		q1q3 = q1 * q3;
-		q2q2 = q2 * q2;
-		q2q3 = q2 * q3;
-		q3q3 = q3 * q3;
+		const float q0q1 = q0 * q1;
+		const float q0q2 = q0 * q2;
+		const float q0q3 = q0 * q3;
+		const float q1q1 = q1 * q1;
+		const float q1q2 = q1 * q2;
+		const float q1q3 = q1 * q3;
+		const float q2q2 = q2 * q2;
+		const float q2q3 = q2 * q3;
+		const float q3q3 = q3 * q3;
+
+		// Half rotation matrix rows, shared by field reference and estimate
+		const float r00 = 0.5f - q2q2 - q3q3;
+		const float r01 = q1q2 - q0q3;
+		const float r02 = q1q3 + q0q2;
+		const float r10 = q1q2 + q0q3;
+		const float r11 = 0.5f - q1q1 - q3q3;
+		const float r12 = q2q3 - q0q1;
+		const float halfvx = q1q3 - q0q2;
+		const float halfvy = q0q1 + q2q3;
+		const float halfvz = 0.5f - q1q1 - q2q2;
 
 		// Reference direction of Earth's magnetic field
-		hx = 2.0f * (mx * (0.5f - q2q2 - q3q3) + my * (q1q2 - q0q3) + mz * (q1q3 + q0q2));
-		hy = 2.0f * (mx * (q1q2 + q0q3) + my * (0.5f - q1q1 - q3q3) + mz * (q2q3 - q0q1));
-		bx = sqrtf(hx * hx + hy * hy);
-		bz = 2.0f * (mx * (q1q3 - q0q2) + my * (q2q3 + q0q1) + mz * (0.5f - q1q1 - q2q2));
-
-		// Estimated direction of gravity and magnetic field
-		halfvx = q1q3 - q0q2;
-		halfvy = q0q1 + q2q3;
-		halfvz = q0q0 - 0.5f + q3q3;
-		halfwx = bx * (0.5f - q2q2 - q3q3) + bz * (q1q3 - q0q2);
-		halfwy = bx * (q1q2 - q0q3) + bz * (q0q1 + q2q3);
-		halfwz = bx * (q0q2 + q1q3) + bz * (0.5f - q1q1 - q2q2);
+		const float hx = 2.0f * (mx * r00 + my * r01 + mz * r02);
+		const float hy = 2.0f * (mx * r10 + my * r11 + mz * r12);
+		const float bx = sqrtf(hx * hx + hy * hy);
+		const float bz = 2.0f * (mx * halfvx + my * halfvy + mz * halfvz);
+
+		// Estimated direction of magnetic field, gravity is halfv
+		const float halfwx = bx * r00 + bz * halfvx;
+		const float halfwy = bx * r01 + bz * halfvy;
+		const float halfwz = bx * r02 + bz * halfvz;
 
 		// Error is sum of cross product between estimated direction
 		// and measured direction of field vectors
-		halfex = (ay * halfvz - az * halfvy) + (my * halfwz - mz * halfwy);
-		halfey = (az * halfvx - ax * halfvz) + (mz * halfwx - mx * halfwz);
-		halfez = (ax * halfvy - ay * halfvx) + (mx * halfwy - my * halfwx);
-
-		// Compute and apply integral feedback if enabled
-		if(twoKi > 0.0f) {
-			// integral error scaled by Ki
-			integralFBx += twoKi * halfex * invSampleFreq;
-			integralFBy += twoKi * halfey * invSampleFreq;
-			integralFBz += twoKi * halfez * invSampleFreq;
-			gx += integralFBx;	// apply integral feedback
-			gy += integralFBy;
-			gz += integralFBz;
-		} else {
-			integralFBx = 0.0f;	// prevent integral windup
-			integralFBy = 0.0f;
-			integralFBz = 0.0f;
-		}
-
-		// Apply proportional feedback
-		gx += twoKp * halfex;
-		gy += twoKp * halfey;
-		gz += twoKp * halfez;
-	}
+		const float halfex = (ay * halfvz - az * halfvy) + (my * halfwz - mz * halfwy);
+		const float halfey = (az * halfvx - ax * halfvz) + (mz * halfwx - mx * halfwz);
+		const float halfez = (ax * halfvy - ay * halfvx) + (mx * halfwy - my * halfwx);
 
-	// Integrate rate of change of quaternion
-	gx *= (0.5f * invSampleFreq);		// pre-multiply common factors
-	gy *= (0.5f * invSampleFreq);
-	gz *= (0.5f * invSampleFreq);
-	qa = q0;
-	qb = q1;
-	qc = q2;
-	q0 += (-qb * gx - qc * gy - q3 * gz);
-	q1 += (qa * gx + qc * gz - q3 * gy);
-	q2 += (qa * gy - qb * gz + q3 * gx);
-	q3 += (qa * gz + qb * gy - qc * gx);
+		feedback(halfex, halfey, halfez, gx, gy, gz);
+	}
 
-	// Normalise quaternion
-	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
-	q0 *= recipNorm;
-	q1 *= recipNorm;
-	q2 *= recipNorm;
-	q3 *= recipNorm;
-	anglesComputed = 0;
+	integrate(gx, gy, gz);
 }
 
 //-------------------------------------------------------------------------------------------
@@ -167,74 +124,80 @@ void Mahony::update(float gx, float gy, float gz, float ax, float ay, float az,
 
 void Mahony::update(float gx, float gy, float gz, float ax, float ay, float az)
 {
-	float recipNorm;
-	float halfvx, halfvy, halfvz;
-	float halfex, halfey, halfez;
-	float qa, qb, qc;
-
-	// Convert gyroscope degrees/sec to radians/sec
-	//gx *= 0.0174533f;
-	//gy *= 0.0174533f;
-	//gz *= 0.0174533f;
-
-	bool hasAccel = !((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f));
-
 	// Compute feedback only if accelerometer measurement valid
 	// (avoids NaN in accelerometer normalisation)
-	if(hasAccel) {
+	if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
 
 		// Normalise accelerometer measurement
-		recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+		const float recipNorm = invSqrt(ax * ax + ay * ay + az * az);
 		ax *= recipNorm;
 		ay *= recipNorm;
 		az *= recipNorm;
 
 		// Estimated direction of gravity
-		halfvx = q1 * q3 - q0 * q2;
-		halfvy = q0 * q1 + q2 * q3;
-		halfvz = q0 * q0 - 0.5f + q3 * q3;
+		const float halfvx = q1 * q3 - q0 * q2;
+		const float halfvy = q0 * q1 + q2 * q3;
+		const float halfvz = q0 * q0 - 0.5f + q3 * q3;
 
-		// Error is sum of cross product between estimated
+		// Error is cross product between estimated
 		// and measured direction of gravity
-		halfex = (ay * halfvz - az * halfvy);
-		halfey = (az * halfvx - ax * halfvz);
-		halfez = (ax * halfvy - ay * halfvx);
-
-		// Compute and apply integral feedback if enabled
-		if(twoKi > 0.0f) {
-			// integral error scaled by Ki
-			integralFBx += twoKi * halfex * invSampleFreq;
-			integralFBy += twoKi * halfey * invSampleFreq;
-			integralFBz += twoKi * halfez * invSampleFreq;
-			gx += integralFBx;	// apply integral feedback
-			gy += integralFBy;
-			gz += integralFBz;
-		} else {
-			integralFBx = 0.0f;	// prevent integral windup
-			integralFBy = 0.0f;
-			integralFBz = 0.0f;
-		}
-
-		// Apply proportional feedback
-		gx += twoKp * halfex;
-		gy += twoKp * halfey;
-		gz += twoKp * halfez;
+		const float halfex = (ay * halfvz - az * halfvy);
+		const float halfey = (az * halfvx - ax * halfvz);
+		const float halfez = (ax * halfvy - ay * halfvx);
+
+		feedback(halfex, halfey, halfez, gx, gy, gz);
 	}
 
-	// Integrate rate of change of quaternion
-	gx *= (0.5f * invSampleFreq);		// pre-multiply common factors
-	gy *= (0.5f * invSampleFreq);
-	gz *= (0.5f * invSampleFreq);
-	qa = q0;
-	qb = q1;
-	qc = q2;
+	integrate(gx, gy, gz);
+}
+
+//-------------------------------------------------------------------------------------------
+// Proportional and integral feedback applied to gyro rate
+
+void Mahony::feedback(float halfex, float halfey, float halfez, float& gx, float& gy, float& gz)
+{
+	// Compute and apply integral feedback if enabled
+	if(twoKi > 0.0f) {
+		// integral error scaled by Ki
+		const float k = twoKi * invSampleFreq;
+		integralFBx += k * halfex;
+		integralFBy += k * halfey;
+		integralFBz += k * halfez;
+		gx += integralFBx;	// apply integral feedback
+		gy += integralFBy;
+		gz += integralFBz;
+	} else {
+		integralFBx = 0.0f;	// prevent integral windup
+		integralFBy = 0.0f;
+		integralFBz = 0.0f;
+	}
+
+	// Apply proportional feedback
+	gx += twoKp * halfex;
+	gy += twoKp * halfey;
+	gz += twoKp * halfez;
+}
+
+//-------------------------------------------------------------------------------------------
+// Integrate rate of change of quaternion, quaternion stays close to unit length
+// so single newton step renormalises it
+
+void Mahony::integrate(float gx, float gy, float gz)
+{
+	const float h = 0.5f * invSampleFreq;		// pre-multiply common factors
+	gx *= h;
+	gy *= h;
+	gz *= h;
+	const float qa = q0;
+	const float qb = q1;
+	const float qc = q2;
 	q0 += (-qb * gx - qc * gy - q3 * gz);
 	q1 += (qa * gx + qc * gz - q3 * gy);
 	q2 += (qa * gy - qb * gz + q3 * gx);
 	q3 += (qa * gz + qb * gy - qc * gx);
 
 	// Normalise quaternion
-	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+	const float recipNorm = invSqrtNearOne(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
 	q0 *= recipNorm;
 	q1 *= recipNorm;
 	q2 *= recipNorm;
@@ -29,6 +29,8 @@ private:
 	bool anglesComputed;
 
 	void computeAngles();
+	void feedback(float halfex, float halfey, float halfez, float& gx, float& gy, float& gz);
+	void integrate(float gx, float gy, float gz);
 
 //-------------------------------------------------------------------------------------------
 // Function declarations
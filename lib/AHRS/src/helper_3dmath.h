@@ -3,25 +3,49 @@
 
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 
-// Fast inverse square-root
+// Fast inverse square-root, fixed number of newton iterations
+// max relative error: 1 - 1.8e-3, 2 - 5e-6, 0 falls back to libm
 // See: http://en.wikipedia.org/wiki/Fast_inverse_square_root
-inline float invSqrt(float x)
+#ifndef INV_SQRT_ITERATIONS
+#define INV_SQRT_ITERATIONS 2
+#endif
+
+template<int N>
+inline float invSqrtN(float x)
 {
-  //return 1.f / sqrt(x);
-  #pragma GCC diagnostic push
-  #pragma GCC diagnostic ignored "-Wstrict-aliasing"
-  float halfx = 0.5f * x;
-  float y = x;
-  long i = *(long*)&y;
-  i = 0x5f3759df - (i>>1);
-  y = *(float*)&i;
-  y = y * (1.5f - (halfx * y * y));
-  y = y * (1.5f - (halfx * y * y));
-  #pragma GCC diagnostic pop
+  const float halfx = 0.5f * x;
+  int32_t i;
+  memcpy(&i, &x, sizeof(i));
+  i = 0x5f3759df - (i >> 1);
+  float y;
+  memcpy(&y, &i, sizeof(y));
+  for(int k = 0; k < N; k++)
+  {
+    y = y * (1.5f - (halfx * y * y));
+  }
   return y;
 }
 
+template<>
+inline float invSqrtN<0>(float x)
+{
+  return 1.f / sqrtf(x);
+}
+
+inline float invSqrt(float x)
+{
+  return invSqrtN<INV_SQRT_ITERATIONS>(x);
+}
+
+// Inverse square-root of value close to one, single newton step from 1,
+// error is second order in distance from one, for renormalising after small updates
+inline float invSqrtNearOne(float x)
+{
+  return 1.5f - 0.5f * x;
+}
+
 template<typename T>
 class VectorBase;
 
@@ -304,3 +304,69 @@ uint8_t esp_twi_status(){
     if(!esp_twi_write_start()) return I2C_SDA_HELD_LOW_AFTER_INIT;  //line busy. SDA again held low by another device. 2nd master?
     else                   return I2C_OK;       				//all ok
 }
+
+void esp_twi_xfer_init(esp_twi_xfer_t * xfer, unsigned char address, unsigned char reg, unsigned char * buf, unsigned int len, unsigned char read){
+  xfer->address = address;
+  xfer->reg = reg;
+  xfer->buf = buf;
+  xfer->len = len;
+  xfer->pos = 0;
+  xfer->read = read;
+  xfer->state = ESP_TWI_XFER_START;
+  xfer->error = 0;
+}
+
+static IRAM_ATTR void esp_twi_xfer_fail(esp_twi_xfer_t * xfer, unsigned char error){
+  if(error != 4) esp_twi_write_stop();
+  xfer->error = error;
+  xfer->state = ESP_TWI_XFER_ERROR;
+}
+
+// Executes one bus unit (start+address, or a single data byte) per iteration until budget [us] is exhausted.
+// Master drives the clock, so stalling between bytes is legal, slave simply waits for the next clock.
+// Slice may overrun the budget by at most one byte time, budget 0 runs transfer to the end.
+uint8_t esp_twi_xfer_step(esp_twi_xfer_t * xfer, uint32_t budget){
+  uint32_t start = micros();
+  unsigned int i;
+  do {
+    switch(xfer->state){
+      case ESP_TWI_XFER_START:
+        if(!esp_twi_write_start()) { esp_twi_xfer_fail(xfer, 4); break; } //line busy
+        if(!esp_twi_write_byte(((xfer->address << 1) | 0) & 0xFF)) { esp_twi_xfer_fail(xfer, 2); break; } //received NACK on transmit of address
+        xfer->state = ESP_TWI_XFER_REG;
+        break;
+      case ESP_TWI_XFER_REG:
+        if(!esp_twi_write_byte(xfer->reg)) { esp_twi_xfer_fail(xfer, 3); break; } //received NACK on transmit of data
+        xfer->state = xfer->read ? ESP_TWI_XFER_RESTART : (xfer->len ? ESP_TWI_XFER_WRITE : ESP_TWI_XFER_STOP);
+        break;
+      case ESP_TWI_XFER_WRITE:
+        if(!esp_twi_write_byte(xfer->buf[xfer->pos])) { esp_twi_xfer_fail(xfer, 3); break; }
+        if(++xfer->pos >= xfer->len) xfer->state = ESP_TWI_XFER_STOP;
+        break;
+      case ESP_TWI_XFER_RESTART:
+        esp_twi_write_stop();
+        if(!esp_twi_write_start()) { esp_twi_xfer_fail(xfer, 4); break; }
+        if(!esp_twi_write_byte(((xfer->address << 1) | 1) & 0xFF)) { esp_twi_xfer_fail(xfer, 2); break; }
+        xfer->state = xfer->len ? ESP_TWI_XFER_READ : ESP_TWI_XFER_STOP;
+        break;
+      case ESP_TWI_XFER_READ:
+        xfer->buf[xfer->pos] = esp_twi_read_byte(xfer->pos + 1 >= xfer->len);
+        if(++xfer->pos >= xfer->len) xfer->state = ESP_TWI_XFER_STOP;
+        break;
+      case ESP_TWI_XFER_STOP:
+        esp_twi_write_stop();
+        i = 0;
+        while(SDA_READ() == 0 && (i++) < 10){
+          SCL_LOW();
+          esp_twi_delay(esp_twi_dcount);
+          SCL_HIGH();
+          esp_twi_delay(esp_twi_dcount);
+        }
+        xfer->state = ESP_TWI_XFER_DONE;
+        break;
+      default:
+        return xfer->state;
+    }
+  } while(xfer->state < ESP_TWI_XFER_DONE && (budget == 0 || micros() - start < budget));
+  return xfer->state;
+}
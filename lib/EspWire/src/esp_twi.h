@@ -32,6 +32,28 @@ extern "C" {
 #define I2C_SDA_HELD_LOW            3
 #define I2C_SDA_HELD_LOW_AFTER_INIT 4
 
+#define ESP_TWI_XFER_IDLE           0
+#define ESP_TWI_XFER_START          1
+#define ESP_TWI_XFER_REG            2
+#define ESP_TWI_XFER_WRITE          3
+#define ESP_TWI_XFER_RESTART        4
+#define ESP_TWI_XFER_READ           5
+#define ESP_TWI_XFER_STOP           6
+#define ESP_TWI_XFER_DONE           7
+#define ESP_TWI_XFER_ERROR          8
+
+// register transfer that can be advanced in slices, one bus byte at a time
+typedef struct {
+  unsigned char address;
+  unsigned char reg;
+  unsigned char * buf;
+  unsigned int len;
+  unsigned int pos;
+  unsigned char read;
+  unsigned char state;
+  unsigned char error;
+} esp_twi_xfer_t;
+
 void esp_twi_init(unsigned char sda, unsigned char scl);
 void esp_twi_stop(void);
 void esp_twi_setClock(unsigned int freq);
@@ -39,6 +61,8 @@ void esp_twi_setClockStretchLimit(uint32_t limit);
 uint8_t esp_twi_writeTo(unsigned char address, unsigned char * buf, unsigned int len, unsigned char sendStop) IRAM_ATTR;
 uint8_t esp_twi_readFrom(unsigned char address, unsigned char * buf, unsigned int len, unsigned char sendStop) IRAM_ATTR;
 uint8_t esp_twi_status();
+void esp_twi_xfer_init(esp_twi_xfer_t * xfer, unsigned char address, unsigned char reg, unsigned char * buf, unsigned int len, unsigned char read);
+uint8_t esp_twi_xfer_step(esp_twi_xfer_t * xfer, uint32_t budget) IRAM_ATTR;
 
 #ifdef __cplusplus
 }
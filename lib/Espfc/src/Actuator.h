@@ -59,10 +59,13 @@ class Actuator
           )
           {
 
-            if(mode & ACT_INNER_P) _model.state.innerPid[x].pScale = scale;
-            if(mode & ACT_INNER_I) _model.state.innerPid[x].iScale = scale;
-            if(mode & ACT_INNER_D) _model.state.innerPid[x].dScale = scale;
-            if(mode & ACT_INNER_F) _model.state.innerPid[x].fScale = scale;
+            if(x < PidBank::SIZE)
+            {
+              if(mode & ACT_INNER_P) _model.state.innerPid.pScale[x] = scale;
+              if(mode & ACT_INNER_I) _model.state.innerPid.iScale[x] = scale;
+              if(mode & ACT_INNER_D) _model.state.innerPid.dScale[x] = scale;
+              if(mode & ACT_INNER_F) _model.state.innerPid.fScale[x] = scale;
+            }
 
             if(mode & ACT_OUTER_P) _model.state.outerPid[x].pScale = scale;
             if(mode & ACT_OUTER_I) _model.state.outerPid[x].iScale = scale;
@@ -139,6 +142,7 @@ class Actuator
         case MODE_ARMED:
           return !_model.armingDisabled() && _model.isThrottleLow();
         case MODE_ANGLE:
+        case MODE_HORIZON:
           return _model.accelActive();
         case MODE_AIRMODE:
           return _model.state.airmodeAllowed;
@@ -209,7 +213,7 @@ class Actuator
       if(_model.config.dtermDynLpfFilter.cutoff > 0) {
         int dtermFreq = Math::map(scale, 1000, 2000, _model.config.dtermDynLpfFilter.cutoff, _model.config.dtermDynLpfFilter.freq);
         for(size_t i = 0; i <= AXIS_YAW; i++) {
-          _model.state.innerPid[i].dtermFilter.reconfigure(dtermFreq);
+          _model.state.innerPid.dtermFilter[i].reconfigure(dtermFreq);
         }
       }
     }
@@ -0,0 +1,71 @@
+#ifndef _ESPFC_ALTITUDE_ESTIMATOR_H_
+#define _ESPFC_ALTITUDE_ESTIMATOR_H_
+
+#include "Model.h"
+#include "Math/AltitudeKalman.h"
+
+#define ESPFC_ALTITUDE_ACCEL_NOISE 0.5f // [m/s^2]
+#define ESPFC_ALTITUDE_BARO_NOISE  0.3f // [m]
+#define ESPFC_ALTITUDE_BIAS_NOISE  0.05f // [m/s^2/sqrt(s)]
+
+namespace Espfc {
+
+class AltitudeEstimator
+{
+  public:
+    AltitudeEstimator(Model& model): _model(model), _initialized(false) {}
+
+    int begin()
+    {
+      _kalman.begin(ESPFC_ALTITUDE_ACCEL_NOISE, ESPFC_ALTITUDE_BARO_NOISE, ESPFC_ALTITUDE_BIAS_NOISE);
+      _initialized = false;
+      _model.state.altitude = 0.f;
+      _model.state.velocity.z = 0.f;
+      return 1;
+    }
+
+    // at accel rate, after attitude is updated
+    void update()
+    {
+      if(!_initialized || !_model.accelActive()) return;
+
+      const VectorFloat up = _model.getUpVector();
+      const float accel = VectorFloat::dotProduct(_model.state.accel, up) - ACCEL_G;
+
+      _kalman.predict(accel, _model.state.accelTimer.intervalf);
+      output();
+    }
+
+    // at baro rate
+    void correct()
+    {
+      if(!_model.baroActive()) return;
+
+      // follow baro directly until reference altitude settles
+      if(!_initialized || _model.state.baroAltitudeBiasSamples > 0)
+      {
+        _kalman.reset(_model.state.baroAltitude);
+        _initialized = true;
+      }
+      else
+      {
+        _kalman.correct(_model.state.baroAltitude);
+      }
+      output();
+    }
+
+  private:
+    void output()
+    {
+      _model.state.altitude = _kalman.altitude();
+      _model.state.velocity.z = _kalman.velocity();
+    }
+
+    Model& _model;
+    Math::AltitudeKalman _kalman;
+    bool _initialized;
+};
+
+}
+
+#endif
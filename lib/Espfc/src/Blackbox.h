@@ -190,7 +190,7 @@ class Blackbox
         cp->pid[i].D = _model.config.pid[i].D;
         cp->pid[i].F = _model.config.pid[i].F;
         if(i <= AXIS_YAW) {
-          cp->d_min[i] = _model.config.pid[i].D;
+          cp->d_min[i] = _model.config.dMin[i];
         }
       }
       cp->pidAtMinThrottle = 1;
@@ -204,10 +204,19 @@ class Blackbox
       cp->dterm_notch_cutoff = _model.config.dtermNotchFilter.cutoff;
       cp->yaw_lowpass_hz = _model.config.yawFilter.freq;
       cp->itermWindupPointPercent = _model.config.itermWindupPointPercent;
+      cp->iterm_relax = _model.config.itermRelax;
+      cp->iterm_relax_type = 1; // SETPOINT
+      cp->iterm_relax_cutoff = _model.config.itermRelaxCutoff;
       cp->antiGravityMode = 0;
       cp->pidSumLimit = 500;
       cp->pidSumLimitYaw = 500;
-      cp->ff_boost = 0;
+      cp->ff_boost = _model.config.feedforwardBoost;
+      cp->feedforward_transition = 0;
+      cp->feedforward_averaging = _model.config.feedforwardAveraging;
+      cp->feedforward_smooth_factor = 0;
+      cp->feedforward_jitter_factor = _model.config.feedforwardJitter;
+      cp->feedforward_boost = _model.config.feedforwardBoost;
+      cp->feedforward_max_rate_limit = 0;
       cp->feedForwardTransition = 0;
       cp->tpa_mode = 0; // PD
       cp->tpa_rate = _model.config.tpaScale;
@@ -215,11 +224,12 @@ class Blackbox
       cp->motor_output_limit = _model.config.output.motorLimit;
       cp->throttle_boost = 0;
       cp->throttle_boost_cutoff = 100;
-      cp->anti_gravity_gain = 0;
+      cp->anti_gravity_gain = _model.config.antiGravityGain;
       cp->anti_gravity_p_gain = 0;
-      cp->anti_gravity_cutoff_hz = 100;
-      cp->d_min_gain = 0;
-      cp->d_min_advance = 0;
+      cp->anti_gravity_cutoff_hz = _model.config.antiGravityCutoff;
+      cp->vbat_sag_compensation = _model.config.output.vbatSagCompensation;
+      cp->d_min_gain = _model.config.dMinGain;
+      cp->d_min_advance = _model.config.dMinAdvance;
 
       rcControlsConfigMutable()->deadband = _model.config.input.deadband;
       rcControlsConfigMutable()->yaw_deadband = _model.config.input.deadband;
@@ -325,10 +335,10 @@ class Blackbox
       for(size_t i = 0; i < 3; i++)
       {
         gyro.gyroADCf[i] = degrees(_model.state.gyro[i]);
-        pidData[i].P = _model.state.innerPid[i].pTerm * 1000.f;
-        pidData[i].I = _model.state.innerPid[i].iTerm * 1000.f;
-        pidData[i].D = _model.state.innerPid[i].dTerm * 1000.f;
-        pidData[i].F = _model.state.innerPid[i].fTerm * 1000.f;
+        pidData[i].P = _model.state.innerPid.pTerm[i] * 1000.f;
+        pidData[i].I = _model.state.innerPid.iTerm[i] * 1000.f;
+        pidData[i].D = _model.state.innerPid.dTerm[i] * 1000.f;
+        pidData[i].F = _model.state.innerPid.fTerm[i] * 1000.f;
         rcCommand[i] = (_model.state.inputBuffer[i] - 1500) * (i == AXIS_YAW ? -1 : 1);
         if(_model.accelActive()) {
           acc.accADC[i] = _model.state.accel[i] * ACCEL_G_INV * acc.dev.acc_1G;
@@ -396,6 +406,9 @@ class Blackbox
       if(_model.isSwitchActive(MODE_ANGLE)) bitArraySet(&rcModeActivationMask, BOXANGLE);
       else bitArrayClr(&rcModeActivationMask, BOXANGLE);
 
+      if(_model.isSwitchActive(MODE_HORIZON)) bitArraySet(&rcModeActivationMask, BOXHORIZON);
+      else bitArrayClr(&rcModeActivationMask, BOXHORIZON);
+
       if(_model.isSwitchActive(MODE_AIRMODE)) bitArraySet(&rcModeActivationMask, BOXAIRMODE);
       else bitArrayClr(&rcModeActivationMask, BOXAIRMODE);
 
@@ -104,6 +104,8 @@ class Buzzer
       static const uint8_t beeperSystemInit[] = { 10, 0 };
       static const uint8_t beeperBatteryLow[] = { 30, 0 };
       static const uint8_t beeperBatteryCritical[] = { 50, 0 };
+      static const uint8_t beeperAccCalibration[] = { 10, 0 };
+      static const uint8_t beeperAccCalibrationFail[] = { 10, 10, 50, 0 };
 
       static const uint8_t* beeperSchemes[] = {
         //BEEPER_SILENCE
@@ -129,9 +131,9 @@ class Buzzer
         //BEEPER_RX_SET,                  // Beeps when aux channel is set for beep or beep sequence how many satellites has found if GPS enabled
         beeperRxLost,
         //BEEPER_ACC_CALIBRATION,         // ACC inflight calibration completed confirmation
-        beeperSilence,
+        beeperAccCalibration,
         //BEEPER_ACC_CALIBRATION_FAIL,    // ACC inflight calibration failed
-        beeperSilence,
+        beeperAccCalibrationFail,
         //BEEPER_READY_BEEP,              // Ring a tone when GPS is locked and ready
         beeperSilence,
         //BEEPER_MULTI_BEEPS,             // Internal value used by 'beeperConfirmationBeeps()'.
@@ -347,6 +347,8 @@ class Cli
 
       const char ** fusionModeChoices        = FusionConfig::getModeNames();
       static const char* gyroDlpfChoices[]   = { PSTR("256Hz"), PSTR("188Hz"), PSTR("98Hz"), PSTR("42Hz"), PSTR("20Hz"), PSTR("10Hz"), PSTR("5Hz"), PSTR("EXPERIMENTAL"), NULL };
+      static const char* gyroDecimChoices[]  = { PSTR("NONE"), PSTR("CIC1"), PSTR("CIC2"), PSTR("CIC3"), NULL };
+      static const char* gyroSelectChoices[] = { PSTR("FIRST"), PSTR("SECOND"), PSTR("BOTH"), PSTR("AUTO"), NULL };
       static const char* debugModeChoices[]  = {  PSTR("NONE"), PSTR("CYCLETIME"), PSTR("BATTERY"), PSTR("GYRO_FILTERED"), PSTR("ACCELEROMETER"), PSTR("PIDLOOP"), PSTR("GYRO_SCALED"), PSTR("RC_INTERPOLATION"),
                                                   PSTR("ANGLERATE"), PSTR("ESC_SENSOR"), PSTR("SCHEDULER"), PSTR("STACK"), PSTR("ESC_SENSOR_RPM"), PSTR("ESC_SENSOR_TMP"), PSTR("ALTITUDE"), PSTR("FFT"), 
                                                   PSTR("FFT_TIME"), PSTR("FFT_FREQ"), PSTR("RX_FRSKY_SPI"), PSTR("RX_SFHSS_SPI"), PSTR("GYRO_RAW"), PSTR("DUAL_GYRO_RAW"), PSTR("DUAL_GYRO_DIFF"), 
@@ -355,7 +357,7 @@ class Cli
                                                   PSTR("ACRO_TRAINER"), PSTR("RC_SMOOTHING"), PSTR("RX_SIGNAL_LOSS"), PSTR("RC_SMOOTHING_RATE"), PSTR("ANTI_GRAVITY"), PSTR("DYN_LPF"), PSTR("RX_SPEKTRUM_SPI"), 
                                                   PSTR("DSHOT_RPM_TELEMETRY"), PSTR("RPM_FILTER"), PSTR("D_MIN"), PSTR("AC_CORRECTION"), PSTR("AC_ERROR"), PSTR("DUAL_GYRO_SCALED"), PSTR("DSHOT_RPM_ERRORS"), 
                                                   PSTR("CRSF_LINK_STATISTICS_UPLINK"), PSTR("CRSF_LINK_STATISTICS_PWR"), PSTR("CRSF_LINK_STATISTICS_DOWN"), PSTR("BARO"), PSTR("GPS_RESCUE_THROTTLE_PID"), 
-                                                  PSTR("DYN_IDLE"), PSTR("FF_LIMIT"), PSTR("FF_INTERPOLATED"), PSTR("BLACKBOX_OUTPUT"), PSTR("GYRO_SAMPLE"), PSTR("RX_TIMING"), NULL };
+                                                  PSTR("DYN_IDLE"), PSTR("FF_LIMIT"), PSTR("FF_INTERPOLATED"), PSTR("BLACKBOX_OUTPUT"), PSTR("GYRO_SAMPLE"), PSTR("RX_TIMING"), PSTR("MIXER_SATURATION"), NULL };
       static const char* filterTypeChoices[] = { PSTR("PT1"), PSTR("BIQUAD"), PSTR("NOTCH"), PSTR("NOTCH_DF1"), PSTR("BPF"), PSTR("FIR2"), PSTR("MEDIAN3"), PSTR("PT2"), PSTR("PT3"), PSTR("NONE"), NULL };
       static const char* alignChoices[]      = { PSTR("DEFAULT"), PSTR("CW0"), PSTR("CW90"), PSTR("CW180"), PSTR("CW270"), PSTR("CW0_FLIP"), PSTR("CW90_FLIP"), PSTR("CW180_FLIP"), PSTR("CW270_FLIP"), NULL };
       static const char* mixerTypeChoices[]  = { PSTR("NONE"), PSTR("TRI"), PSTR("QUADP"), PSTR("QUADX"), PSTR("BI"),
@@ -370,6 +372,8 @@ class Cli
       static const char* inputRateTypeChoices[] = { PSTR("BETAFLIGHT"), PSTR("RACEFLIGHT"), PSTR("KISS"), PSTR("ACTUAL"), PSTR("QUICK"), NULL };
       static const char* throtleLimitTypeChoices[] = { PSTR("NONE"), PSTR("SCALE"), PSTR("CLIP"), NULL };
       static const char* inputFilterChoices[] = { PSTR("INTERPOLATION"), PSTR("FILTER"), NULL };
+      static const char* itermRelaxChoices[] = { PSTR("OFF"), PSTR("RP"), PSTR("RPY"), NULL };
+      static const char* ffAveragingChoices[] = { PSTR("OFF"), PSTR("2_POINT"), PSTR("3_POINT"), NULL };
 
 #ifdef ESPFC_SERIAL_SOFT_0_WIFI
       const char ** wifiModeChoices            = WirelessConfig::getModeNames();
@@ -386,6 +390,9 @@ class Cli
         Param(PSTR("gyro_dev"), &c.gyroDev, gyroDevChoices),
         Param(PSTR("gyro_dlpf"), &c.gyroDlpf, gyroDlpfChoices),
         Param(PSTR("gyro_align"), &c.gyroAlign, alignChoices),
+        Param(PSTR("gyro_decim"), &c.gyroDecimation, gyroDecimChoices),
+        Param(PSTR("gyro_select"), &c.gyroSelect, gyroSelectChoices),
+        Param(PSTR("gyro2_align"), &c.gyro2Align, alignChoices),
         Param(PSTR("gyro_lpf_type"), &c.gyroFilter.type, filterTypeChoices),
         Param(PSTR("gyro_lpf_freq"), &c.gyroFilter.freq),
         Param(PSTR("gyro_lpf2_type"), &c.gyroFilter2.type, filterTypeChoices),
@@ -410,6 +417,12 @@ class Cli
         Param(PSTR("accel_offset_x"), &c.accelBias[0]),
         Param(PSTR("accel_offset_y"), &c.accelBias[1]),
         Param(PSTR("accel_offset_z"), &c.accelBias[2]),
+        Param(PSTR("accel_scale_x"), &c.accelCalibrationScale[0]),
+        Param(PSTR("accel_scale_y"), &c.accelCalibrationScale[1]),
+        Param(PSTR("accel_scale_z"), &c.accelCalibrationScale[2]),
+        Param(PSTR("accel_cross_xy"), &c.accelCalibrationCross[0]),
+        Param(PSTR("accel_cross_xz"), &c.accelCalibrationCross[1]),
+        Param(PSTR("accel_cross_yz"), &c.accelCalibrationCross[2]),
 
         Param(PSTR("mag_bus"), &c.magBus, busDevChoices),
         Param(PSTR("mag_dev"), &c.magDev, magDevChoices),
@@ -422,12 +435,25 @@ class Cli
         Param(PSTR("mag_scale_x"), &c.magCalibrationScale[0]),
         Param(PSTR("mag_scale_y"), &c.magCalibrationScale[1]),
         Param(PSTR("mag_scale_z"), &c.magCalibrationScale[2]),
+        Param(PSTR("mag_cross_xy"), &c.magCalibrationCross[0]),
+        Param(PSTR("mag_cross_xz"), &c.magCalibrationCross[1]),
+        Param(PSTR("mag_cross_yz"), &c.magCalibrationCross[2]),
 
         Param(PSTR("baro_bus"), &c.baroBus, busDevChoices),
         Param(PSTR("baro_dev"), &c.baroDev, baroDevChoices),
         Param(PSTR("baro_lpf_type"), &c.baroFilter.type, filterTypeChoices),
         Param(PSTR("baro_lpf_freq"), &c.baroFilter.freq),
 
+        Param(PSTR("vbat_source"), &c.vbatSource),
+        Param(PSTR("vbat_scale"), &c.vbatScale),
+        Param(PSTR("vbat_res_div"), &c.vbatResDiv),
+        Param(PSTR("vbat_res_mult"), &c.vbatResMult),
+        Param(PSTR("vbat_cell_warn"), &c.vbatCellWarning),
+        Param(PSTR("vbat_cell_full"), &c.vbatCellFull),
+        Param(PSTR("ibat_source"), &c.ibatSource),
+        Param(PSTR("ibat_scale"), &c.ibatScale),
+        Param(PSTR("ibat_offset"), &c.ibatOffset),
+
         Param(PSTR("fusion_mode"), &c.fusion.mode, fusionModeChoices),
         Param(PSTR("fusion_gain_p"), &c.fusion.gain),
         Param(PSTR("fusion_gain_i"), &c.fusion.gainI),
@@ -536,6 +562,7 @@ class Cli
 
         Param(PSTR("pid_level_angle_limit"), &c.angleLimit),
         Param(PSTR("pid_level_rate_limit"), &c.angleRateLimit),
+        Param(PSTR("pid_level_horizon_limit_sticks"), &c.horizonLimitSticks),
         Param(PSTR("pid_level_lpf_type"), &c.levelPtermFilter.type, filterTypeChoices),
         Param(PSTR("pid_level_lpf_freq"), &c.levelPtermFilter.freq),
 
@@ -554,8 +581,31 @@ class Cli
         Param(PSTR("pid_dterm_weight"), &c.dtermSetpointWeight),
         Param(PSTR("pid_iterm_limit"), &c.itermWindupPointPercent),
         Param(PSTR("pid_iterm_zero"), &c.lowThrottleZeroIterm),
+        Param(PSTR("pid_iterm_relax"), &c.itermRelax, itermRelaxChoices),
+        Param(PSTR("pid_iterm_relax_cutoff"), &c.itermRelaxCutoff),
+        Param(PSTR("pid_anti_gravity_gain"), &c.antiGravityGain),
+        Param(PSTR("pid_anti_gravity_cutoff"), &c.antiGravityCutoff),
+        Param(PSTR("pid_roll_d_min"), &c.dMin[AXIS_ROLL]),
+        Param(PSTR("pid_pitch_d_min"), &c.dMin[AXIS_PITCH]),
+        Param(PSTR("pid_yaw_d_min"), &c.dMin[AXIS_YAW]),
+        Param(PSTR("pid_d_min_gain"), &c.dMinGain),
+        Param(PSTR("pid_d_min_advance"), &c.dMinAdvance),
+        Param(PSTR("pid_ff_averaging"), &c.feedforwardAveraging, ffAveragingChoices),
+        Param(PSTR("pid_ff_boost"), &c.feedforwardBoost),
+        Param(PSTR("pid_ff_jitter"), &c.feedforwardJitter),
         Param(PSTR("pid_tpa_scale"), &c.tpaScale),
         Param(PSTR("pid_tpa_breakpoint"), &c.tpaBreakpoint),
+        Param(PSTR("pid_tpa_curve_0"), &c.tpaCurve[0]),
+        Param(PSTR("pid_tpa_curve_25"), &c.tpaCurve[1]),
+        Param(PSTR("pid_tpa_curve_50"), &c.tpaCurve[2]),
+        Param(PSTR("pid_tpa_curve_75"), &c.tpaCurve[3]),
+        Param(PSTR("pid_tpa_curve_100"), &c.tpaCurve[4]),
+        Param(PSTR("pid_tpa_roll_p"), &c.tpaP[AXIS_ROLL]),
+        Param(PSTR("pid_tpa_roll_d"), &c.tpaD[AXIS_ROLL]),
+        Param(PSTR("pid_tpa_pitch_p"), &c.tpaP[AXIS_PITCH]),
+        Param(PSTR("pid_tpa_pitch_d"), &c.tpaD[AXIS_PITCH]),
+        Param(PSTR("pid_tpa_yaw_p"), &c.tpaP[AXIS_YAW]),
+        Param(PSTR("pid_tpa_yaw_d"), &c.tpaD[AXIS_YAW]),
 
         Param(PSTR("mixer_sync"), &c.mixerSync),
         Param(PSTR("mixer_type"), &c.mixerType, mixerTypeChoices),
@@ -563,6 +613,9 @@ class Cli
         Param(PSTR("mixer_throttle_limit_type"), &c.output.throttleLimitType, throtleLimitTypeChoices),
         Param(PSTR("mixer_throttle_limit_percent"), &c.output.throttleLimitPercent),
         Param(PSTR("mixer_output_limit"), &c.output.motorLimit),
+        Param(PSTR("mixer_thrust_linear"), &c.output.thrustLinear),
+        Param(PSTR("mixer_yaw_priority"), &c.output.yawPriority),
+        Param(PSTR("mixer_vbat_sag_comp"), &c.output.vbatSagCompensation),
 
         Param(PSTR("output_motor_protocol"), &c.output.protocol, protocolChoices),
         Param(PSTR("output_motor_async"), &c.output.async),
@@ -809,7 +862,7 @@ class Cli
       {
         static const char * helps[] = {
           PSTR("available commands:"),
-          PSTR(" help"), PSTR(" dump"), PSTR(" get param"), PSTR(" set param value ..."), PSTR(" cal [gyro]"),
+          PSTR(" help"), PSTR(" dump"), PSTR(" get param"), PSTR(" set param value ..."), PSTR(" cal [gyro|accel|accel_cross|mag]"),
           PSTR(" defaults"), PSTR(" save"), PSTR(" reboot"), PSTR(" scaler"), PSTR(" mixer"),
           PSTR(" stats"), PSTR(" status"), PSTR(" devinfo"), PSTR(" version"),
           //PSTR(" load"), PSTR(" eeprom"),
@@ -894,6 +947,7 @@ class Cli
           if(strcmp_P(cmd.args[1], _params[i].name) == 0)
           {
             _params[i].update(cmd.args);
+            applyParam(cmd.args[1]);
             print(_params[i], s);
             found = true;
             break;
@@ -927,6 +981,19 @@ class Cli
           s.print(_model.state.gyroBias[1]); s.print(' ');
           s.print(_model.state.gyroBias[2]); s.println(F("]"));
 
+          s.print(F("  gyro noise: "));
+          s.print(degrees(_model.state.gyroCalibrationNoise), 3); s.print(F(" dps, restarts: "));
+          s.print(_model.state.gyroCalibrationRestarts);
+          s.println(_model.state.gyroCalibrationFailed ? F(", failed") : F(""));
+
+          if(_model.config.fusion.mode == FUSION_EKF)
+          {
+            s.print(F("  gyro drift: "));
+            s.print(degrees(_model.state.gyroBiasEstimate[0]), 3); s.print(' ');
+            s.print(degrees(_model.state.gyroBiasEstimate[1]), 3); s.print(' ');
+            s.print(degrees(_model.state.gyroBiasEstimate[2]), 3); s.println(F(" dps"));
+          }
+
           s.print(F("accel offset: "));
           s.print(_model.config.accelBias[0]); s.print(' ');
           s.print(_model.config.accelBias[1]); s.print(' ');
@@ -935,6 +1002,22 @@ class Cli
           s.print(_model.state.accelBias[1]); s.print(' ');
           s.print(_model.state.accelBias[2]); s.println(F("]"));
 
+          s.print(F(" accel scale: "));
+          s.print(_model.config.accelCalibrationScale[0]); s.print(' ');
+          s.print(_model.config.accelCalibrationScale[1]); s.print(' ');
+          s.print(_model.config.accelCalibrationScale[2]); s.print(F(" ["));
+          s.print(_model.state.accelCalibrationScale[0]); s.print(' ');
+          s.print(_model.state.accelCalibrationScale[1]); s.print(' ');
+          s.print(_model.state.accelCalibrationScale[2]); s.println(F("]"));
+
+          s.print(F(" accel cross: "));
+          s.print(_model.config.accelCalibrationCross[0]); s.print(' ');
+          s.print(_model.config.accelCalibrationCross[1]); s.print(' ');
+          s.print(_model.config.accelCalibrationCross[2]); s.print(F(" ["));
+          s.print(_model.state.accelCalibrationCross[0]); s.print(' ');
+          s.print(_model.state.accelCalibrationCross[1]); s.print(' ');
+          s.print(_model.state.accelCalibrationCross[2]); s.println(F("]"));
+
           s.print(F(" mag offset: "));
           s.print(_model.config.magCalibrationOffset[0]); s.print(' ');
           s.print(_model.config.magCalibrationOffset[1]); s.print(' ');
@@ -950,6 +1033,19 @@ class Cli
           s.print(_model.state.magCalibrationScale[0]); s.print(' ');
           s.print(_model.state.magCalibrationScale[1]); s.print(' ');
           s.print(_model.state.magCalibrationScale[2]); s.println(F("]"));
+
+          s.print(F("  mag cross: "));
+          s.print(_model.config.magCalibrationCross[0]); s.print(' ');
+          s.print(_model.config.magCalibrationCross[1]); s.print(' ');
+          s.print(_model.config.magCalibrationCross[2]); s.print(F(" ["));
+          s.print(_model.state.magCalibrationCross[0]); s.print(' ');
+          s.print(_model.state.magCalibrationCross[1]); s.print(' ');
+          s.print(_model.state.magCalibrationCross[2]); s.println(F("]"));
+
+          s.print(F("    mag fit: "));
+          s.print(_model.state.magCalibrationError * 100.f, 2); s.print(F("%, coverage: "));
+          s.print(_model.state.magCalibrationCoverage); s.print(F("/26, outliers: "));
+          s.println(_model.state.magCalibrationOutliers);
         }
         else if(strcmp_P(cmd.args[1], PSTR("gyro")) == 0)
         {
@@ -961,9 +1057,17 @@ class Cli
           if(!_model.isActive(MODE_ARMED)) _model.calibrateMag();
           s.println(F("OK"));
         }
+        else if(strcmp_P(cmd.args[1], PSTR("accel")) == 0 || strcmp_P(cmd.args[1], PSTR("accel_cross")) == 0)
+        {
+          // hold still on each of six sides, beep confirms each side
+          if(!_model.isActive(MODE_ARMED)) _model.calibrateAccel(strcmp_P(cmd.args[1], PSTR("accel_cross")) == 0);
+          s.println(F("OK"));
+        }
         else if(strcmp_P(cmd.args[1], PSTR("reset_accel")) == 0 || strcmp_P(cmd.args[1], PSTR("reset_all")) == 0)
         {
           _model.state.accelBias = VectorFloat();
+          _model.state.accelCalibrationScale = VectorFloat(1.f, 1.f, 1.f);
+          _model.state.accelCalibrationCross = VectorFloat();
           s.println(F("OK"));
         }
         else if(strcmp_P(cmd.args[1], PSTR("reset_gyro")) == 0 || strcmp_P(cmd.args[1], PSTR("reset_all")) == 0)
@@ -975,6 +1079,7 @@ class Cli
         {
           _model.state.magCalibrationOffset = VectorFloat();
           _model.state.magCalibrationScale = VectorFloat(1.f, 1.f, 1.f);
+          _model.state.magCalibrationCross = VectorFloat();
           s.println(F("OK"));
         }
       }
@@ -1136,6 +1241,17 @@ class Cli
           s.println(F(" gyro device: NONE"));
         }
 
+        Device::GyroDevice * gyro2 = _model.state.gyroDev2;
+        if(gyro2)
+        {
+          s.print(F("gyro2 device: "));
+          s.print(FPSTR(Device::GyroDevice::getName(gyro2->getType())));
+          s.print('/');
+          s.print(FPSTR(Device::BusDevice::getName(gyro2->getBus()->getType())));
+          s.print(F(", fault: "));
+          s.println(_model.state.gyroFault);
+        }
+
         if(baro)
         {
           s.print(F(" baro device: "));
@@ -1246,6 +1362,19 @@ class Cli
     }
 
   private:
+    // rebuild state derived from config at begin, so change takes effect without reboot
+    void applyParam(const char * name)
+    {
+      if(strncmp_P(name, PSTR("pid_tpa_"), 8) == 0)
+      {
+        _model.state.tpa.begin(_model.config);
+      }
+      if(strncmp_P(name, PSTR("mix_"), 4) == 0)
+      {
+        _model.state.mixerMatrix.compile(_model.state.currentMixer);
+      }
+    }
+
     void print(const Param& param, Stream& s)
     {
       s.print(F("set "));
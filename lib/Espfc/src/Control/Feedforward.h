@@ -0,0 +1,115 @@
+#ifndef _ESPFC_FEEDFORWARD_H_
+#define _ESPFC_FEEDFORWARD_H_
+
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+namespace Espfc {
+
+enum FeedforwardAveraging {
+  FEEDFORWARD_AVERAGING_OFF,
+  FEEDFORWARD_AVERAGING_2_POINT,
+  FEEDFORWARD_AVERAGING_3_POINT,
+};
+
+// Setpoint speed computed once per rc frame, so interpolated input does not produce
+// a spike in every loop that follows a new frame. Value is held between frames.
+class Feedforward
+{
+  public:
+    static const size_t AVERAGING_MAX = 3;
+
+    Feedforward(): _averaging(1), _boost(0.f), _jitter(0.f), _value(0.f), _stopped(false) { reset(); }
+
+    // averaging: FeedforwardAveraging, boost: 0-50, jitter: stick change in us below which ff is attenuated
+    void begin(int averaging, int boost, int jitter)
+    {
+      _averaging = std::min((size_t)std::max(averaging + 1, 1), AVERAGING_MAX);
+      _boost = boost * 0.001f;
+      _jitter = jitter;
+      reset();
+    }
+
+    void reset()
+    {
+      _prevSetpoint = _prevSpeed = 0.f;
+      _prevRcDelta = 0.f;
+      _index = 0;
+      for(size_t i = 0; i < AVERAGING_MAX; i++) _history[i] = 0.f;
+      _value = 0.f;
+      _stopped = false;
+    }
+
+    // frames stopped, drop held speed, next frame only takes setpoint as reference
+    void stop()
+    {
+      _prevSpeed = _prevRcDelta = 0.f;
+      for(size_t i = 0; i < AVERAGING_MAX; i++) _history[i] = 0.f;
+      _value = 0.f;
+      _stopped = true;
+    }
+
+    // setpoint from current frame [rad/s], rcDelta stick change since previous frame [us], interval between frames [s]
+    float update(float setpoint, float rcDelta, float interval)
+    {
+      if(_stopped)
+      {
+        _prevSetpoint = setpoint;
+        _stopped = false;
+        return _value;
+      }
+
+      const float rxRate = 1.f / interval;
+      const float rcDeltaAbs = std::abs(rcDelta);
+
+      // repeated frame while stick is moving, most likely a dropped packet, hold previous speed
+      const bool duplicate = rcDeltaAbs == 0.f && _prevRcDelta > 0.f;
+      const float speed = duplicate ? _prevSpeed : (setpoint - _prevSetpoint) * rxRate;
+
+      // attenuate small stick changes, they are mostly rx jitter
+      float jitterAttenuator = 1.f;
+      if(!duplicate && _jitter > 0.f && rcDeltaAbs < _jitter)
+      {
+        const float a = std::max(1.f - (rcDeltaAbs + _prevRcDelta) * 0.5f / _jitter, 0.f);
+        jitterAttenuator = 1.f - a * a;
+      }
+
+      // boost from setpoint acceleration, scaled like betaflight feedforward_boost
+      const float acceleration = (speed - _prevSpeed) * rxRate * 0.01f;
+      const float value = (speed + acceleration * _boost) * jitterAttenuator;
+
+      _prevSetpoint = setpoint;
+      _prevSpeed = speed;
+      _prevRcDelta = rcDeltaAbs;
+
+      _history[_index] = value;
+      _index = (_index + 1) % _averaging;
+      float sum = 0.f;
+      for(size_t i = 0; i < _averaging; i++) sum += _history[i];
+      _value = sum / _averaging;
+
+      return _value;
+    }
+
+    float value() const
+    {
+      return _value;
+    }
+
+  private:
+    size_t _averaging;
+    float _boost;
+    float _jitter;
+    float _prevSetpoint;
+    float _prevSpeed;
+    float _prevRcDelta;
+    float _history[AVERAGING_MAX];
+    size_t _index;
+    float _value;
+    bool _stopped;
+};
+
+}
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef _ESPFC_PID_BANK_H_
+#define _ESPFC_PID_BANK_H_
+
+#include "Math/Utils.h"
+#include "Filter.h"
+
+// setpoint high-pass at which iterm integration stops [rad/s], 40 deg/s
+#define ITERM_RELAX_SETPOINT_THRESHOLD 0.6981317f
+// anti gravity throttle derivative to iterm boost scale
+#define ANTI_GRAVITY_ITERM_SCALE 0.34f
+// d-min activity detection, gyro derivative band and boost smoothing [Hz]
+#define DMIN_RANGE_HZ 85
+#define DMIN_LOWPASS_HZ 35
+#define DMIN_GAIN_FACTOR 0.00008f
+#define DMIN_SETPOINT_GAIN_FACTOR 0.00008f
+
+namespace Espfc {
+
+// Roll, pitch and yaw rate pids computed together, same per axis semantics as Pid.
+// State is kept as arrays per term and every filter stage runs for all axes at once,
+// so the filter type switch is resolved once per stage instead of once per axis.
+class PidBank
+{
+  public:
+    static const size_t SIZE = 3;
+
+    PidBank(): rate(1000.f), dt(0.001f), feedforwardMask(0), itermRelaxMask(0), dMinMask(0), dMinGyroGain(0.f), dMinSetpointGain(0.f), antiGravityMask(0), antiGravityGain(0.f), iBoost(1.f), throttleDelta(0.f), prevThrottle(0.f)
+    {
+      for(size_t i = 0; i < SIZE; i++)
+      {
+        Kp[i] = 0.1f; Ki[i] = Kd[i] = Kf[i] = 0.f;
+        iLimit[i] = 0.f; oLimit[i] = 1.f;
+        pScale[i] = iScale[i] = dScale[i] = fScale[i] = 1.f;
+        pTpa[i] = dTpa[i] = 1.f;
+        error[i] = pTerm[i] = iTerm[i] = dTerm[i] = fTerm[i] = 0.f;
+        prevMeasure[i] = prevSetpoint[i] = setpointDelta[i] = feedforward[i] = 0.f;
+        itermRelaxFactor[i] = 1.f;
+        dMinPercent[i] = 0.f; dMinFactor[i] = 1.f;
+      }
+    }
+
+    void begin()
+    {
+      dt = 1.f / rate;
+    }
+
+    void update(const float * setpoint, const float * measure, float * output)
+    {
+      float setpointLpf[SIZE] = { setpoint[0], setpoint[1], setpoint[2] };
+      Filter::update(itermRelaxFilter, setpointLpf, SIZE, itermRelaxMask);
+
+      uint32_t dMask = 0, fMask = 0;
+      for(size_t i = 0; i < SIZE; i++)
+      {
+        error[i] = setpoint[i] - measure[i];
+        pTerm[i] = getPterm(i);
+        updateIterm(i, setpoint[i], setpointLpf[i]);
+        dTerm[i] = dActive(i) ? getDtermInput(i, measure[i]) : 0.f;
+        fTerm[i] = fActive(i) ? getFtermInput(i, setpoint[i]) : 0.f;
+        if(dActive(i)) dMask |= 1u << i;
+        if(fActive(i)) fMask |= 1u << i;
+        updateHistory(i, setpoint[i], measure[i]);
+      }
+
+      Filter::update(ptermFilter, pTerm, SIZE);
+      Filter::update(dtermNotchFilter, dTerm, SIZE, dMask);
+      Filter::update(dtermFilter, dTerm, SIZE, dMask);
+      Filter::update(dtermFilter2, dTerm, SIZE, dMask);
+      Filter::update(ftermFilter, fTerm, SIZE, fMask);
+
+      const uint32_t mask = dMinMask & dMask;
+      if(mask)
+      {
+        float range[SIZE] = { dTerm[0], dTerm[1], dTerm[2] };
+        Filter::update(dMinRangeFilter, range, SIZE, mask);
+        for(size_t i = 0; i < SIZE; i++)
+        {
+          if(mask & (1u << i)) dMinFactor[i] = getDMinBoost(i, range[i], setpointDelta[i]);
+        }
+        Filter::update(dMinFilter, dMinFactor, SIZE, mask);
+        for(size_t i = 0; i < SIZE; i++)
+        {
+          if(mask & (1u << i)) dMinFactor[i] = std::min(dMinFactor[i], 1.f);
+        }
+      }
+
+      for(size_t i = 0; i < SIZE; i++)
+      {
+        if(dMask & (1u << i)) dTerm[i] *= getDtermGain(i);
+        output[i] = getOutput(i);
+      }
+    }
+
+    // single axis, for controllers that do not drive all axes
+    float update(size_t i, float setpoint, float measure)
+    {
+      const float setpointLpf = (itermRelaxMask & (1u << i)) ? itermRelaxFilter[i].update(setpoint) : setpoint;
+
+      error[i] = setpoint - measure;
+      pTerm[i] = ptermFilter[i].update(getPterm(i));
+      updateIterm(i, setpoint, setpointLpf);
+
+      if(dActive(i))
+      {
+        dTerm[i] = getDtermInput(i, measure);
+        dTerm[i] = dtermNotchFilter[i].update(dTerm[i]);
+        dTerm[i] = dtermFilter[i].update(dTerm[i]);
+        dTerm[i] = dtermFilter2[i].update(dTerm[i]);
+        if(dMinMask & (1u << i))
+        {
+          const float boost = getDMinBoost(i, dMinRangeFilter[i].update(dTerm[i]), setpoint - prevSetpoint[i]);
+          dMinFactor[i] = std::min(dMinFilter[i].update(boost), 1.f);
+        }
+        dTerm[i] *= getDtermGain(i);
+      }
+      else
+      {
+        dTerm[i] = 0;
+      }
+
+      fTerm[i] = fActive(i) ? ftermFilter[i].update(getFtermInput(i, setpoint)) : 0.f;
+
+      updateHistory(i, setpoint, measure);
+
+      return getOutput(i);
+    }
+
+    // throttle in [0, 1], call once per loop before update
+    void updateAntiGravity(float throttle)
+    {
+      // fast throttle changes at low throttle matter most, rising throttle is damped
+      const float inv = 1.f - throttle;
+      float delta = std::abs(throttle - prevThrottle) * rate * inv * inv;
+      if(throttle > prevThrottle) delta *= inv * 0.5f;
+      prevThrottle = throttle;
+
+      throttleDelta = antiGravityFilter.update(delta);
+      iBoost = 1.f + antiGravityGain * throttleDelta * ANTI_GRAVITY_ITERM_SCALE;
+    }
+
+    float rate;
+    float dt;
+
+    float Kp[SIZE];
+    float Ki[SIZE];
+    float Kd[SIZE];
+    float Kf[SIZE];
+
+    float iLimit[SIZE];
+    float oLimit[SIZE];
+
+    float pScale[SIZE];
+    float iScale[SIZE];
+    float dScale[SIZE];
+    float fScale[SIZE];
+
+    // throttle pid attenuation
+    float pTpa[SIZE];
+    float dTpa[SIZE];
+
+    float error[SIZE];
+    float pTerm[SIZE];
+    float iTerm[SIZE];
+    float dTerm[SIZE];
+    float fTerm[SIZE];
+
+    float prevMeasure[SIZE];
+    float prevSetpoint[SIZE];
+    float setpointDelta[SIZE];
+
+    Filter dtermFilter[SIZE];
+    Filter dtermFilter2[SIZE];
+    Filter dtermNotchFilter[SIZE];
+    Filter ptermFilter[SIZE];
+    Filter ftermFilter[SIZE];
+
+    // setpoint speed provided per rc frame, used by fterm instead of per loop derivative
+    uint32_t feedforwardMask;
+    float feedforward[SIZE];
+
+    // iterm relax, setpoint low-pass per axis
+    uint32_t itermRelaxMask;
+    float itermRelaxFactor[SIZE];
+    Filter itermRelaxFilter[SIZE];
+
+    // d-min, dterm gain raised from dMinPercent towards Kd on gyro or setpoint activity
+    uint32_t dMinMask;
+    float dMinPercent[SIZE];
+    float dMinFactor[SIZE];
+    float dMinGyroGain;
+    float dMinSetpointGain;
+    Filter dMinRangeFilter[SIZE];
+    Filter dMinFilter[SIZE];
+
+    // anti gravity, throttle derivative boosts iterm
+    uint32_t antiGravityMask;
+    float antiGravityGain;
+    float iBoost;
+    float throttleDelta;
+    float prevThrottle;
+    Filter antiGravityFilter;
+
+  private:
+    // per axis terms shared by batched and single axis update, filters are applied by caller
+    float getPterm(size_t i) const
+    {
+      return Kp[i] * error[i] * pScale[i] * pTpa[i];
+    }
+
+    void updateIterm(size_t i, float setpoint, float setpointLpf)
+    {
+      if(Ki[i] > 0.f && iScale[i] > 0.f)
+      {
+        itermRelaxFactor[i] = getItermRelaxFactor(setpoint, setpointLpf);
+        iTerm[i] = Math::clamp(iTerm[i] + Ki[i] * error[i] * dt * iScale[i] * itermRelaxFactor[i] * getItermBoost(i), -iLimit[i], iLimit[i]);
+      }
+      else
+      {
+        iTerm[i] = 0; // zero integral
+      }
+    }
+
+    bool dActive(size_t i) const
+    {
+      return Kd[i] > 0.f && dScale[i] > 0.f;
+    }
+
+    // raw derivative on measurement, gain applied after filtering
+    float getDtermInput(size_t i, float measure) const
+    {
+      return (prevMeasure[i] - measure) * rate;
+    }
+
+    float getDtermGain(size_t i) const
+    {
+      return Kd[i] * dScale[i] * dMinFactor[i] * dTpa[i];
+    }
+
+    bool fActive(size_t i) const
+    {
+      return Kf[i] > 0.f && fScale[i] > 0.f;
+    }
+
+    float getFtermInput(size_t i, float setpoint) const
+    {
+      return Kf[i] * fScale[i] * getSetpointSpeed(i, setpoint);
+    }
+
+    void updateHistory(size_t i, float setpoint, float measure)
+    {
+      setpointDelta[i] = setpoint - prevSetpoint[i];
+      prevMeasure[i] = measure;
+      prevSetpoint[i] = setpoint;
+    }
+
+    float getOutput(size_t i) const
+    {
+      return Math::clamp(pTerm[i] + iTerm[i] + dTerm[i] + fTerm[i], -oLimit[i], oLimit[i]);
+    }
+
+    float getSetpointSpeed(size_t i, float setpoint) const
+    {
+      return (feedforwardMask & (1u << i)) ? feedforward[i] : (setpoint - prevSetpoint[i]) * rate;
+    }
+
+    float getItermRelaxFactor(float setpoint, float setpointLpf) const
+    {
+      const float hpf = std::abs(setpoint - setpointLpf);
+      return std::max(0.f, 1.f - hpf * (1.f / ITERM_RELAX_SETPOINT_THRESHOLD));
+    }
+
+    float getDMinBoost(size_t i, float gyroDelta, float setpointDelta) const
+    {
+      const float activity = std::max(std::abs(gyroDelta) * dMinGyroGain, std::abs(setpointDelta) * dMinSetpointGain);
+      return dMinPercent[i] + (1.f - dMinPercent[i]) * activity;
+    }
+
+    float getItermBoost(size_t i) const
+    {
+      return (antiGravityMask & (1u << i)) ? iBoost : 1.f;
+    }
+};
+
+}
+
+#endif
@@ -5,6 +5,8 @@
 
 #define SETPOINT_RATE_LIMIT 1998.0f
 #define RC_RATE_INCREMENTAL 14.54f
+#define RATES_INPUT_LIMIT 0.995f
+#define RATES_LUT_SIZE 65 // points per axis over [0, RATES_INPUT_LIMIT], curves are odd
 
 namespace Espfc
 {
@@ -30,31 +32,63 @@ class Rates
         rates[i] = config.superRate[i];
         rateLimit[i] = config.rateLimit[i];
       }
+
+      // curves are evaluated only on config change, loop interpolates,
+      // limit is applied after interpolation to keep the knee sharp
+      for(size_t axis = 0; axis < 3; axis++)
+      {
+        for(size_t i = 0; i < RATES_LUT_SIZE; i++)
+        {
+          lut[axis][i] = Math::toRad(calculateCurve(axis, i * (RATES_INPUT_LIMIT / (RATES_LUT_SIZE - 1))));
+        }
+        lutLimit[axis] = Math::toRad(rateLimit[axis]);
+      }
+    }
+
+    float getSetpoint(const int axis, float input) const
+    {
+      const float x = std::min(fabsf(input), RATES_INPUT_LIMIT) * ((RATES_LUT_SIZE - 1) / RATES_INPUT_LIMIT);
+      const size_t i = std::min((size_t)x, (size_t)(RATES_LUT_SIZE - 2));
+      const float * t = lut[axis] + i;
+      const float result = std::min(t[0] + (t[1] - t[0]) * (x - i), lutLimit[axis]);
+      return input < 0.f ? -result : result;
     }
 
-    float getSetpoint(const int axis, float input)
+    // reference curve evaluation [rad/s]
+    float calculateSetpoint(const int axis, float input) const
     {
-      input = Math::clamp(input, -0.995f, 0.995f); // limit input
+      return Math::toRad(Math::clamp(calculateCurve(axis, input), -(float)rateLimit[axis], (float)rateLimit[axis]));
+    }
+
+  private:
+    // [deg/s]
+    float calculateCurve(const int axis, float input) const
+    {
+      input = Math::clamp(input, -RATES_INPUT_LIMIT, RATES_INPUT_LIMIT); // limit input
       const float inputAbs = fabsf(input);
       float result = 0;
       switch(rateType)
       {
         case RATES_TYPE_BETAFLIGHT:
           result = betaflight(axis, input, inputAbs);
+          break;
         case RATES_TYPE_RACEFLIGHT:
           result = raceflight(axis, input, inputAbs);
+          break;
         case RATES_TYPE_KISS:
           result = kiss(axis, input, inputAbs);
+          break;
         case RATES_TYPE_ACTUAL:
           result = actual(axis, input, inputAbs);
+          break;
         case RATES_TYPE_QUICK:
           result = quick(axis, input, inputAbs);
+          break;
       }
-      return Math::toRad(Math::clamp(result, -(float)rateLimit[axis], (float)rateLimit[axis]));
+      return result;
     }
 
-  private:
-    float betaflight(const int axis, float rcCommandf, const float rcCommandfAbs)
+    float betaflight(const int axis, float rcCommandf, const float rcCommandfAbs) const
     {
       if (this->rcExpo[axis])
       {
@@ -77,7 +111,7 @@ class Rates
       return angleRate;
     }
 
-    float raceflight(const int axis, float rcCommandf, const float rcCommandfAbs)
+    float raceflight(const int axis, float rcCommandf, const float rcCommandfAbs) const
     {
       // -1.0 to 1.0 ranged and curved
       rcCommandf = ((1.0f + 0.01f * this->rcExpo[axis] * (rcCommandf * rcCommandf - 1.0f)) * rcCommandf);
@@ -88,7 +122,7 @@ class Rates
       return angleRate;
     }
 
-    float kiss(const int axis, float rcCommandf, const float rcCommandfAbs)
+    float kiss(const int axis, float rcCommandf, const float rcCommandfAbs) const
     {
       const float rcCurvef = this->rcExpo[axis] / 100.0f;
 
@@ -99,7 +133,7 @@ class Rates
       return kissAngle;
     }
 
-    float actual(const int axis, float rcCommandf, const float rcCommandfAbs)
+    float actual(const int axis, float rcCommandf, const float rcCommandfAbs) const
     {
       float expof = this->rcExpo[axis] / 100.0f;
       expof = rcCommandfAbs * (power5(rcCommandf) * expof + rcCommandf * (1 - expof));
@@ -111,7 +145,7 @@ class Rates
       return angleRate;
     }
 
-    float quick(const int axis, float rcCommandf, const float rcCommandfAbs)
+    float quick(const int axis, float rcCommandf, const float rcCommandfAbs) const
     {
       const float rcRate = this->rcRates[axis] * 2;
       const float maxDPS = std::max(this->rates[axis] * 10.f, rcRate);
@@ -146,6 +180,8 @@ class Rates
     uint8_t rcRates[3];
     uint8_t rates[3];
     int16_t rateLimit[3];
+    float lut[3][RATES_LUT_SIZE];
+    float lutLimit[3];
 };
 
 } // namespace Espfc
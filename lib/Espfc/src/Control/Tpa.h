@@ -0,0 +1,77 @@
+#ifndef _ESPFC_TPA_H_
+#define _ESPFC_TPA_H_
+
+#include "ModelConfig.h"
+#include "Math/Utils.h"
+
+#define TPA_LUT_SIZE 17 // points over 1000-2000us throttle
+
+namespace Espfc {
+
+// Throttle pid attenuation. Curve points and legacy breakpoint/scale are merged
+// into one table at begin, loop only interpolates and applies per axis weights.
+class Tpa
+{
+  public:
+    void begin(const ModelConfig& config)
+    {
+      for(size_t i = 0; i < TPA_LUT_SIZE; i++)
+      {
+        const float t = i * (1.f / (TPA_LUT_SIZE - 1));
+        _lut[i] = curve(config, t) * linear(config, 1000.f + t * 1000.f);
+      }
+      for(size_t i = 0; i <= AXIS_YAW; i++)
+      {
+        _pWeight[i] = std::min(config.tpaP[i], TPA_WEIGHT_MAX) * 0.01f;
+        _dWeight[i] = std::min(config.tpaD[i], TPA_WEIGHT_MAX) * 0.01f;
+      }
+    }
+
+    // throttle [us]
+    float getFactor(float throttle) const
+    {
+      const float x = Math::clamp((throttle - 1000.f) * 0.001f, 0.f, 1.f) * (TPA_LUT_SIZE - 1);
+      const size_t i = std::min((size_t)x, (size_t)(TPA_LUT_SIZE - 2));
+      const float f = x - i;
+      return _lut[i] + (_lut[i + 1] - _lut[i]) * f;
+    }
+
+    // throttle [us], writes pterm and dterm gain factors for roll, pitch and yaw
+    void update(float throttle, float * pFactor, float * dFactor) const
+    {
+      const float delta = getFactor(throttle) - 1.f;
+      for(size_t i = 0; i <= AXIS_YAW; i++)
+      {
+        pFactor[i] = 1.f + delta * _pWeight[i];
+        dFactor[i] = 1.f + delta * _dWeight[i];
+      }
+    }
+
+  private:
+    // curve points are evenly spread over throttle range, in percent, limited as over msp
+    static float curve(const ModelConfig& config, float t)
+    {
+      const float x = t * (TPA_CURVE_POINTS - 1);
+      const size_t i = std::min((size_t)x, (size_t)(TPA_CURVE_POINTS - 2));
+      const float f = x - i;
+      const float a = std::min(config.tpaCurve[i], TPA_CURVE_MAX);
+      const float b = std::min(config.tpaCurve[i + 1], TPA_CURVE_MAX);
+      return (a + (b - a) * f) * 0.01f;
+    }
+
+    // legacy single breakpoint, scale in percent reduction at full throttle
+    static float linear(const ModelConfig& config, float throttle)
+    {
+      if(config.tpaScale == 0 || config.tpaBreakpoint >= 2000) return 1.f;
+      const float t = Math::clamp(throttle, (float)config.tpaBreakpoint, 2000.f);
+      return Math::map(t, (float)config.tpaBreakpoint, 2000.f, 1.f, 1.f - ((float)config.tpaScale * 0.01f));
+    }
+
+    float _lut[TPA_LUT_SIZE];
+    float _pWeight[AXIS_YAW + 1];
+    float _dWeight[AXIS_YAW + 1];
+};
+
+}
+
+#endif
@@ -4,18 +4,25 @@
 #include "Model.h"
 #include "Math/Utils.h"
 #include "Control/Rates.h"
+#include "Control/Feedforward.h"
 
 namespace Espfc {
 
 class Controller
 {
   public:
-    Controller(Model& model): _model(model) {}
+    Controller(Model& model): _model(model), _tiltLimitCos(1.f), _inputFrameCount(0) {}
 
     int begin()
     {
       _rates.begin(_model.config.input);
       _speedFilter.begin(FilterConfig(FILTER_BIQUAD, 10), _model.state.loopTimer.rate);
+      _tiltLimitCos = cosf(radians(_model.config.angleLimit));
+      for(size_t i = 0; i <= AXIS_YAW; i++)
+      {
+        _feedforward[i].begin(_model.config.feedforwardAveraging, _model.config.feedforwardBoost, _model.config.feedforwardJitter);
+      }
+      _inputFrameCount = _model.state.inputFrameCount;
       return 1;
     }
 
@@ -51,6 +58,7 @@ class Controller
         }
         else
         {
+          updateFeedforward();
           outerLoop();
         }
       }
@@ -97,16 +105,15 @@ class Controller
 
     void innerLoopRobot()
     {
-      //VectorFloat v(0.f, 0.f, 1.f);
-      //v.rotate(_model.state.angleQ);
-      //const float angle = acos(v.z);
-      const float angle = std::max(abs(_model.state.angle[AXIS_PITCH]), abs(_model.state.angle[AXIS_ROLL]));
+      // tilt from vertical is compared as cosine, no need for acos
+      const VectorFloat up = _model.getUpVector();
+      const float pitch = getPitch(up);
 
-      const bool stabilize = angle < radians(_model.config.angleLimit);
+      const bool stabilize = up.z > _tiltLimitCos;
       if(stabilize)
       {
-        _model.state.output[AXIS_PITCH] = _model.state.innerPid[AXIS_PITCH].update(_model.state.desiredAngle[AXIS_PITCH], _model.state.angle[AXIS_PITCH]);
-        _model.state.output[AXIS_YAW]   = _model.state.innerPid[AXIS_YAW].update(_model.state.desiredRate[AXIS_YAW], _model.state.gyro[AXIS_YAW]);
+        _model.state.output[AXIS_PITCH] = _model.state.innerPid.update(AXIS_PITCH, _model.state.desiredAngle[AXIS_PITCH], pitch);
+        _model.state.output[AXIS_YAW]   = _model.state.innerPid.update(AXIS_YAW, _model.state.desiredRate[AXIS_YAW], _model.state.gyro[AXIS_YAW]);
       }
       else
       {
@@ -117,25 +124,47 @@ class Controller
 
       if(_model.config.debugMode == DEBUG_ANGLERATE)
       {
-        _model.state.debug[2] = lrintf(degrees(_model.state.angle[AXIS_PITCH]) * 10);
+        _model.state.debug[2] = lrintf(degrees(pitch) * 10);
         _model.state.debug[3] = lrintf(_model.state.output[AXIS_PITCH] * 1000);
       }
     }
 
     void outerLoop()
     {
-      if(_model.isActive(MODE_ANGLE))
+      const bool angle = _model.isActive(MODE_ANGLE);
+      const bool horizon = !angle && _model.isActive(MODE_HORIZON);
+      if(angle || horizon)
       {
+        // attitude error as quaternion, no euler angles of current attitude needed
+        const float angleLimit = radians(_model.config.angleLimit);
         _model.state.desiredAngle = VectorFloat(
-          _model.state.input[AXIS_ROLL] * radians(_model.config.angleLimit),
-          _model.state.input[AXIS_PITCH] * radians(_model.config.angleLimit),
-          _model.state.angle[AXIS_YAW]
+          _model.state.input[AXIS_ROLL] * angleLimit,
+          _model.state.input[AXIS_PITCH] * angleLimit,
+          0.f
         );
-        _model.state.desiredRate[AXIS_ROLL]  = _model.state.outerPid[AXIS_ROLL].update(_model.state.desiredAngle[AXIS_ROLL], _model.state.angle[AXIS_ROLL]);
-        _model.state.desiredRate[AXIS_PITCH] = _model.state.outerPid[AXIS_PITCH].update(_model.state.desiredAngle[AXIS_PITCH], _model.state.angle[AXIS_PITCH]);
-        // disable fterm in angle mode
-        _model.state.innerPid[AXIS_ROLL].fScale = 0.f;
-        _model.state.innerPid[AXIS_PITCH].fScale = 0.f;
+        _model.state.desiredAngleQ = getDesiredAttitude(_model.state.angleQ, _model.state.desiredAngle.x, _model.state.desiredAngle.y);
+        const VectorFloat error = getAttitudeError(_model.state.angleQ, _model.state.desiredAngleQ);
+        // measure is desired minus error, so pterm and iterm see the quaternion error,
+        // dterm the attitude change and fterm the stick angle change
+        const VectorFloat& desired = _model.state.desiredAngle;
+        _model.state.desiredRate[AXIS_ROLL]  = _model.state.outerPid[AXIS_ROLL].update(desired.x, desired.x - error.x);
+        _model.state.desiredRate[AXIS_PITCH] = _model.state.outerPid[AXIS_PITCH].update(desired.y, desired.y - error.y);
+        if(horizon)
+        {
+          // self leveling fades out towards full stick
+          const float strength = getHorizonStrength();
+          for(size_t i = AXIS_ROLL; i <= AXIS_PITCH; i++)
+          {
+            const float rate = calculateSetpointRate(i, _model.state.input[i]);
+            _model.state.desiredRate[i] = rate + (_model.state.desiredRate[i] - rate) * strength;
+          }
+        }
+        else
+        {
+          // disable fterm in angle mode
+          _model.state.innerPid.fScale[AXIS_ROLL] = 0.f;
+          _model.state.innerPid.fScale[AXIS_PITCH] = 0.f;
+        }
       }
       else
       {
@@ -154,22 +183,84 @@ class Controller
       }
     }
 
-    void innerLoop()
+    // level strength in horizon mode, 1 at center stick, 0 past horizon stick limit
+    float getHorizonStrength() const
+    {
+      const float deflection = std::max(std::abs(_model.state.input[AXIS_ROLL]), std::abs(_model.state.input[AXIS_PITCH]));
+      const float limit = Math::clamp((int)_model.config.horizonLimitSticks, 1, 100) * 0.01f;
+      return Math::clamp(1.f - deflection / limit, 0.f, 1.f);
+    }
+
+    // once per rc frame, from frame setpoints rather than interpolated input
+    void updateFeedforward()
     {
-      const float tpaFactor = getTpaFactor();
-      for(size_t i = 0; i <= AXIS_YAW; ++i)
+      // rx lost or frames late, stale stick speed must not stay in fterm
+      const int32_t frameAge = _model.state.loopTimer.last - _model.state.inputFrameTime;
+      if(_model.state.inputRxLoss || frameAge > (int32_t)(2 * _model.state.inputFrameDelta))
       {
-        _model.state.output[i] = _model.state.innerPid[i].update(_model.state.desiredRate[i], _model.state.gyro[i]) * tpaFactor;
-        //_model.state.debug[i] = lrintf(_model.state.innerPid[i].fTerm * 1000);
+        for(size_t i = 0; i <= AXIS_YAW; i++)
+        {
+          _feedforward[i].stop();
+          _model.state.innerPid.feedforward[i] = 0.f;
+        }
+        _inputFrameCount = _model.state.inputFrameCount;
+        return;
+      }
+
+      if(_model.state.inputFrameCount == _inputFrameCount) return;
+      _inputFrameCount = _model.state.inputFrameCount;
+
+      const float interval = _model.state.inputFrameDelta * 0.000001f;
+      for(size_t i = 0; i <= AXIS_YAW; i++)
+      {
+        const InputChannelConfig& ich = _model.config.input.channel[i];
+        const float stick = Math::map(_model.state.inputBuffer[i], ich.min, ich.max, -1.f, 1.f);
+        const float rcDelta = _model.state.inputBuffer[i] - _model.state.inputBufferPrevious[i];
+        _model.state.innerPid.feedforward[i] = _feedforward[i].update(calculateSetpointRate(i, stick), rcDelta, interval);
+      }
+
+      if(_model.config.debugMode == DEBUG_FF_INTERPOLATED)
+      {
+        _model.state.debug[0] = lrintf(degrees(_model.state.innerPid.feedforward[AXIS_ROLL]) * 0.1f);
+        _model.state.debug[1] = _model.state.inputBuffer[AXIS_ROLL] - _model.state.inputBufferPrevious[AXIS_ROLL];
+        _model.state.debug[2] = lrintf(degrees(_model.state.innerPid.feedforward[AXIS_PITCH]) * 0.1f);
+        _model.state.debug[3] = _model.state.inputBuffer[AXIS_PITCH] - _model.state.inputBufferPrevious[AXIS_PITCH];
       }
-      _model.state.output[AXIS_THRUST] = _model.state.desiredRate[AXIS_THRUST];
     }
 
-    float getTpaFactor() const
+    void innerLoop()
     {
-      if(_model.config.tpaScale == 0) return 1.f;
-      float t = Math::clamp(_model.state.inputUs[AXIS_THRUST], (float)_model.config.tpaBreakpoint, 2000.f);
-      return Math::map(t, (float)_model.config.tpaBreakpoint, 2000.f, 1.f, 1.f - ((float)_model.config.tpaScale * 0.01f));
+      const float measure[] = { _model.state.gyro[AXIS_ROLL], _model.state.gyro[AXIS_PITCH], _model.state.gyro[AXIS_YAW] };
+      PidBank& pid = _model.state.innerPid;
+      _model.state.tpa.update(_model.state.inputUs[AXIS_THRUST], pid.pTpa, pid.dTpa);
+      if(pid.antiGravityMask)
+      {
+        pid.updateAntiGravity(Math::clamp((_model.state.input[AXIS_THRUST] + 1.f) * 0.5f, 0.f, 1.f));
+      }
+      pid.update(_model.state.desiredRate, measure, _model.state.output);
+      _model.state.output[AXIS_THRUST] = _model.state.desiredRate[AXIS_THRUST];
+
+      if(_model.config.debugMode == DEBUG_ITERM_RELAX)
+      {
+        _model.state.debug[0] = lrintf(pid.itermRelaxFactor[AXIS_ROLL] * 100);
+        _model.state.debug[1] = lrintf(pid.itermRelaxFactor[AXIS_PITCH] * 100);
+        _model.state.debug[2] = lrintf(pid.itermRelaxFactor[AXIS_YAW] * 100);
+        _model.state.debug[3] = lrintf(pid.iTerm[AXIS_ROLL] * 1000);
+      }
+      if(_model.config.debugMode == DEBUG_D_MIN)
+      {
+        _model.state.debug[0] = lrintf(pid.dMinFactor[AXIS_ROLL] * 100);
+        _model.state.debug[1] = lrintf(pid.dMinFactor[AXIS_PITCH] * 100);
+        _model.state.debug[2] = lrintf(pid.dTerm[AXIS_ROLL] * 1000);
+        _model.state.debug[3] = lrintf(pid.dTerm[AXIS_PITCH] * 1000);
+      }
+      if(_model.config.debugMode == DEBUG_ANTI_GRAVITY)
+      {
+        _model.state.debug[0] = lrintf(pid.iBoost * 1000);
+        _model.state.debug[1] = lrintf(pid.throttleDelta * 1000);
+        _model.state.debug[2] = lrintf(pid.iTerm[AXIS_ROLL] * 1000);
+        _model.state.debug[3] = lrintf(pid.iTerm[AXIS_PITCH] * 1000);
+      }
     }
 
     void resetIterm()
@@ -180,7 +271,7 @@ class Controller
       {
         for(size_t i = 0; i < AXES; i++)
         {
-          _model.state.innerPid[i].iTerm = 0;
+          if(i < PidBank::SIZE) _model.state.innerPid.iTerm[i] = 0;
           _model.state.outerPid[i].iTerm = 0;
         }
       }
@@ -192,6 +283,45 @@ class Controller
       return _rates.getSetpoint(axis, input);
     }
 
+    static float getRoll(const VectorFloat& up)
+    {
+      return atan2f(up.y, up.z);
+    }
+
+    static float getPitch(const VectorFloat& up)
+    {
+      return asinf(Math::clamp(-up.x, -1.f, 1.f));
+    }
+
+    // tilt as single rotation about horizontal axis, roll and pitch components [rad]
+    static Quaternion getTiltQuaternion(float roll, float pitch)
+    {
+      const float angle = sqrtf(roll * roll + pitch * pitch);
+      if(angle < 1e-6f) return Quaternion();
+      const float s = sinf(angle * 0.5f) / angle;
+      return Quaternion(cosf(angle * 0.5f), roll * s, pitch * s, 0.f);
+    }
+
+    // current heading, taken as twist of attitude about earth z, with tilt from sticks
+    static Quaternion getDesiredAttitude(const Quaternion& q, float roll, float pitch)
+    {
+      Quaternion heading(q.w, 0.f, 0.f, q.z);
+      const float n = heading.w * heading.w + heading.z * heading.z;
+      if(n > 1e-6f) heading *= invSqrt(n);
+      else heading = Quaternion(); // upside down, heading undefined
+      return heading * getTiltQuaternion(roll, pitch);
+    }
+
+    // rotation vector from current to desired attitude in body frame [rad]
+    static VectorFloat getAttitudeError(const Quaternion& q, const Quaternion& desired)
+    {
+      Quaternion e = q.getConjugate() * desired;
+      if(e.w < 0.f) e *= -1.f; // shortest way
+      const float s = sqrtf(e.x * e.x + e.y * e.y + e.z * e.z);
+      const float k = s > 1e-6f ? 2.f * atan2f(s, e.w) / s : 2.f;
+      return VectorFloat(e.x * k, e.y * k, e.z * k);
+    }
+
   private:
     float power3(float x)
     {
@@ -200,7 +330,10 @@ class Controller
 
     Model& _model;
     Rates _rates;
+    Feedforward _feedforward[AXIS_YAW + 1];
     Filter _speedFilter;
+    float _tiltLimitCos;
+    uint32_t _inputFrameCount;
 
 };
 
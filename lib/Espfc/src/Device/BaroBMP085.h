@@ -58,6 +58,14 @@ class BaroBMP085: public BaroDevice
 
       _bus->read(_addr, BMP085_CALIB_REG, sizeof(CalibrationData), (uint8_t*)&_cal);
 
+      // calibration words are stored msb first
+      uint16_t * cal = (uint16_t*)&_cal;
+      for(size_t i = 0; i < sizeof(CalibrationData) / 2; i++)
+      {
+        cal[i] = (cal[i] >> 8) | (cal[i] << 8);
+      }
+      _t_fine = 0;
+
       return 1;
     }
 
@@ -68,11 +76,62 @@ class BaroBMP085: public BaroDevice
 
     virtual float readTemperature() override
     {
-      uint8_t buffer[2];
-      _bus->read(_addr, BMP085_MEASUREMENT_REG, 2, buffer);
+      _bus->read(_addr, BMP085_MEASUREMENT_REG, 2, _buffer);
+      return compensateTemperature();
+    }
+
+    virtual float readPressure() override
+    {
+      _bus->read(_addr, BMP085_MEASUREMENT_REG, 3, _buffer);
+      return compensatePressure();
+    }
+
+    virtual int readTemperatureAsync(float& t) override
+    {
+      int8_t status = readAsync(_addr, BMP085_MEASUREMENT_REG, 2, _buffer);
+      if(status <= 0) return status;
+      t = compensateTemperature();
+      return 1;
+    }
+
+    virtual int readPressureAsync(float& p) override
+    {
+      int8_t status = readAsync(_addr, BMP085_MEASUREMENT_REG, 3, _buffer);
+      if(status <= 0) return status;
+      p = compensatePressure();
+      return 1;
+    }
+
+    // conversion start remains blocking, it is a single byte write
+    void setMode(BaroDeviceMode mode)
+    {
+      _mode = mode == BARO_MODE_TEMP ? BMP085_MEASURE_T : BMP085_MEASURE_P0;
+      _bus->writeByte(_addr, BMP085_CONTROL_REG, _mode);
+    }
+
+    virtual int getDelay() const override
+    {
+      const int comp = 50;
+      if(_mode == BMP085_MEASURE_T) return 4500 + comp;        // temp
+      else if(_mode == BMP085_MEASURE_P0) return 4500 + comp;  // press_0
+      else if(_mode == BMP085_MEASURE_P1) return 7500 + comp;  // press_1
+      else if(_mode == BMP085_MEASURE_P2) return 13500 + comp; // press_2
+      else if(_mode == BMP085_MEASURE_P3) return 25500 + comp; // press_3
+      else return 4500 + 50; // invalid mode
+    }
+
+    bool testConnection() override
+    {
+      uint8_t whoami = 0;
+      _bus->readByte(_addr, BMP085_WHOAMI_REG, &whoami);
+      return whoami == BMP085_WHOAMI_ID;
+    }
 
+  protected:
+    float compensateTemperature()
+    {
       // calbrate temp
-      int32_t ut = ((uint16_t)buffer[0] << 8) + buffer[1];
+      int32_t ut = ((uint16_t)_buffer[0] << 8) + _buffer[1];
       if(ut == 0) return NAN;
 
       int32_t x1 = ((ut - (int32_t)_cal.ac6) * (int32_t)_cal.ac5) >> 15;
@@ -82,12 +141,9 @@ class BaroBMP085: public BaroDevice
       return (float)((_t_fine + 8) >> 4) / 10.0f;
     }
 
-    virtual float readPressure() override
+    float compensatePressure()
     {
-      uint8_t buffer[3];
-      _bus->read(_addr, BMP085_MEASUREMENT_REG, 3, buffer);
-
-      uint32_t up = ((uint32_t)buffer[0] << 16) + ((uint16_t)buffer[1] << 8) + buffer[2];
+      uint32_t up = ((uint32_t)_buffer[0] << 16) + ((uint16_t)_buffer[1] << 8) + _buffer[2];
       if(_mode & 0x34) up = up >> (8 - ((_mode & 0xC0) >> 6));
 
       if(up == 0) return NAN;
@@ -116,31 +172,7 @@ class BaroBMP085: public BaroDevice
       return p + ((x1 + x2 + (int32_t)3791) >> 4);
     }
 
-    void setMode(BaroDeviceMode mode)
-    {
-      _mode = mode == BARO_MODE_TEMP ? BMP085_MEASURE_T : BMP085_MEASURE_P0;
-      _bus->writeByte(_addr, BMP085_CONTROL_REG, _mode);
-    }
-
-    virtual int getDelay() const override
-    {
-      const int comp = 50;
-      if(_mode == BMP085_MEASURE_T) return 4500 + comp;        // temp
-      else if(_mode == BMP085_MEASURE_P0) return 4500 + comp;  // press_0
-      else if(_mode == BMP085_MEASURE_P1) return 7500 + comp;  // press_1
-      else if(_mode == BMP085_MEASURE_P2) return 13500 + comp; // press_2
-      else if(_mode == BMP085_MEASURE_P3) return 25500 + comp; // press_3
-      else return 4500 + 50; // invalid mode
-    }
-
-    bool testConnection() override
-    {
-      uint8_t whoami = 0;
-      _bus->readByte(_addr, BMP085_WHOAMI_REG, &whoami);
-      return whoami == BMP085_WHOAMI_ID;
-    }
-
-  protected:
+    uint8_t _buffer[3];
     int8_t _mode;
     int32_t _t_fine;
     CalibrationData _cal;
@@ -20,6 +20,10 @@
 #define BMP280_PRESSURE_REG           0xF7
 #define BMP280_TEMPERATURE_REG        0xFA
 
+#if defined(ESP8266)
+#define BMP280_COMPENSATION_INT32 // no hardware 64 bit multiply, datasheet 32 bit variant, 1Pa resolution
+#endif
+
 namespace Espfc {
 
 namespace Device {
@@ -64,9 +68,12 @@ class BaroBMP280: public BaroDevice
 
       _bus->read(_addr, BMP280_CALIB_REG, sizeof(CalibrationData), (uint8_t*)&_cal);
 
+      // normal mode, device converts continuously, results are only read out
+      _bus->writeByte(_addr, BMP280_CONFIG_REG, 0); // standby: 0.5ms, filter: off
+
       uint8_t conf = 0;
       conf |= (1 << 5); // osps_t: x1
-      conf |= (1 << 2); // osps_p: x1
+      conf |= (2 << 2); // osps_p: x2
       conf |= 3;        // mode: normal;
       _bus->writeByte(_addr, BMP280_CONTROL_REG, conf);
 
@@ -80,7 +87,65 @@ class BaroBMP280: public BaroDevice
 
     virtual float readTemperature() override
     {
-      int32_t adc_T = readReg(BMP280_TEMPERATURE_REG);
+      return compensateTemperature(readReg(BMP280_TEMPERATURE_REG));
+    }
+
+    virtual float readPressure() override
+    {
+      return compensatePressure(readReg(BMP280_PRESSURE_REG));
+    }
+
+    virtual int readTemperatureAsync(float& t) override
+    {
+      int8_t status = readAsync(_addr, BMP280_TEMPERATURE_REG, 3, _buffer);
+      if(status <= 0) return status;
+      t = compensateTemperature(toAdc(_buffer));
+      return 1;
+    }
+
+    virtual int readPressureAsync(float& p) override
+    {
+      int8_t status = readAsync(_addr, BMP280_PRESSURE_REG, 3, _buffer);
+      if(status <= 0) return status;
+      p = compensatePressure(toAdc(_buffer));
+      return 1;
+    }
+
+    // pressure and temperature registers are adjacent, burst read comes from the same measurement
+    virtual int readTemperaturePressureAsync(float& t, float& p) override
+    {
+      int8_t status = readAsync(_addr, BMP280_PRESSURE_REG, 6, _buffer);
+      if(status <= 0) return status;
+      t = compensateTemperature(toAdc(_buffer + 3));
+      p = compensatePressure(toAdc(_buffer));
+      return 1;
+    }
+
+    bool isContinuous() const override
+    {
+      return true;
+    }
+
+    void setMode(BaroDeviceMode mode)
+    {
+      (void)mode;
+    }
+
+    virtual int getDelay() const override
+    {
+      return 9300; // max conversion time for osrs_t x1, osrs_p x2 and 0.5ms standby
+    }
+
+    bool testConnection() override
+    {
+      uint8_t whoami = 0;
+      _bus->readByte(_addr, BMP280_WHOAMI_REG, &whoami);
+      return whoami == BMP280_WHOAMI_ID;
+    }
+
+  protected:
+    float compensateTemperature(int32_t adc_T)
+    {
       adc_T >>= 4;
 
       int32_t var1 = ((((adc_T >> 3) - ((int32_t)_cal.dig_T1 << 1))) * ((int32_t)_cal.dig_T2)) >> 11;
@@ -91,9 +156,45 @@ class BaroBMP280: public BaroDevice
       return T * 0.01f;
     }
 
-    virtual float readPressure() override
+    float compensatePressure(int32_t adc_P)
+    {
+#if defined(BMP280_COMPENSATION_INT32)
+      return compensatePressure32(adc_P);
+#else
+      return compensatePressure64(adc_P) * (1.f / 256);
+#endif
+    }
+
+    // pressure [Pa]
+    uint32_t compensatePressure32(int32_t adc_P)
+    {
+      adc_P >>= 4;
+
+      int32_t var1 = (_t_fine >> 1) - 64000;
+      int32_t var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * (int32_t)_cal.dig_P6;
+      var2 += (var1 * (int32_t)_cal.dig_P5) << 1;
+      var2 = (var2 >> 2) + ((int32_t)_cal.dig_P4 << 16);
+      var1 = ((((int32_t)_cal.dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + (((int32_t)_cal.dig_P2 * var1) >> 1)) >> 18;
+      var1 = ((32768 + var1) * (int32_t)_cal.dig_P1) >> 15;
+
+      if (var1 == 0) {
+        return 0;  // avoid exception caused by division by zero
+      }
+      uint32_t p = ((uint32_t)(1048576 - adc_P) - (var2 >> 12)) * 3125;
+      if(p < 0x80000000) {
+        p = (p << 1) / (uint32_t)var1;
+      } else {
+        p = (p / (uint32_t)var1) * 2;
+      }
+      var1 = ((int32_t)_cal.dig_P9 * (int32_t)(((p >> 3) * (p >> 3)) >> 13)) >> 12;
+      var2 = ((int32_t)(p >> 2) * (int32_t)_cal.dig_P8) >> 13;
+
+      return (uint32_t)((int32_t)p + ((var1 + var2 + _cal.dig_P7) >> 4));
+    }
+
+    // pressure [Pa] in Q24.8
+    uint32_t compensatePressure64(int32_t adc_P)
     {
-      int32_t adc_P = readReg(BMP280_PRESSURE_REG);
       adc_P >>= 4;
 
       int64_t var1 = ((int64_t)_t_fine) - 128000;
@@ -113,36 +214,21 @@ class BaroBMP280: public BaroDevice
 
       p = ((p + var1 + var2) >> 8) + (((int64_t)_cal.dig_P7) << 4);
 
-      return (float)p / 256;
-    }
-
-    void setMode(BaroDeviceMode mode)
-    {
-      (void)mode;
-    }
-
-    virtual int getDelay() const override
-    {
-      return 5500;
-      //const int comp = 50;
-      //return 4500 + comp;        // temp
+      return (uint32_t)p;
     }
 
-    bool testConnection() override
+    int32_t readReg(uint8_t reg)
     {
-      uint8_t whoami = 0;
-      _bus->readByte(_addr, BMP280_WHOAMI_REG, &whoami);
-      return whoami == BMP280_WHOAMI_ID;
+      _bus->readFast(_addr, reg, 3, _buffer);
+      return toAdc(_buffer);
     }
 
-  protected:
-    int32_t readReg(uint8_t reg)
+    static int32_t toAdc(const uint8_t * buffer)
     {
-      uint8_t buffer[3];
-      _bus->readFast(_addr, reg, 3, buffer);
       return buffer[2] | (buffer[1] << 8) | (buffer[0] << 16);
     }
 
+    uint8_t _buffer[6];
     int8_t _mode;
     int32_t _t_fine;
     CalibrationData _cal;
@@ -34,14 +34,65 @@ class BaroDevice: public BusAwareDevice
 
     virtual float readTemperature() = 0;
     virtual float readPressure() = 0;
+
+    // non-blocking reads, return 1 when value is ready, 0 while pending, -1 on error
+    virtual int readTemperatureAsync(float& t)
+    {
+      t = readTemperature();
+      return 1;
+    }
+
+    virtual int readPressureAsync(float& p)
+    {
+      p = readPressure();
+      return 1;
+    }
+
+    // continuous devices convert on their own, temperature and pressure are read together in one transfer
+    virtual bool isContinuous() const
+    {
+      return false;
+    }
+
+    virtual int readTemperaturePressureAsync(float& t, float& p)
+    {
+      (void)t; (void)p;
+      return -1;
+    }
+
+    // conversion time in triggered mode, measurement period in continuous mode [us]
     virtual int getDelay() const = 0;
     virtual void setMode(BaroDeviceMode mode) = 0;
 
     virtual bool testConnection() = 0;
 
+    // 44330 * (1 - (p / p0) ^ 0.1903), tabulated over flight envelope (-800m to 5500m),
+    // quadratic interpolation keeps error below 1cm, powf is used only outside of table
     float getAltitude(float pressure, float seaLevelPressure = 101325.f)
     {
-      return 44330.f * (1.f - powf(pressure / seaLevelPressure, 0.1903));
+      static const float table[] = {
+        5478.148f, 5331.461f, 5187.085f, 5044.939f, 4904.949f, 4767.042f, 4631.151f, 4497.211f, 4365.160f, 4234.940f,
+        4106.495f, 3979.771f, 3854.719f, 3731.290f, 3609.436f, 3489.115f, 3370.283f, 3252.901f, 3136.928f, 3022.329f,
+        2909.066f, 2797.106f, 2686.415f, 2576.963f, 2468.718f, 2361.651f, 2255.733f, 2150.938f, 2047.239f, 1944.612f,
+        1843.030f, 1742.472f, 1642.914f, 1544.334f, 1446.712f, 1350.026f, 1254.256f, 1159.384f, 1065.391f, 972.259f,
+        879.970f, 788.508f, 697.856f, 607.998f, 518.920f, 430.605f, 343.040f, 256.211f, 170.103f, 84.704f,
+        0.000f, -84.021f, -167.370f, -250.061f, -332.104f, -413.510f, -494.292f, -574.459f, -654.021f, -732.989f,
+        -811.372f,
+      };
+      static const size_t size = sizeof(table) / sizeof(table[0]);
+      const float ratio = pressure / seaLevelPressure; // table starts at 0.5 with 0.01 step
+
+      const float x = (ratio - 0.5f) * 100.f;
+      if(!(x >= 0.f && x <= size - 1)) return 44330.f * (1.f - powf(ratio, 0.1903f));
+
+      // nearest node as center of three point interpolation
+      size_t i = (size_t)(x + 0.5f);
+      if(i < 1) i = 1;
+      if(i > size - 2) i = size - 2;
+      const float t = x - i;
+      const float a = table[i - 1], b = table[i], c = table[i + 1];
+
+      return b + 0.5f * t * (c - a) + 0.5f * t * t * (c - 2.f * b + a);
     }
 
     static const char ** getNames()
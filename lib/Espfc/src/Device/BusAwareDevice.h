@@ -23,9 +23,28 @@ class BusAwareDevice
     }
 
   protected:
+    // non-blocking read, polls bus for one slice, returns 0 while pending, length when done, -1 on error
+    int8_t readAsync(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data)
+    {
+      if(_transfer.state == BUS_TRANSFER_IDLE)
+      {
+        _transfer.prepare(devAddr, regAddr, length, data, false);
+        if(!_bus->submit(_transfer)) return 0; // queue full, retry next time
+      }
+      if(_transfer.state == BUS_TRANSFER_PENDING)
+      {
+        _bus->process(ESPFC_BUS_SLICE_TIME);
+        if(_transfer.state == BUS_TRANSFER_PENDING) return 0;
+      }
+      int8_t status = _transfer.state == BUS_TRANSFER_DONE ? length : -1;
+      _transfer.state = BUS_TRANSFER_IDLE;
+      return status;
+    }
+
     BusDevice * _bus;
     uint8_t _addr;
     uint8_t _masterAddr;
+    BusTransfer _transfer;
 };
 
 }
@@ -5,6 +5,8 @@
 #include <Arduino.h>
 
 #define ESPFC_BUS_TIMEOUT 100
+#define ESPFC_BUS_QUEUE_SIZE 4
+#define ESPFC_BUS_SLICE_TIME 50 // max time [us] spent on queued transfers per poll
 
 namespace Espfc {
 
@@ -16,13 +18,59 @@ enum BusType {
   BUS_MAX
 };
 
+enum BusTransferState {
+  BUS_TRANSFER_IDLE,
+  BUS_TRANSFER_PENDING,
+  BUS_TRANSFER_DONE,
+  BUS_TRANSFER_ERROR,
+};
+
 namespace Device {
 
+struct BusTransfer
+{
+  BusTransfer(): devAddr(0), regAddr(0), length(0), data(nullptr), write(false), state(BUS_TRANSFER_IDLE) {}
+
+  void prepare(uint8_t devAddr_, uint8_t regAddr_, uint8_t length_, uint8_t *data_, bool write_)
+  {
+    devAddr = devAddr_;
+    regAddr = regAddr_;
+    length = length_;
+    data = data_;
+    write = write_;
+    state = BUS_TRANSFER_IDLE;
+  }
+
+  uint8_t devAddr;
+  uint8_t regAddr;
+  uint8_t length;
+  uint8_t *data;
+  bool write;
+  volatile BusTransferState state;
+};
+
 class BusDevice
 {
   public:
     virtual BusType getType() const = 0;
 
+    // queue transfer, caller owns it and polls its state, returns false if already pending or queue is full
+    // default implementation executes transfer immediately
+    virtual bool submit(BusTransfer& t)
+    {
+      if(t.state == BUS_TRANSFER_PENDING) return false;
+      bool status = t.write ? write(t.devAddr, t.regAddr, t.length, t.data) : read(t.devAddr, t.regAddr, t.length, t.data) == t.length;
+      t.state = status ? BUS_TRANSFER_DONE : BUS_TRANSFER_ERROR;
+      return true;
+    }
+
+    // advance queued transfers for up to budget [us] (0 - no limit), returns number of pending transfers
+    virtual size_t process(uint32_t budget)
+    {
+      (void)budget;
+      return 0;
+    }
+
     virtual int8_t read(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t timeout = ESPFC_BUS_TIMEOUT) = 0;
 
     virtual int8_t readFast(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t timeout = ESPFC_BUS_TIMEOUT) = 0;
@@ -2,6 +2,9 @@
 #define _ESPFC_DEVICE_BUSI2C_H_
 
 #include "BusDevice.h"
+#if defined(ESPFC_I2C_0_SOFT)
+#include "esp_twi.h"
+#endif
 
 namespace Espfc {
 
@@ -10,7 +13,12 @@ namespace Device {
 class BusI2C: public BusDevice
 {
   public:
-    BusI2C(WireClass& i2c): _dev(i2c) {}
+    BusI2C(WireClass& i2c): _dev(i2c), _head(0), _count(0)
+    {
+#if defined(ESPFC_I2C_0_SOFT)
+      _xfer.state = ESP_TWI_XFER_IDLE;
+#endif
+    }
 
     BusType getType() const override { return BUS_I2C; }
 
@@ -29,6 +37,8 @@ class BusI2C: public BusDevice
 
     int8_t read(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t timeout = ESPFC_BUS_TIMEOUT) override
     {
+      finish();
+
       int8_t count = 0;
       uint32_t t1 = millis();
 
@@ -55,6 +65,8 @@ class BusI2C: public BusDevice
 
     bool write(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t* data) override
     {
+      finish();
+
       //Serial.print("I2C W "); Serial.print(devAddr, HEX); Serial.print(' '); Serial.print(regAddr, HEX); Serial.print(' '); Serial.println(length);
 
       _dev.beginTransmission(devAddr);
@@ -71,8 +83,70 @@ class BusI2C: public BusDevice
       return status == 0;
     }
 
+    bool submit(BusTransfer& t) override
+    {
+      if(t.state == BUS_TRANSFER_PENDING || _count >= ESPFC_BUS_QUEUE_SIZE) return false;
+      t.state = BUS_TRANSFER_PENDING;
+      _queue[(_head + _count) % ESPFC_BUS_QUEUE_SIZE] = &t;
+      _count++;
+      return true;
+    }
+
+    size_t process(uint32_t budget) override
+    {
+      uint32_t start = micros();
+      while(_count)
+      {
+        uint32_t elapsed = micros() - start;
+        if(budget && elapsed >= budget) break;
+        if(!step(*_queue[_head], budget ? budget - elapsed : 0)) break;
+        _head = (_head + 1) % ESPFC_BUS_QUEUE_SIZE;
+        _count--;
+      }
+      return _count;
+    }
+
   private:
+    // returns true if transfer is completed
+    bool step(BusTransfer& t, uint32_t budget)
+    {
+#if defined(ESPFC_I2C_0_SOFT)
+      if(_xfer.state == ESP_TWI_XFER_IDLE)
+      {
+        esp_twi_xfer_init(&_xfer, t.devAddr, t.regAddr, t.data, t.length, !t.write);
+      }
+      uint8_t status = esp_twi_xfer_step(&_xfer, budget);
+      if(status < ESP_TWI_XFER_DONE) return false;
+      _xfer.state = ESP_TWI_XFER_IDLE;
+      t.state = status == ESP_TWI_XFER_DONE ? BUS_TRANSFER_DONE : BUS_TRANSFER_ERROR;
+      if(onError && t.state == BUS_TRANSFER_ERROR) onError();
+#else
+      // hardware driver can't be suspended, transfer is executed at once
+      (void)budget;
+      bool status = t.write ? write(t.devAddr, t.regAddr, t.length, t.data) : read(t.devAddr, t.regAddr, t.length, t.data) == t.length;
+      t.state = status ? BUS_TRANSFER_DONE : BUS_TRANSFER_ERROR;
+#endif
+      return true;
+    }
+
+    // complete transfer in progress, bus must be released before blocking access
+    void finish()
+    {
+#if defined(ESPFC_I2C_0_SOFT)
+      if(_xfer.state == ESP_TWI_XFER_IDLE || !_count) return;
+      step(*_queue[_head], 0);
+      _head = (_head + 1) % ESPFC_BUS_QUEUE_SIZE;
+      _count--;
+#endif
+    }
+
     WireClass& _dev;
+    BusTransfer* _queue[ESPFC_BUS_QUEUE_SIZE];
+    size_t _head;
+    size_t _count;
+#if defined(ESPFC_I2C_0_SOFT)
+    esp_twi_xfer_t _xfer;
+#endif
 };
 
 }
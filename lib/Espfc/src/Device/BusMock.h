@@ -0,0 +1,333 @@
+#ifndef _ESPFC_DEVICE_BUSMOCK_H_
+#define _ESPFC_DEVICE_BUSMOCK_H_
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <cstring>
+#include "BusDevice.h"
+#include "GyroDevice.h"
+#include "MagDevice.h"
+#include "BaroDevice.h"
+
+// MPU9250 auxiliary i2c master registers used to reach AK8963
+#define BUSMOCK_MPU_SLV0_ADDR     0x25
+#define BUSMOCK_MPU_SLV0_REG      0x26
+#define BUSMOCK_MPU_SLV0_CTRL     0x27
+#define BUSMOCK_MPU_SLV0_DO       0x63
+#define BUSMOCK_MPU_EXT_SENS_DATA 0x49
+
+namespace Espfc {
+
+namespace Device {
+
+// Emulates register maps of slave devices and records every transaction, native env only.
+class BusMock: public BusDevice
+{
+  public:
+    struct Transaction
+    {
+      uint32_t time;
+      uint8_t devAddr;
+      uint8_t regAddr;
+      bool write;
+      bool ack;
+      std::vector<uint8_t> data;
+    };
+
+    struct Slave
+    {
+      Slave(): auxAddr(0) { std::memset(regs, 0, sizeof(regs)); }
+      uint8_t regs[256];
+      std::map<uint8_t, std::deque<std::vector<uint8_t> > > samples;
+      uint8_t auxAddr; // aux i2c slave attached to this device (MPU9250 -> AK8963)
+    };
+
+    BusMock(BusType type = BUS_I2C): transactionCount(0), byteCount(0), recording(true), _type(type), _async(false) {}
+
+    BusType getType() const override { return _type; }
+
+    int begin(int p0, int p1, int p2)
+    {
+      (void)p0; (void)p1; (void)p2;
+      return 1;
+    }
+
+    int8_t readFast(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t timeout = ESPFC_BUS_TIMEOUT) override
+    {
+      return read(devAddr, regAddr, length, data, timeout);
+    }
+
+    int8_t read(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t timeout = ESPFC_BUS_TIMEOUT) override
+    {
+      (void)timeout;
+      Slave * s = find(devAddr);
+      if(!s)
+      {
+        // i2c gets nack, spi reads floating line
+        std::memset(data, _type == BUS_SPI ? 0xff : 0, length);
+        record(devAddr, regAddr, false, false, data, length);
+        if(onError && _type == BUS_I2C) onError();
+        return _type == BUS_SPI ? length : 0;
+      }
+      if(s->auxAddr && regAddr == BUSMOCK_MPU_EXT_SENS_DATA) auxTransfer(*s);
+      load(*s, regAddr);
+      for(size_t i = 0; i < length; i++)
+      {
+        data[i] = s->regs[(regAddr + i) & 0xff];
+      }
+      record(devAddr, regAddr, false, true, data, length);
+      return length;
+    }
+
+    bool write(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t* data) override
+    {
+      Slave * s = find(devAddr);
+      record(devAddr, regAddr, true, s != nullptr, data, length);
+      if(!s)
+      {
+        if(onError) onError();
+        return false;
+      }
+      for(size_t i = 0; i < length; i++)
+      {
+        s->regs[(regAddr + i) & 0xff] = data[i];
+      }
+      if(s->auxAddr && regAddr == BUSMOCK_MPU_SLV0_CTRL) auxTransfer(*s);
+      return true;
+    }
+
+    // in async mode transfers are queued and completed one per process() call
+    void setAsync(bool async)
+    {
+      _async = async;
+    }
+
+    bool submit(BusTransfer& t) override
+    {
+      if(!_async) return BusDevice::submit(t);
+      if(t.state == BUS_TRANSFER_PENDING || _queue.size() >= ESPFC_BUS_QUEUE_SIZE) return false;
+      t.state = BUS_TRANSFER_PENDING;
+      _queue.push_back(&t);
+      return true;
+    }
+
+    size_t process(uint32_t budget) override
+    {
+      (void)budget;
+      if(_queue.empty()) return 0;
+      BusTransfer * t = _queue.front();
+      _queue.pop_front();
+      bool status = t->write ? write(t->devAddr, t->regAddr, t->length, t->data) : read(t->devAddr, t->regAddr, t->length, t->data) == t->length;
+      t->state = status ? BUS_TRANSFER_DONE : BUS_TRANSFER_ERROR;
+      return _queue.size();
+    }
+
+    Slave& addSlave(uint8_t devAddr)
+    {
+      return _slaves[devAddr];
+    }
+
+    void removeSlave(uint8_t devAddr)
+    {
+      _slaves.erase(devAddr);
+    }
+
+    Slave * find(uint8_t devAddr)
+    {
+      auto it = _slaves.find(devAddr);
+      return it != _slaves.end() ? &it->second : nullptr;
+    }
+
+    void setRegister(uint8_t devAddr, uint8_t regAddr, uint8_t value)
+    {
+      addSlave(devAddr).regs[regAddr] = value;
+    }
+
+    void setRegisters(uint8_t devAddr, uint8_t regAddr, const uint8_t * data, size_t length)
+    {
+      Slave& s = addSlave(devAddr);
+      for(size_t i = 0; i < length; i++) s.regs[(regAddr + i) & 0xff] = data[i];
+    }
+
+    uint8_t getRegister(uint8_t devAddr, uint8_t regAddr)
+    {
+      Slave * s = find(devAddr);
+      return s ? s->regs[regAddr] : 0;
+    }
+
+    // queue sample, it is loaded into registers on next read starting at regAddr
+    void pushSample(uint8_t devAddr, uint8_t regAddr, const std::vector<uint8_t>& data)
+    {
+      addSlave(devAddr).samples[regAddr].push_back(data);
+    }
+
+    void pushSample(uint8_t devAddr, uint8_t regAddr, int16_t x, int16_t y, int16_t z, bool bigEndian = true)
+    {
+      std::vector<uint8_t> data;
+      for(int16_t v: { x, y, z })
+      {
+        uint8_t h = (uint16_t)v >> 8, l = (uint16_t)v & 0xff;
+        data.push_back(bigEndian ? h : l);
+        data.push_back(bigEndian ? l : h);
+      }
+      pushSample(devAddr, regAddr, data);
+    }
+
+    size_t pendingSamples(uint8_t devAddr, uint8_t regAddr)
+    {
+      Slave * s = find(devAddr);
+      return s ? s->samples[regAddr].size() : 0;
+    }
+
+    // feed recorded reads back as sample streams
+    void replay(const std::vector<Transaction>& log)
+    {
+      for(const auto& t: log)
+      {
+        if(t.write || !t.ack) continue;
+        pushSample(t.devAddr, t.regAddr, t.data);
+      }
+    }
+
+    void addGyro(GyroDeviceType type, uint8_t devAddr)
+    {
+      switch(type)
+      {
+        case GYRO_MPU6050: setRegister(devAddr, 0x75, 0x68); break;
+        case GYRO_MPU9250: setRegister(devAddr, 0x75, 0x71); break;
+        case GYRO_ICM20602: setRegister(devAddr, 0x75, 0x12); break;
+        case GYRO_LSM6DSO: setRegister(devAddr, 0x0F, 0x6C); break;
+        default: break;
+      }
+    }
+
+    // for AK8963 devAddr is address of master gyro
+    void addMag(MagDeviceType type, uint8_t devAddr)
+    {
+      switch(type)
+      {
+        case MAG_HMC5883:
+        {
+          const uint8_t id[] = { 'H', '4', '3' };
+          setRegisters(devAddr, 0x0A, id, sizeof(id));
+          break;
+        }
+        case MAG_AK8963:
+        {
+          const uint8_t ak = 0x0C;
+          const uint8_t asa[] = { 128, 128, 128 }; // unit sensitivity adjustment
+          addSlave(devAddr).auxAddr = ak;
+          setRegister(ak, 0x00, 0x48);
+          setRegisters(ak, 0x10, asa, sizeof(asa));
+          break;
+        }
+        default: break;
+      }
+    }
+
+    // calibration data taken from datasheets examples
+    void addBaro(BaroDeviceType type, uint8_t devAddr)
+    {
+      switch(type)
+      {
+        case BARO_BMP280:
+        {
+          const int16_t cal[] = { 27504, 26435, -1000, (int16_t)36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000 };
+          setRegister(devAddr, 0xD0, 0x58);
+          for(size_t i = 0; i < 12; i++)
+          {
+            setRegister(devAddr, 0x88 + i * 2, (uint16_t)cal[i] & 0xff);
+            setRegister(devAddr, 0x89 + i * 2, (uint16_t)cal[i] >> 8);
+          }
+          const uint8_t adc[] = { 0x65, 0x5A, 0xC0, 0x7E, 0xED, 0x00 }; // adc_P = 415148, adc_T = 519888
+          setRegisters(devAddr, 0xF7, adc, sizeof(adc));
+          break;
+        }
+        case BARO_BMP085:
+        {
+          const int16_t cal[] = { 408, -72, -14383, (int16_t)32741, (int16_t)32757, 23153, 6190, 4, -32768, -8711, 2868 };
+          setRegister(devAddr, 0xD0, 0x55);
+          for(size_t i = 0; i < 11; i++)
+          {
+            setRegister(devAddr, 0xAA + i * 2, (uint16_t)cal[i] >> 8);
+            setRegister(devAddr, 0xAB + i * 2, (uint16_t)cal[i] & 0xff);
+          }
+          break;
+        }
+        default: break;
+      }
+    }
+
+    const std::vector<Transaction>& getTransactions() const
+    {
+      return _transactions;
+    }
+
+    void reset()
+    {
+      _transactions.clear();
+      transactionCount = 0;
+      byteCount = 0;
+    }
+
+    size_t transactionCount;
+    size_t byteCount; // register address and data bytes
+    bool recording;
+
+  private:
+    void load(Slave& s, uint8_t regAddr)
+    {
+      auto it = s.samples.find(regAddr);
+      if(it == s.samples.end() || it->second.empty()) return;
+      const std::vector<uint8_t>& sample = it->second.front();
+      for(size_t i = 0; i < sample.size(); i++)
+      {
+        s.regs[(regAddr + i) & 0xff] = sample[i];
+      }
+      it->second.pop_front();
+    }
+
+    // execute slave 0 transfer configured in master registers
+    void auxTransfer(Slave& master)
+    {
+      uint8_t ctrl = master.regs[BUSMOCK_MPU_SLV0_CTRL];
+      if(!(ctrl & 0x80)) return;
+      uint8_t addr = master.regs[BUSMOCK_MPU_SLV0_ADDR];
+      uint8_t reg = master.regs[BUSMOCK_MPU_SLV0_REG];
+      Slave * aux = find(addr & 0x7f);
+      if(!aux) return;
+      if(addr & 0x80)
+      {
+        load(*aux, reg);
+        for(size_t i = 0; i < (ctrl & 0x0f); i++)
+        {
+          master.regs[BUSMOCK_MPU_EXT_SENS_DATA + i] = aux->regs[(reg + i) & 0xff];
+        }
+      }
+      else
+      {
+        aux->regs[reg] = master.regs[BUSMOCK_MPU_SLV0_DO];
+      }
+    }
+
+    void record(uint8_t devAddr, uint8_t regAddr, bool write, bool ack, const uint8_t * data, uint8_t length)
+    {
+      transactionCount++;
+      byteCount += length + 1;
+      if(!recording) return;
+      _transactions.push_back(Transaction{ (uint32_t)micros(), devAddr, regAddr, write, ack, std::vector<uint8_t>(data, data + length) });
+    }
+
+    BusType _type;
+    bool _async;
+    std::map<uint8_t, Slave> _slaves;
+    std::vector<Transaction> _transactions;
+    std::deque<BusTransfer*> _queue;
+};
+
+}
+
+}
+
+#endif
@@ -114,13 +114,13 @@ class GyroLSM6DSO: public GyroDevice
     {
       int16_t buffer[3];
 
-      _bus->readFast(_addr, LSM6DSO_REG_OUTX_L_G, 6, (uint8_t*)buffer);
+      int8_t status = _bus->readFast(_addr, LSM6DSO_REG_OUTX_L_G, 6, (uint8_t*)buffer);
 
       v.x = buffer[0];
       v.y = buffer[1];
       v.z = buffer[2];
 
-      return 1;
+      return status == 6;
     }
 
     int readAccel(VectorInt16& v) override
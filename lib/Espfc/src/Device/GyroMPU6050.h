@@ -116,13 +116,13 @@ class GyroMPU6050: public GyroDevice
     {
       uint8_t buffer[6];
 
-      _bus->readFast(_addr, MPU6050_RA_GYRO_XOUT_H, 6, buffer);
+      int8_t status = _bus->readFast(_addr, MPU6050_RA_GYRO_XOUT_H, 6, buffer);
 
       v.x = (((int16_t)buffer[0]) << 8) | buffer[1];
       v.y = (((int16_t)buffer[2]) << 8) | buffer[3];
       v.z = (((int16_t)buffer[4]) << 8) | buffer[5];
 
-      return 1;
+      return status == 6;
     }
 
     int readAccel(VectorInt16& v) override
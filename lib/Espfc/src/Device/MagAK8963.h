@@ -100,6 +100,18 @@ class MagAK8963: public MagDevice
     int readMag(VectorInt16& v) override
     {
       _bus->readFast(_masterAddr, MPU9250_EXT_SENS_DATA_00, 6, buffer);
+      return decode(v);
+    }
+
+    int readMagAsync(VectorInt16& v) override
+    {
+      int8_t status = readAsync(_masterAddr, MPU9250_EXT_SENS_DATA_00, 6, buffer);
+      if(status <= 0) return status;
+      return decode(v);
+    }
+
+    int decode(VectorInt16& v) const
+    {
       // align CW90_FLIP (swap X Y, invert Z)
       v.y =  ((((int16_t)buffer[1]) << 8) | buffer[0]);
       v.x =  ((((int16_t)buffer[3]) << 8) | buffer[2]);
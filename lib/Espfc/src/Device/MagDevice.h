@@ -29,6 +29,13 @@ class MagDevice: public BusAwareDevice
     virtual DeviceType getType() const = 0;
 
     virtual int readMag(VectorInt16& v) = 0;
+
+    // non-blocking read, returns 1 when sample is ready, 0 while pending, -1 on error
+    virtual int readMagAsync(VectorInt16& v)
+    {
+      return readMag(v);
+    }
+
     virtual const VectorFloat convert(const VectorInt16& v) const = 0;
     virtual int getRate() const = 0;
 
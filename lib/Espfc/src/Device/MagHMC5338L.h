@@ -99,16 +99,15 @@ class MagHMC5338L: public MagDevice
 
     int readMag(VectorInt16& v) override
     {
-      uint8_t buffer[6];
-      _bus->read(_addr, HMC5883L_RA_DATAX_H, 6, buffer);
-      if (_mode == HMC5883L_MODE_SINGLE)
-      {
-        _bus->writeByte(_addr, HMC5883L_RA_MODE, HMC5883L_MODE_SINGLE << (HMC5883L_MODEREG_BIT - HMC5883L_MODEREG_LENGTH + 1));
-      }
-      v.x = (((int16_t)buffer[0]) << 8) | buffer[1];
-      v.z = (((int16_t)buffer[2]) << 8) | buffer[3];
-      v.y = (((int16_t)buffer[4]) << 8) | buffer[5];
-      return 1;
+      _bus->read(_addr, HMC5883L_RA_DATAX_H, 6, _buffer);
+      return decode(v);
+    }
+
+    int readMagAsync(VectorInt16& v) override
+    {
+      int8_t status = readAsync(_addr, HMC5883L_RA_DATAX_H, 6, _buffer);
+      if(status <= 0) return status;
+      return decode(v);
     }
 
     const VectorFloat convert(const VectorInt16& v) const override
@@ -159,7 +158,20 @@ class MagHMC5338L: public MagDevice
     }
 
   private:
+    int decode(VectorInt16& v)
+    {
+      if (_mode == HMC5883L_MODE_SINGLE)
+      {
+        _bus->writeByte(_addr, HMC5883L_RA_MODE, HMC5883L_MODE_SINGLE << (HMC5883L_MODEREG_BIT - HMC5883L_MODEREG_LENGTH + 1));
+      }
+      v.x = (((int16_t)_buffer[0]) << 8) | _buffer[1];
+      v.z = (((int16_t)_buffer[2]) << 8) | _buffer[3];
+      v.y = (((int16_t)_buffer[4]) << 8) | _buffer[5];
+      return 1;
+    }
+
     uint8_t _mode;
+    uint8_t _buffer[6];
 };
 
 }
@@ -3,6 +3,7 @@
 
 #include "Math/Utils.h"
 #include <cmath>
+#include <cstdint>
 
 // Quick median filter implementation
 // (c) N. Devillard - 1998
@@ -318,6 +319,53 @@ class Filter
       }
     }
 
+    // same stage of several channels, type switch hoisted out of channel loop,
+    // channels with mask bit cleared are skipped and keep their state
+    static void update(Filter * f, float * v, size_t n, uint32_t mask = 0xffffffff)
+    {
+      const int8_t type = f[0]._conf.type;
+      for(size_t i = 1; i < n; i++)
+      {
+        if(f[i]._conf.type != type) // mixed types, dispatch per channel
+        {
+          for(size_t j = 0; j < n; j++)
+          {
+            if(mask & (1u << j)) v[j] = f[j].update(v[j]);
+          }
+          return;
+        }
+      }
+      switch(type)
+      {
+        case FILTER_PT1:
+          for(size_t i = 0; i < n; i++) if(mask & (1u << i)) v[i] = f[i]._state.pt1.update(v[i]);
+          break;
+        case FILTER_BIQUAD:
+        case FILTER_NOTCH:
+        case FILTER_BPF:
+          for(size_t i = 0; i < n; i++) if(mask & (1u << i)) v[i] = f[i]._state.bq.update(v[i]);
+          break;
+        case FILTER_NOTCH_DF1:
+          for(size_t i = 0; i < n; i++) if(mask & (1u << i)) v[i] = f[i]._state.bq.updateDF1(v[i]);
+          break;
+        case FILTER_FIR2:
+          for(size_t i = 0; i < n; i++) if(mask & (1u << i)) v[i] = f[i]._state.fir2.update(v[i]);
+          break;
+        case FILTER_MEDIAN3:
+          for(size_t i = 0; i < n; i++) if(mask & (1u << i)) v[i] = f[i]._state.median.update(v[i]);
+          break;
+        case FILTER_PT2:
+          for(size_t i = 0; i < n; i++) if(mask & (1u << i)) v[i] = f[i]._state.pt2.update(v[i]);
+          break;
+        case FILTER_PT3:
+          for(size_t i = 0; i < n; i++) if(mask & (1u << i)) v[i] = f[i]._state.pt3.update(v[i]);
+          break;
+        case FILTER_NONE:
+        default:
+          ;
+      }
+    }
+
     void reset()
     {
       switch(_conf.type)
@@ -4,13 +4,19 @@
 #include "Model.h"
 #include "Madgwick.h"
 #include "Mahony.h"
+#include "Math/AttitudeEkf.h"
+
+#define ESPFC_FUSION_EKF_GYRO_NOISE  0.01f   // [rad/s/sqrt(Hz)]
+#define ESPFC_FUSION_EKF_BIAS_NOISE  0.0005f // [rad/s/sqrt(s)]
+#define ESPFC_FUSION_EKF_ACCEL_NOISE 0.1f    // normalized gravity direction
+#define ESPFC_FUSION_EKF_MAG_NOISE   1.0f    // heading [rad], high as each mag sample is applied on every accel update
 
 namespace Espfc {
 
 class Fusion
 {
   public:
-    Fusion(Model& model): _model(model), _first(true) {}
+    Fusion(Model& model): _model(model), _first(true), _accelDeviation(0.f) {}
     int begin()
     {
       _model.state.gyroPoseQ = Quaternion();
@@ -22,6 +28,10 @@ class Fusion
       _mahony.setKp(_model.config.fusion.gain * 0.1f);
       _mahony.setKi(_model.config.fusion.gainI * 0.1f);
 
+      _ekf.begin(ESPFC_FUSION_EKF_GYRO_NOISE, ESPFC_FUSION_EKF_BIAS_NOISE);
+      _accelDeviation = 0.f;
+      _first = true;
+
       _model.logger.info().log(F("FUSION")).log(FPSTR(FusionConfig::getModeName((FusionMode)_model.config.fusion.mode))).logln(_model.config.fusion.gain);
 
       return 1;
@@ -69,6 +79,9 @@ class Fusion
           case FUSION_EXPERIMENTAL:
             experimentalFusion();
             break;
+          case FUSION_EKF:
+            ekfFusion();
+            break;
           case FUSION_NONE:
           default:
             ;
@@ -78,9 +91,10 @@ class Fusion
 
        if(_model.config.debugMode == DEBUG_ALTITUDE)
        {
-         _model.state.debug[0] = lrintf(degrees(_model.state.angle[0]) * 10);
-         _model.state.debug[1] = lrintf(degrees(_model.state.angle[1]) * 10);
-         _model.state.debug[2] = lrintf(degrees(_model.state.angle[2]) * 10);
+         const VectorFloat angle = _model.getAngle();
+         _model.state.debug[0] = lrintf(degrees(angle[0]) * 10);
+         _model.state.debug[1] = lrintf(degrees(angle[1]) * 10);
+         _model.state.debug[2] = lrintf(degrees(angle[2]) * 10);
        }
        return 1;
     }
@@ -101,61 +115,65 @@ class Fusion
 
     void experimentalFusion()
     {
-      // Experiment: workaround for 90 deg limit on pitch[y] axis
-      Quaternion r = Quaternion::lerp(Quaternion(), _model.state.accel.accelToQuaternion(), 0.5);
-      _model.state.angle.eulerFromQuaternion(r);
-      _model.state.angle *= 2.f;
+      // attitude from accel only, quaternion has no 90 deg limit on pitch[y] axis
+      _model.state.angleQ = _model.state.accel.accelToQuaternion();
     }
 
     void simpleFusion()
     {
       _model.state.pose = _model.state.accel.accelToEuler();
-      _model.state.angle.x = _model.state.pose.x;
-      _model.state.angle.y = _model.state.pose.y;
-      _model.state.angle.z += _model.state.gyroTimer.intervalf * _model.state.gyro.z;
-      if(_model.state.angle.z > PI) _model.state.angle.z -= TWO_PI;
-      if(_model.state.angle.z < -PI) _model.state.angle.z += TWO_PI;
+      _angle.x = _model.state.pose.x;
+      _angle.y = _model.state.pose.y;
+      _angle.z += _model.state.accelTimer.intervalf * _model.state.gyro.z;
+      if(_angle.z > PI) _angle.z -= TWO_PI;
+      if(_angle.z < -PI) _angle.z += TWO_PI;
+      _model.state.angleQ = _angle.eulerToQuaternion();
     }
 
+    // per axis filter works on euler angles by design
     void kalmanFusion()
     {
       _model.state.pose = _model.state.accel.accelToEuler();
-      _model.state.pose.z = _model.state.angle.z;
-      const float dt = _model.state.gyroTimer.intervalf;
+      _model.state.pose.z = _angle.z;
+      const float dt = _model.state.accelTimer.intervalf;
       for(size_t i = 0; i < 3; i++)
       {
         float angle = _model.state.kalman[i].getAngle(_model.state.pose.get(i), _model.state.gyro.get(i), dt);
-        _model.state.angle.set(i, angle);
+        _angle.set(i, angle);
         //_model.state.rate.set(i, _model.state.kalman[i].getRate());
       }
-      _model.state.angleQ = _model.state.angle.eulerToQuaternion();
+      _model.state.angleQ = _angle.eulerToQuaternion();
     }
 
     void complementaryFusion()
     {
-      _model.state.pose = _model.state.accel.accelToEuler();
-      _model.state.pose.z = _model.state.angle.z;
-      const float dt = _model.state.gyroTimer.intervalf;
+      const float dt = _model.state.accelTimer.intervalf;
       const float alpha = 0.002f;
-      for(size_t i = 0; i < 3; i++)
+
+      // tilt error between measured and estimated gravity, small angle approximation
+      VectorFloat rate = _model.state.gyro;
+      const float norm = _model.state.accel.x * _model.state.accel.x + _model.state.accel.y * _model.state.accel.y + _model.state.accel.z * _model.state.accel.z;
+      if(norm > 0.f)
       {
-        float angle = (_model.state.angle[i] + _model.state.gyro[i] * dt) * (1.f - alpha) + _model.state.pose[i] * alpha;
-        if(angle > PI) angle -= TWO_PI;
-        if(angle < -PI) angle += TWO_PI;
-        _model.state.angle.set(i, angle);
+        VectorFloat error = VectorFloat::crossProduct(_model.state.accel, _model.getUpVector());
+        rate += error * (invSqrt(norm) * alpha / dt);
       }
-      _model.state.angleQ = _model.state.angle.eulerToQuaternion();
-      //_model.state.angle.eulerFromQuaternion(_model.state.angleQ); // causes NaN
+      integrate(_model.state.angleQ, rate, dt);
     }
 
-    void complementaryFusionOld()
+    // q' = q + q * (0, w) * dt / 2
+    static void integrate(Quaternion& q, const VectorFloat& w, float dt)
     {
-      const float alpha = 0.01f;
-      const float dt = _model.state.gyroTimer.intervalf;
-      _model.state.pose = _model.state.accel.accelToEuler();
-      _model.state.pose.z = _model.state.angle.z;
-      _model.state.angle = (_model.state.angle + _model.state.gyro * dt) * (1.f - alpha) + _model.state.pose * alpha;
-      _model.state.angleQ = _model.state.angle.eulerToQuaternion();
+      const float x = w.x * dt * 0.5f;
+      const float y = w.y * dt * 0.5f;
+      const float z = w.z * dt * 0.5f;
+      q = Quaternion(
+        q.w - q.x * x - q.y * y - q.z * z,
+        q.x + q.w * x + q.y * z - q.z * y,
+        q.y + q.w * y - q.x * z + q.z * x,
+        q.z + q.w * z + q.x * y - q.y * x
+      );
+      q.normalize();
     }
 
     void rtqfFusion()
@@ -163,13 +181,12 @@ class Fusion
       float slerpPower = 0.001f;
       if(_first)
       {
-        _model.state.angle = _model.state.pose;
         _model.state.angleQ = _model.state.poseQ;
         _first = false;
         return;
       }
 
-      float timeDelta = _model.state.gyroTimer.intervalf;
+      float timeDelta = _model.state.accelTimer.intervalf;
       Quaternion measuredQPose = _model.state.poseQ;
       Quaternion fusionQPose = _model.state.angleQ;
       VectorFloat fusionGyro = _model.state.gyro;
@@ -215,7 +232,6 @@ class Fusion
       fusionQPose.normalize();
 
       _model.state.angleQ = fusionQPose;
-      _model.state.angle.eulerFromQuaternion(fusionQPose);
     }
 
     void updatePoseFromAccelMag()
@@ -244,7 +260,7 @@ class Fusion
       }
       else
       {
-        _model.state.pose.z = _model.state.angle.z;
+        _model.state.pose.z = _model.getAngle().z;
       }
       _model.state.poseQ = _model.state.pose.eulerToQuaternion();
       _model.state.pose.eulerFromQuaternion(_model.state.poseQ);
@@ -297,7 +313,7 @@ class Fusion
       //_model.state.accelPose.eulerFromQuaternion(_model.state.accelPoseQ);
 
       // predict new state
-      Quaternion rotation = (_model.state.gyro * _model.state.gyroTimer.intervalf).eulerToQuaternion();
+      Quaternion rotation = (_model.state.gyro * _model.state.accelTimer.intervalf).eulerToQuaternion();
       _model.state.gyroPoseQ = (_model.state.gyroPoseQ * rotation).getNormalized();
 
       // drift compensation
@@ -307,6 +323,31 @@ class Fusion
       _model.state.gyroPose.eulerFromQuaternion(_model.state.gyroPoseQ);
     }
 
+    void ekfFusion()
+    {
+      if(_first)
+      {
+        _ekf.reset(_model.state.accel.accelToQuaternion());
+        _first = false;
+      }
+
+      _ekf.predict(_model.state.gyroImu, _model.state.accelTimer.intervalf);
+
+      // trust accel less under dynamic acceleration, level is smoothed as weighting
+      // single samples by their own magnitude biases direction under vibration
+      const float deviation = _model.state.accel.getMagnitude() * ACCEL_G_INV - 1.f;
+      _accelDeviation += (deviation * deviation - _accelDeviation) * 0.02f;
+      _ekf.correctAccel(_model.state.accel, ESPFC_FUSION_EKF_ACCEL_NOISE * (1.f + 10.f * sqrtf(_accelDeviation)));
+
+      if(_model.magActive())
+      {
+        _ekf.correctMag(_model.state.mag, ESPFC_FUSION_EKF_MAG_NOISE);
+      }
+
+      _model.state.angleQ = _ekf.attitude();
+      _model.state.gyroBiasEstimate = _ekf.bias();
+    }
+
     void madgwickFusion()
     {
       if(_model.magActive())
@@ -325,7 +366,6 @@ class Fusion
         );
       }
       _model.state.angleQ = _madgwick.getQuaternion();
-      _model.state.angle  = _madgwick.getEuler();
     }
 
     void madgwickFusion1()
@@ -336,7 +376,6 @@ class Fusion
         0.f, 0.f, 0.f
       );
       _model.state.angleQ = _madgwick.getQuaternion();
-      _model.state.angle  = _madgwick.getEuler();
     }
 
     void madgwickFusion2()
@@ -370,7 +409,6 @@ class Fusion
         );
       }
       _model.state.angleQ = _mahony.getQuaternion();
-      _model.state.angle  = _mahony.getEuler();
     }
 
     void mahonyFusion1()
@@ -381,7 +419,6 @@ class Fusion
         0.f, 0.f, 0.f
       );
       _model.state.angleQ = _mahony.getQuaternion();
-      _model.state.angle  = _mahony.getEuler();
     }
 
     void mahonyFusion2()
@@ -402,6 +439,9 @@ class Fusion
     bool _first;
     Madgwick _madgwick;
     Mahony _mahony;
+    Math::AttitudeEkf _ekf;
+    float _accelDeviation;
+    VectorFloat _angle;
 };
 
 }
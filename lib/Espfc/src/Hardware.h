@@ -5,12 +5,16 @@
 #include "Target/Target.h"
 #include "Model.h"
 #include "Device/BusDevice.h"
+#if defined(UNIT_TEST)
+#include "Device/BusMock.h"
+#else
 #if defined(ESPFC_I2C_0)
 #include "Device/BusI2C.h"
 #endif
 #if defined(ESPFC_SPI_0)
 #include "Device/BusSPI.h"
 #endif
+#endif
 #include "Device/GyroDevice.h"
 #include "Device/GyroMPU6050.h"
 #include "Device/GyroMPU9250.h"
@@ -23,16 +27,25 @@
 #include "Device/BaroBMP280.h"
 
 namespace {
+#if defined(UNIT_TEST)
+  static Espfc::Device::BusMock spiBus(Espfc::BUS_SPI);
+  static Espfc::Device::BusMock i2cBus(Espfc::BUS_I2C);
+#else
 #if defined(ESPFC_SPI_0)
   static Espfc::Device::BusSPI spiBus(ESPFC_SPI_0_DEV);
 #endif
 #if defined(ESPFC_I2C_0)
   static Espfc::Device::BusI2C i2cBus(WireInstance);
+#endif
 #endif
   static Espfc::Device::GyroMPU6050 mpu6050;
   static Espfc::Device::GyroMPU9250 mpu9250;
   static Espfc::Device::GyroLSM6DSO lsm6dso;
   static Espfc::Device::GyroICM20602 icm20602;
+  static Espfc::Device::GyroMPU6050 mpu6050_2;
+  static Espfc::Device::GyroMPU9250 mpu9250_2;
+  static Espfc::Device::GyroLSM6DSO lsm6dso_2;
+  static Espfc::Device::GyroICM20602 icm20602_2;
   static Espfc::Device::MagHMC5338L hmc5883l;
   static Espfc::Device::MagAK8963 ak8963;
   static Espfc::Device::BaroBMP085 bmp085;
@@ -105,6 +118,40 @@ class Hardware
       _model.state.gyroPresent = (bool)detectedGyro;
       _model.state.accelPresent = _model.state.gyroPresent && _model.config.accelDev != GYRO_NONE;
       _model.state.gyroClock = detectedGyro->getRate();
+
+      if(_model.config.gyroSelect != GYRO_SELECT_FIRST) detectGyro2();
+    }
+
+    // second gyro on spi cs2, or on i2c if first one is on spi, or on alternate i2c address
+    void detectGyro2()
+    {
+      Espfc::Device::GyroDevice * detectedGyro = nullptr;
+#if defined(ESPFC_SPI_0)
+      if(_model.config.pin[PIN_SPI_CS2] != -1)
+      {
+        pinMode(_model.config.pin[PIN_SPI_CS2], OUTPUT);
+        digitalWrite(_model.config.pin[PIN_SPI_CS2], HIGH);
+        if(!detectedGyro && detectDevice(mpu9250_2, spiBus, _model.config.pin[PIN_SPI_CS2])) detectedGyro = &mpu9250_2;
+        if(!detectedGyro && detectDevice(icm20602_2, spiBus, _model.config.pin[PIN_SPI_CS2])) detectedGyro = &icm20602_2;
+        if(!detectedGyro && detectDevice(lsm6dso_2, spiBus, _model.config.pin[PIN_SPI_CS2])) detectedGyro = &lsm6dso_2;
+      }
+#endif
+#if defined(ESPFC_I2C_0)
+      if(_model.config.pin[PIN_I2C_0_SDA] != -1 && _model.config.pin[PIN_I2C_0_SCL] != -1)
+      {
+        bool firstI2C = _model.state.gyroDev->getBus()->getType() == BUS_I2C;
+        uint8_t addr = firstI2C ? MPU6050_ADDRESS_AD0_HIGH : MPU6050_ADDRESS_AD0_LOW;
+        if(!detectedGyro && detectDevice(mpu9250_2, i2cBus, addr)) detectedGyro = &mpu9250_2;
+        if(!detectedGyro && detectDevice(mpu6050_2, i2cBus, addr)) detectedGyro = &mpu6050_2;
+        if(!detectedGyro && detectDevice(icm20602_2, i2cBus, addr)) detectedGyro = &icm20602_2;
+        if(!detectedGyro && !firstI2C && detectDevice(lsm6dso_2, i2cBus)) detectedGyro = &lsm6dso_2;
+      }
+#endif
+      if(!detectedGyro) return;
+
+      detectedGyro->setDLPFMode(_model.config.gyroDlpf);
+      _model.state.gyroDev2 = detectedGyro;
+      _model.state.gyroClock = std::min(_model.state.gyroClock, (int32_t)detectedGyro->getRate());
     }
 
     void detectMag()
@@ -158,20 +205,21 @@ class Hardware
       _model.state.baroPresent = (bool)detectedBaro;
     }
 
-#if defined(ESPFC_SPI_0)
-    template<typename Dev>
-    bool detectDevice(Dev& dev, Device::BusSPI& bus, int cs)
+#if defined(ESPFC_SPI_0) || defined(ESPFC_I2C_0)
+    // cs pin for spi or device address for i2c
+    template<typename Dev, typename Bus>
+    bool detectDevice(Dev& dev, Bus& bus, int cs)
     {
       typename Dev::DeviceType type = dev.getType();
       bool status = dev.begin(&bus, cs);
-      _model.logger.info().log(F("SPI DETECT")).log(FPSTR(Dev::getName(type))).log(cs).logln(status);
+      _model.logger.info().log(bus.getType() == BUS_SPI ? F("SPI DETECT") : F("I2C DETECT")).log(FPSTR(Dev::getName(type))).log(cs).logln(status);
       return status;
     }
 #endif
 
 #if defined(ESPFC_I2C_0)
-    template<typename Dev>
-    bool detectDevice(Dev& dev, Device::BusI2C& bus)
+    template<typename Dev, typename Bus>
+    bool detectDevice(Dev& dev, Bus& bus)
     {
       typename Dev::DeviceType type = dev.getType();
       bool status = dev.begin(&bus);
@@ -316,9 +316,9 @@ class Input
           {
             _model.state.inputFilter[i].reconfigure(conf, _model.state.loopTimer.rate);
           }
-          if(_model.config.input.filterDerivative.freq == 0)
+          if(_model.config.input.filterDerivative.freq == 0 && i < PidBank::SIZE)
           {
-            _model.state.innerPid[i].ftermFilter.reconfigure(confDerivative, _model.state.loopTimer.rate);
+            _model.state.innerPid.ftermFilter[i].reconfigure(confDerivative, _model.state.loopTimer.rate);
           }
         }
       }
@@ -0,0 +1,124 @@
+#ifndef _ESPFC_MATH_ALTITUDE_KALMAN_H_
+#define _ESPFC_MATH_ALTITUDE_KALMAN_H_
+
+#include <cstddef>
+
+namespace Espfc {
+
+namespace Math {
+
+// Vertical kalman filter, states are altitude, vertical speed and accel bias.
+// Earth frame vertical acceleration drives prediction at accel rate, baro altitude corrects it.
+// Without bias state any accel offset turns into steady vertical speed error.
+class AltitudeKalman
+{
+public:
+  AltitudeKalman(): _accelVariance(1.f), _baroVariance(1.f), _biasVariance(0.f)
+  {
+    reset(0.f);
+  }
+
+  // noise as standard deviation, accel [m/s^2], baro [m], bias drift [m/s^2/sqrt(s)]
+  void begin(float accelNoise, float baroNoise, float biasNoise)
+  {
+    _accelVariance = accelNoise * accelNoise;
+    _baroVariance = baroNoise * baroNoise;
+    _biasVariance = biasNoise * biasNoise;
+    reset(0.f);
+  }
+
+  void reset(float altitude)
+  {
+    _x[0] = altitude;
+    _x[1] = 0.f;
+    _x[2] = 0.f;
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++) _p[i][j] = 0.f;
+    }
+    _p[0][0] = _baroVariance;
+    _p[1][1] = 1.f;
+    _p[2][2] = 0.1f;
+  }
+
+  void predict(float accel, float dt)
+  {
+    const float dt2 = dt * dt * 0.5f;
+    const float a = accel - _x[2];
+    _x[0] += _x[1] * dt + a * dt2;
+    _x[1] += a * dt;
+
+    // P = F P F' + Q, F = [1 dt -dt^2/2; 0 1 -dt; 0 0 1]
+    const float f[3][3] = { { 1.f, dt, -dt2 }, { 0.f, 1.f, -dt }, { 0.f, 0.f, 1.f } };
+    float fp[3][3];
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++)
+      {
+        fp[i][j] = f[i][0] * _p[0][j] + f[i][1] * _p[1][j] + f[i][2] * _p[2][j];
+      }
+    }
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++)
+      {
+        _p[i][j] = fp[i][0] * f[j][0] + fp[i][1] * f[j][1] + fp[i][2] * f[j][2];
+      }
+    }
+
+    // accel noise enters through G = [dt^2/2 dt 0], bias as random walk
+    const float q = _accelVariance;
+    _p[0][0] += q * dt2 * dt2;
+    _p[0][1] += q * dt2 * dt;
+    _p[1][0] += q * dt2 * dt;
+    _p[1][1] += q * dt * dt;
+    _p[2][2] += _biasVariance * dt;
+  }
+
+  void correct(float altitude)
+  {
+    const float s = _p[0][0] + _baroVariance;
+    const float e = altitude - _x[0];
+    float k[3];
+    for(size_t i = 0; i < 3; i++)
+    {
+      k[i] = _p[i][0] / s;
+      _x[i] += k[i] * e;
+    }
+
+    // P = (I - K H) P, H = [1 0 0]
+    const float p0[3] = { _p[0][0], _p[0][1], _p[0][2] };
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++) _p[i][j] -= k[i] * p0[j];
+    }
+  }
+
+  float altitude() const
+  {
+    return _x[0];
+  }
+
+  float velocity() const
+  {
+    return _x[1];
+  }
+
+  float bias() const
+  {
+    return _x[2];
+  }
+
+private:
+  float _accelVariance;
+  float _baroVariance;
+  float _biasVariance;
+  float _x[3];
+  float _p[3][3];
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef _ESPFC_MATH_ATTITUDE_EKF_H_
+#define _ESPFC_MATH_ATTITUDE_EKF_H_
+
+#include <cmath>
+#include <cstddef>
+#include "helper_3dmath.h"
+
+namespace Espfc {
+
+namespace Math {
+
+// Error state kalman filter, nominal state is attitude quaternion (body to earth) and gyro bias.
+// Error state is small body frame rotation and bias error, six states.
+// Covariance is kept as 3x3 blocks [A B; B' C], attitude, cross and bias, so that
+// every update is a handful of fixed size 3x3 products instead of generic 6x6 algebra.
+class AttitudeEkf
+{
+public:
+  AttitudeEkf(): _gyroVariance(0.f), _biasVariance(0.f)
+  {
+    reset(Quaternion());
+  }
+
+  // process noise as spectral density, gyro [rad/s/sqrt(Hz)], bias drift [rad/s/sqrt(s)]
+  void begin(float gyroNoise, float biasNoise)
+  {
+    _gyroVariance = gyroNoise * gyroNoise;
+    _biasVariance = biasNoise * biasNoise;
+    reset(Quaternion());
+  }
+
+  void reset(const Quaternion& q)
+  {
+    _q = q;
+    _bias = VectorFloat();
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++)
+      {
+        _a[i][j] = 0.f;
+        _b[i][j] = 0.f;
+        _c[i][j] = 0.f;
+      }
+      _a[i][i] = 0.1f;   // ~18 deg
+      _c[i][i] = 3e-4f;  // ~1 deg/s
+    }
+  }
+
+  void predict(const VectorFloat& gyro, float dt)
+  {
+    const float wx = (gyro.x - _bias.x) * dt;
+    const float wy = (gyro.y - _bias.y) * dt;
+    const float wz = (gyro.z - _bias.z) * dt;
+
+    // q = q * (1, w/2)
+    const float hx = wx * 0.5f, hy = wy * 0.5f, hz = wz * 0.5f;
+    _q = Quaternion(
+      _q.w - _q.x * hx - _q.y * hy - _q.z * hz,
+      _q.x + _q.w * hx + _q.y * hz - _q.z * hy,
+      _q.y + _q.w * hy - _q.x * hz + _q.z * hx,
+      _q.z + _q.w * hz + _q.x * hy - _q.y * hx
+    );
+    _q.normalize();
+
+    // F = [R -I*dt; 0 I], R = I - [w]x
+    const float r[3][3] = {
+      {  1.f,  wz, -wy },
+      { -wz,  1.f,  wx },
+      {  wy, -wx,  1.f },
+    };
+
+    float ra[3][3], rb[3][3];
+    mul(r, _a, ra);
+    mul(r, _b, rb);
+
+    // A = R A R' - dt (R B + B' R') + dt^2 C + Q
+    const float dt2 = dt * dt;
+    const float qa = _gyroVariance * dt;
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = i; j < 3; j++)
+      {
+        const float raRt = ra[i][0] * r[j][0] + ra[i][1] * r[j][1] + ra[i][2] * r[j][2];
+        const float v = raRt - dt * (rb[i][j] + rb[j][i]) + dt2 * _c[i][j];
+        _a[i][j] = _a[j][i] = v;
+      }
+      _a[i][i] += qa;
+    }
+
+    // B = R B - dt C, C = C + Q
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++) _b[i][j] = rb[i][j] - dt * _c[i][j];
+      _c[i][i] += _biasVariance * dt;
+    }
+  }
+
+  // accel measures gravity direction, noise is std dev of normalized vector
+  void correctAccel(const VectorFloat& accel, float noise)
+  {
+    const float norm = accel.x * accel.x + accel.y * accel.y + accel.z * accel.z;
+    if(norm <= 0.f) return;
+    const float n = invSqrt(norm);
+    const VectorFloat h = up();
+    const float y[3] = { accel.x * n - h.x, accel.y * n - h.y, accel.z * n - h.z };
+
+    // H = [[h]x 0]
+    const float hm[3][3] = {
+      {  0.f, -h.z,  h.y },
+      {  h.z,  0.f, -h.x },
+      { -h.y,  h.x,  0.f },
+    };
+
+    // PH' split into attitude and bias rows
+    float pa[3][3], pb[3][3];
+    mulT(_a, hm, pa);
+    mulTT(_b, hm, pb);
+
+    // S = H A H' + R
+    float s[3][3];
+    mul(hm, pa, s);
+    const float r = noise * noise;
+    for(size_t i = 0; i < 3; i++) s[i][i] += r;
+
+    float si[3][3];
+    if(!invert(s, si)) return;
+
+    float ka[3][3], kb[3][3];
+    mul(pa, si, ka);
+    mul(pb, si, kb);
+
+    float dx[6];
+    for(size_t i = 0; i < 3; i++)
+    {
+      dx[i]     = ka[i][0] * y[0] + ka[i][1] * y[1] + ka[i][2] * y[2];
+      dx[i + 3] = kb[i][0] * y[0] + kb[i][1] * y[1] + kb[i][2] * y[2];
+    }
+
+    // P = P - K S K' = P - K (PH')'
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++)
+      {
+        _a[i][j] -= ka[i][0] * pa[j][0] + ka[i][1] * pa[j][1] + ka[i][2] * pa[j][2];
+        _b[i][j] -= ka[i][0] * pb[j][0] + ka[i][1] * pb[j][1] + ka[i][2] * pb[j][2];
+        _c[i][j] -= kb[i][0] * pb[j][0] + kb[i][1] * pb[j][1] + kb[i][2] * pb[j][2];
+      }
+    }
+    symmetrize();
+    inject(dx);
+  }
+
+  // mag corrects heading only, error is rotation about earth z, noise in [rad]
+  void correctMag(const VectorFloat& mag, float noise)
+  {
+    const VectorFloat m = mag.getRotated(_q);
+    if(m.x * m.x + m.y * m.y <= 0.f) return;
+    const float y = -atan2f(m.y, m.x);
+
+    // H = [h' 0], earth z axis in body frame
+    const VectorFloat h = up();
+    float pa[3], pb[3];
+    for(size_t i = 0; i < 3; i++)
+    {
+      pa[i] = _a[i][0] * h.x + _a[i][1] * h.y + _a[i][2] * h.z;
+      pb[i] = _b[0][i] * h.x + _b[1][i] * h.y + _b[2][i] * h.z;
+    }
+    const float s = pa[0] * h.x + pa[1] * h.y + pa[2] * h.z + noise * noise;
+    if(s <= 0.f) return;
+    const float si = 1.f / s;
+
+    float ka[3], kb[3], dx[6];
+    for(size_t i = 0; i < 3; i++)
+    {
+      ka[i] = pa[i] * si;
+      kb[i] = pb[i] * si;
+      dx[i] = ka[i] * y;
+      dx[i + 3] = kb[i] * y;
+    }
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++)
+      {
+        _a[i][j] -= ka[i] * pa[j];
+        _b[i][j] -= ka[i] * pb[j];
+        _c[i][j] -= kb[i] * pb[j];
+      }
+    }
+    symmetrize();
+    inject(dx);
+  }
+
+  const Quaternion& attitude() const
+  {
+    return _q;
+  }
+
+  const VectorFloat& bias() const
+  {
+    return _bias;
+  }
+
+  // attitude error std dev [rad]
+  float attitudeError() const
+  {
+    return sqrtf(_a[0][0] + _a[1][1] + _a[2][2]);
+  }
+
+private:
+  // earth z axis in body frame
+  VectorFloat up() const
+  {
+    return VectorFloat(
+      2.f * (_q.x * _q.z - _q.w * _q.y),
+      2.f * (_q.y * _q.z + _q.w * _q.x),
+      _q.w * _q.w - _q.x * _q.x - _q.y * _q.y + _q.z * _q.z
+    );
+  }
+
+  void inject(const float * dx)
+  {
+    _q *= Quaternion(1.f, dx[0] * 0.5f, dx[1] * 0.5f, dx[2] * 0.5f);
+    _q.normalize();
+    _bias.x += dx[3];
+    _bias.y += dx[4];
+    _bias.z += dx[5];
+  }
+
+  void symmetrize()
+  {
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = i + 1; j < 3; j++)
+      {
+        _a[i][j] = _a[j][i] = (_a[i][j] + _a[j][i]) * 0.5f;
+        _c[i][j] = _c[j][i] = (_c[i][j] + _c[j][i]) * 0.5f;
+      }
+    }
+  }
+
+  // o = x y
+  static void mul(const float x[3][3], const float y[3][3], float o[3][3])
+  {
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++) o[i][j] = x[i][0] * y[0][j] + x[i][1] * y[1][j] + x[i][2] * y[2][j];
+    }
+  }
+
+  // o = x y'
+  static void mulT(const float x[3][3], const float y[3][3], float o[3][3])
+  {
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++) o[i][j] = x[i][0] * y[j][0] + x[i][1] * y[j][1] + x[i][2] * y[j][2];
+    }
+  }
+
+  // o = x' y'
+  static void mulTT(const float x[3][3], const float y[3][3], float o[3][3])
+  {
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++) o[i][j] = x[0][i] * y[j][0] + x[1][i] * y[j][1] + x[2][i] * y[j][2];
+    }
+  }
+
+  static bool invert(const float m[3][3], float o[3][3])
+  {
+    const float c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    const float c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    const float c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+    const float det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+    if(std::abs(det) < 1e-12f) return false;
+    const float d = 1.f / det;
+    o[0][0] = c00 * d;
+    o[1][0] = c01 * d;
+    o[2][0] = c02 * d;
+    o[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * d;
+    o[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * d;
+    o[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * d;
+    o[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * d;
+    o[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * d;
+    o[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * d;
+    return true;
+  }
+
+  Quaternion _q;
+  VectorFloat _bias;
+  float _gyroVariance;
+  float _biasVariance;
+  float _a[3][3];
+  float _b[3][3];
+  float _c[3][3];
+};
+
+}
+
+}
+
+#endif
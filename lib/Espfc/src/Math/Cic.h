@@ -0,0 +1,87 @@
+#ifndef _ESPFC_MATH_CIC_H_
+#define _ESPFC_MATH_CIC_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#define ESPFC_CIC_ORDER_MAX 3
+#define ESPFC_CIC_RATIO_MAX 32 // 16 bit input + 3 * log2(32) growth fits in 32 bit registers
+
+namespace Espfc {
+
+namespace Math {
+
+// Cascaded integrator-comb decimator, integer only, registers wrap around by design.
+// update() is called at input rate, decimate() every ratio samples.
+class Cic
+{
+public:
+  Cic(): _order(0), _ratio(1), _gain(1.f), _input(0)
+  {
+    reset();
+  }
+
+  void begin(size_t order, size_t ratio)
+  {
+    _order = std::min(order, (size_t)ESPFC_CIC_ORDER_MAX);
+    _ratio = std::max((size_t)1, std::min(ratio, (size_t)ESPFC_CIC_RATIO_MAX));
+    float gain = 1.f;
+    for(size_t i = 0; i < _order; i++) gain *= _ratio;
+    _gain = 1.f / gain;
+    reset();
+  }
+
+  void reset()
+  {
+    for(size_t i = 0; i < ESPFC_CIC_ORDER_MAX; i++)
+    {
+      _integrator[i] = 0;
+      _comb[i] = 0;
+    }
+    _input = 0;
+  }
+
+  void update(int16_t input)
+  {
+    uint32_t v = (uint32_t)(int32_t)input;
+    for(size_t i = 0; i < _order; i++)
+    {
+      _integrator[i] += v;
+      v = _integrator[i];
+    }
+    _input = input;
+  }
+
+  float decimate()
+  {
+    if(!_order) return _input;
+    uint32_t v = _integrator[_order - 1];
+    for(size_t i = 0; i < _order; i++)
+    {
+      uint32_t prev = _comb[i];
+      _comb[i] = v;
+      v -= prev;
+    }
+    return (int32_t)v * _gain;
+  }
+
+  size_t ratio() const
+  {
+    return _ratio;
+  }
+
+private:
+  size_t _order;
+  size_t _ratio;
+  float _gain;
+  int16_t _input;
+  uint32_t _integrator[ESPFC_CIC_ORDER_MAX];
+  uint32_t _comb[ESPFC_CIC_ORDER_MAX];
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,272 @@
+#ifndef _ESPFC_MATH_ELLIPSOID_FIT_H_
+#define _ESPFC_MATH_ELLIPSOID_FIT_H_
+
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include "helper_3dmath.h"
+
+namespace Espfc {
+
+namespace Math {
+
+// Online least squares ellipsoid fit, x'Ax + 2v'x = 1 with symmetric A.
+// Only normal equations are accumulated, memory does not depend on sample count.
+// Sums are kept in double, fourth powers of field lose precision quickly in float.
+class EllipsoidFit
+{
+public:
+  struct Result
+  {
+    VectorFloat offset; // hard iron
+    VectorFloat scale;  // soft iron diagonal
+    VectorFloat cross;  // soft iron xy, xz, yz
+    float radius;       // corrected field strength
+    float error;        // rms relative radius error
+  };
+
+  EllipsoidFit()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    for(size_t i = 0; i < SIZE; i++) _rhs[i] = 0;
+    for(size_t i = 0; i < TRI; i++) _ata[i] = 0;
+    _count = 0;
+  }
+
+  void update(const VectorFloat& v)
+  {
+    double d[SIZE];
+    terms(v, d);
+    size_t k = 0;
+    for(size_t i = 0; i < SIZE; i++)
+    {
+      _rhs[i] += d[i];
+      for(size_t j = i; j < SIZE; j++) _ata[k++] += d[i] * d[j];
+    }
+    _count++;
+  }
+
+  size_t count() const
+  {
+    return _count;
+  }
+
+  bool solve(Result& r) const
+  {
+    if(_count < SIZE * 2) return false;
+
+    double p[SIZE];
+    if(!solveNormal(p)) return false;
+
+    const double a[3][3] = { { p[0], p[3], p[4] }, { p[3], p[1], p[5] }, { p[4], p[5], p[2] } };
+    double ai[3][3];
+    if(!invert(a, ai)) return false;
+
+    // center and ellipsoid scale
+    double c[3], k = 1;
+    for(size_t i = 0; i < 3; i++) c[i] = -(ai[i][0] * p[6] + ai[i][1] * p[7] + ai[i][2] * p[8]);
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++) k += c[i] * a[i][j] * c[j];
+    }
+    if(k <= 0) return false;
+
+    double m[3][3], e[3], vec[3][3];
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++) m[i][j] = a[i][j] / k;
+    }
+    eigen(m, e, vec);
+    if(e[0] <= 0 || e[1] <= 0 || e[2] <= 0) return false;
+
+    // symmetric square root keeps axes unrotated, geometric mean radius keeps magnitude
+    const double radius = std::cbrt(1.0 / std::sqrt(e[0] * e[1] * e[2]));
+    double w[3][3];
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++)
+      {
+        double s = 0;
+        for(size_t l = 0; l < 3; l++) s += vec[i][l] * std::sqrt(e[l]) * vec[j][l];
+        w[i][j] = s * radius;
+      }
+    }
+
+    // residual from normal equations, p'Np - 2p'r + n
+    double res = _count;
+    size_t idx = 0;
+    for(size_t i = 0; i < SIZE; i++)
+    {
+      res -= 2 * p[i] * _rhs[i];
+      for(size_t j = i; j < SIZE; j++) res += (i == j ? 1 : 2) * p[i] * _ata[idx++] * p[j];
+    }
+
+    r.offset = VectorFloat(c[0], c[1], c[2]);
+    r.scale = VectorFloat(w[0][0], w[1][1], w[2][2]);
+    r.cross = VectorFloat(w[0][1], w[0][2], w[1][2]);
+    r.radius = radius;
+    r.error = std::sqrt(std::max(0.0, res) / _count) / (2 * k);
+
+    return true;
+  }
+
+  // applies soft iron matrix to hard iron corrected value
+  static VectorFloat apply(const Result& r, const VectorFloat& v)
+  {
+    const VectorFloat& s = r.scale;
+    const VectorFloat& c = r.cross;
+    const float x = v.x - r.offset.x, y = v.y - r.offset.y, z = v.z - r.offset.z;
+    return VectorFloat(s.x * x + c.x * y + c.y * z, c.x * x + s.y * y + c.z * z, c.y * x + c.z * y + s.z * z);
+  }
+
+  // one of 26 directions around center, for coverage tracking
+  static int sector(const VectorFloat& v)
+  {
+    const float m = v.getMagnitude();
+    if(m <= 0) return -1;
+    const float t = 0.38f * m; // ~sin(22.5deg)
+    int s = 0;
+    for(size_t i = 0; i < 3; i++)
+    {
+      s = s * 3 + (v[i] > t ? 2 : (v[i] < -t ? 0 : 1));
+    }
+    if(s == 13) return -1;
+    return s > 13 ? s - 1 : s;
+  }
+
+private:
+  static const size_t SIZE = 9;
+  static const size_t TRI = SIZE * (SIZE + 1) / 2;
+
+  static void terms(const VectorFloat& v, double * d)
+  {
+    const double x = v.x, y = v.y, z = v.z;
+    d[0] = x * x;
+    d[1] = y * y;
+    d[2] = z * z;
+    d[3] = 2 * x * y;
+    d[4] = 2 * x * z;
+    d[5] = 2 * y * z;
+    d[6] = 2 * x;
+    d[7] = 2 * y;
+    d[8] = 2 * z;
+  }
+
+  // gaussian elimination with partial pivoting
+  bool solveNormal(double * p) const
+  {
+    double n[SIZE][SIZE + 1];
+    size_t k = 0;
+    for(size_t i = 0; i < SIZE; i++)
+    {
+      for(size_t j = i; j < SIZE; j++)
+      {
+        n[i][j] = n[j][i] = _ata[k++];
+      }
+      n[i][SIZE] = _rhs[i];
+    }
+
+    for(size_t col = 0; col < SIZE; col++)
+    {
+      size_t pivot = col;
+      for(size_t i = col + 1; i < SIZE; i++)
+      {
+        if(std::abs(n[i][col]) > std::abs(n[pivot][col])) pivot = i;
+      }
+      if(std::abs(n[pivot][col]) < 1e-12) return false;
+      if(pivot != col)
+      {
+        for(size_t j = 0; j <= SIZE; j++) std::swap(n[col][j], n[pivot][j]);
+      }
+      for(size_t i = col + 1; i < SIZE; i++)
+      {
+        const double f = n[i][col] / n[col][col];
+        for(size_t j = col; j <= SIZE; j++) n[i][j] -= f * n[col][j];
+      }
+    }
+
+    for(size_t i = SIZE; i-- > 0;)
+    {
+      double s = n[i][SIZE];
+      for(size_t j = i + 1; j < SIZE; j++) s -= n[i][j] * p[j];
+      p[i] = s / n[i][i];
+    }
+    return true;
+  }
+
+  static bool invert(const double a[3][3], double m[3][3])
+  {
+    const double det = a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+                     - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+                     + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+    if(std::abs(det) < 1e-18) return false;
+    const double inv = 1.0 / det;
+    m[0][0] = (a[1][1] * a[2][2] - a[1][2] * a[2][1]) * inv;
+    m[0][1] = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) * inv;
+    m[0][2] = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) * inv;
+    m[1][0] = (a[1][2] * a[2][0] - a[1][0] * a[2][2]) * inv;
+    m[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) * inv;
+    m[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) * inv;
+    m[2][0] = (a[1][0] * a[2][1] - a[1][1] * a[2][0]) * inv;
+    m[2][1] = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) * inv;
+    m[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) * inv;
+    return true;
+  }
+
+  // cyclic jacobi for symmetric 3x3, eigenvectors in columns
+  static void eigen(double a[3][3], double e[3], double v[3][3])
+  {
+    for(size_t i = 0; i < 3; i++)
+    {
+      for(size_t j = 0; j < 3; j++) v[i][j] = i == j ? 1 : 0;
+    }
+    for(size_t sweep = 0; sweep < 16; sweep++)
+    {
+      const double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+      if(off < 1e-24) break;
+      for(size_t p = 0; p < 2; p++)
+      {
+        for(size_t q = p + 1; q < 3; q++)
+        {
+          if(a[p][q] == 0) continue;
+          const double theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+          const double t = (theta >= 0 ? 1 : -1) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+          const double c = 1 / std::sqrt(t * t + 1), s = t * c;
+          for(size_t k = 0; k < 3; k++)
+          {
+            const double akp = a[k][p], akq = a[k][q];
+            a[k][p] = c * akp - s * akq;
+            a[k][q] = s * akp + c * akq;
+          }
+          for(size_t k = 0; k < 3; k++)
+          {
+            const double apk = a[p][k], aqk = a[q][k];
+            a[p][k] = c * apk - s * aqk;
+            a[q][k] = s * apk + c * aqk;
+          }
+          for(size_t k = 0; k < 3; k++)
+          {
+            const double vkp = v[k][p], vkq = v[k][q];
+            v[k][p] = c * vkp - s * vkq;
+            v[k][q] = s * vkp + c * vkq;
+          }
+        }
+      }
+    }
+    for(size_t i = 0; i < 3; i++) e[i] = a[i][i];
+  }
+
+  double _ata[TRI];
+  double _rhs[SIZE];
+  size_t _count;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef _ESPFC_MATH_SIX_POINT_CALIBRATION_H_
+#define _ESPFC_MATH_SIX_POINT_CALIBRATION_H_
+
+#include <cmath>
+#include <cstdint>
+#include "helper_3dmath.h"
+
+namespace Espfc {
+
+namespace Math {
+
+// Accelerometer offset, scale and cross-axis solver from six orientations,
+// each point is average reading with one axis pointing up (+X, -X, +Y, -Y, +Z, -Z).
+// Corrected value is gain * raw - bias, where gain is symmetric matrix.
+class SixPointCalibration
+{
+public:
+  SixPointCalibration(): _mask(0) {}
+
+  void reset()
+  {
+    _mask = 0;
+  }
+
+  // returns face index or -1 if no axis is close enough to gravity
+  static int face(const VectorFloat& v, float g)
+  {
+    const float tolerance = 0.2f * g;
+    for(size_t i = 0; i < 3; i++)
+    {
+      const float a = v[i];
+      if(std::abs(a - g) < tolerance) return i * 2;
+      if(std::abs(a + g) < tolerance) return i * 2 + 1;
+    }
+    return -1;
+  }
+
+  void set(int face, const VectorFloat& v)
+  {
+    if(face < 0 || face >= 6) return;
+    _points[face] = v;
+    _mask |= 1 << face;
+  }
+
+  bool has(int face) const
+  {
+    return face >= 0 && face < 6 && (_mask & (1 << face));
+  }
+
+  uint8_t mask() const
+  {
+    return _mask;
+  }
+
+  bool complete() const
+  {
+    return _mask == 0x3f;
+  }
+
+  // gain diagonal, cross terms (xy, xz, yz) and bias in corrected frame
+  bool solve(float g, bool withCross, VectorFloat& gain, VectorFloat& cross, VectorFloat& bias) const
+  {
+    if(!complete()) return false;
+
+    // each opposite pair sums to twice the offset
+    VectorFloat offset;
+    for(size_t i = 0; i < 6; i++) offset += _points[i];
+    offset /= 6.f;
+
+    // columns of inverse gain matrix
+    float a[3][3];
+    for(size_t j = 0; j < 3; j++)
+    {
+      VectorFloat col = _points[j * 2];
+      col -= _points[j * 2 + 1];
+      col /= 2.f * g;
+      for(size_t i = 0; i < 3; i++) a[i][j] = withCross ? col[i] : (i == j ? col[i] : 0.f);
+    }
+
+    float m[3][3];
+    if(!invert(a, m)) return false;
+
+    gain = VectorFloat(m[0][0], m[1][1], m[2][2]);
+    cross = VectorFloat((m[0][1] + m[1][0]) * 0.5f, (m[0][2] + m[2][0]) * 0.5f, (m[1][2] + m[2][1]) * 0.5f);
+    bias = apply(gain, cross, offset);
+
+    return true;
+  }
+
+  static VectorFloat apply(const VectorFloat& gain, const VectorFloat& cross, const VectorFloat& v)
+  {
+    return VectorFloat(
+      gain.x * v.x + cross.x * v.y + cross.y * v.z,
+      cross.x * v.x + gain.y * v.y + cross.z * v.z,
+      cross.y * v.x + cross.z * v.y + gain.z * v.z
+    );
+  }
+
+private:
+  static bool invert(const float a[3][3], float m[3][3])
+  {
+    const float c00 = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+    const float c01 = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+    const float c02 = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+    const float det = a[0][0] * c00 + a[0][1] * c01 + a[0][2] * c02;
+    if(std::abs(det) < 1e-6f) return false;
+    const float inv = 1.f / det;
+
+    m[0][0] = c00 * inv;
+    m[0][1] = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) * inv;
+    m[0][2] = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) * inv;
+    m[1][0] = c01 * inv;
+    m[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) * inv;
+    m[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) * inv;
+    m[2][0] = c02 * inv;
+    m[2][1] = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) * inv;
+    m[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) * inv;
+
+    return true;
+  }
+
+  VectorFloat _points[6];
+  uint8_t _mask;
+};
+
+}
+
+}
+
+#endif
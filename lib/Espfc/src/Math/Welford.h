@@ -0,0 +1,69 @@
+#ifndef _ESPFC_MATH_WELFORD_H_
+#define _ESPFC_MATH_WELFORD_H_
+
+#include <cstddef>
+
+namespace Espfc {
+
+namespace Math {
+
+// Running mean and variance, numerically stable single pass
+template<typename SampleType>
+class Welford
+{
+public:
+  Welford()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    _count = 0;
+    _mean = SampleType();
+    _m2 = SampleType();
+  }
+
+  void update(const SampleType& input)
+  {
+    _count++;
+    SampleType delta = input;
+    delta -= _mean;
+    SampleType step = delta;
+    step /= (float)_count;
+    _mean += step;
+    SampleType delta2 = input;
+    delta2 -= _mean;
+    delta *= delta2;
+    _m2 += delta;
+  }
+
+  size_t count() const
+  {
+    return _count;
+  }
+
+  const SampleType& mean() const
+  {
+    return _mean;
+  }
+
+  // sample variance
+  SampleType variance() const
+  {
+    SampleType v = _m2;
+    if(_count > 1) v /= (float)(_count - 1);
+    return v;
+  }
+
+private:
+  size_t _count;
+  SampleType _mean;
+  SampleType _m2;
+};
+
+}
+
+}
+
+#endif
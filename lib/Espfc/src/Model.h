@@ -14,6 +14,7 @@
 #include "Storage.h"
 #include "Logger.h"
 #include "Math/Utils.h"
+#include "Math/Cic.h"
 
 namespace Espfc {
 
@@ -130,6 +131,25 @@ class Model
       return state.baroPresent && config.baroDev != BARO_NONE;
     }
 
+    // earth z axis in body frame, last row of attitude rotation matrix
+    VectorFloat getUpVector() const
+    {
+      const Quaternion& q = state.angleQ;
+      return VectorFloat(
+        2.f * (q.x * q.z - q.w * q.y),
+        2.f * (q.y * q.z + q.w * q.x),
+        q.w * q.w - q.x * q.x - q.y * q.y + q.z * q.z
+      );
+    }
+
+    // euler angles are not used for control, compute them only for reporting
+    VectorFloat getAngle() const
+    {
+      VectorFloat angle;
+      angle.eulerFromQuaternion(state.angleQ);
+      return angle;
+    }
+
     bool calibrationActive() const
     {
       return state.accelCalibrationState != CALIBRATION_IDLE || state.gyroCalibrationState != CALIBRATION_IDLE || state.magCalibrationState != CALIBRATION_IDLE;
@@ -140,10 +160,18 @@ class Model
       state.gyroCalibrationState = CALIBRATION_START;
       if(accelActive())
       {
+        state.accelCalibrationMode = ACCEL_CALIBRATION_LEVEL;
         state.accelCalibrationState = CALIBRATION_START;
       }
     }
 
+    void calibrateAccel(bool cross)
+    {
+      if(!accelActive()) return;
+      state.accelCalibrationMode = cross ? ACCEL_CALIBRATION_SIX_CROSS : ACCEL_CALIBRATION_SIX;
+      state.accelCalibrationState = CALIBRATION_START;
+    }
+
     void calibrateMag()
     {
       state.magCalibrationState = CALIBRATION_START;
@@ -156,17 +184,22 @@ class Model
         save();
         state.buzzer.push(BEEPER_GYRO_CALIBRATED);
         logger.info().log(F("GYRO BIAS")).log(degrees(state.gyroBias.x)).log(degrees(state.gyroBias.y)).logln(degrees(state.gyroBias.z));
+        logger.info().log(F("GYRO NOISE")).log(degrees(state.gyroCalibrationNoise)).logln(state.gyroCalibrationRestarts);
       }
       if(state.accelCalibrationState == CALIBRATION_SAVE)
       {
         save();
         logger.info().log(F("ACCEL BIAS")).log(state.accelBias.x).log(state.accelBias.y).logln(state.accelBias.z);
+        logger.info().log(F("ACCEL SCALE")).log(state.accelCalibrationScale.x).log(state.accelCalibrationScale.y).logln(state.accelCalibrationScale.z);
+        logger.info().log(F("ACCEL CROSS")).log(state.accelCalibrationCross.x).log(state.accelCalibrationCross.y).logln(state.accelCalibrationCross.z);
       }
       if(state.magCalibrationState == CALIBRATION_SAVE)
       {
         save();
         logger.info().log(F("MAG BIAS")).log(state.magCalibrationOffset.x).log(state.magCalibrationOffset.y).logln(state.magCalibrationOffset.z);
         logger.info().log(F("MAG SCALE")).log(state.magCalibrationScale.x).log(state.magCalibrationScale.y).logln(state.magCalibrationScale.z);
+        logger.info().log(F("MAG CROSS")).log(state.magCalibrationCross.x).log(state.magCalibrationCross.y).logln(state.magCalibrationCross.z);
+        logger.info().log(F("MAG FIT")).log(state.magCalibrationError).log(state.magCalibrationCoverage).logln(state.magCalibrationOutliers);
       }
     }
 
@@ -269,14 +302,21 @@ class Model
       int loopSyncMax = 1;
       if(config.magDev != MAG_NONE || config.baroDev != BARO_NONE) loopSyncMax /= 2;
 
-      // for spi gyro allow full speed mode
-      if (state.gyroDev && state.gyroDev->getBus()->getType() == BUS_SPI)
+      // for spi gyro allow full speed mode, second gyro must be on spi too
+      bool gyroSpi = state.gyroDev && state.gyroDev->getBus()->getType() == BUS_SPI;
+      if(state.gyroDev2 && state.gyroDev2->getBus()->getType() != BUS_SPI) gyroSpi = false;
+      if (gyroSpi)
       {
         loopSyncMax = ESPFC_GYRO_DENOM_MAX; // max 8kHz
         state.gyroRate = state.gyroClock;
       }
 
       config.loopSync = std::max((int)config.loopSync, loopSyncMax);
+      if(config.gyroDecimation != GYRO_DECIM_NONE)
+      {
+        // decimation ratio follows pid_sync, limited by cic register width
+        config.loopSync = std::min((int)config.loopSync, ESPFC_CIC_RATIO_MAX);
+      }
       state.loopRate = state.gyroRate / config.loopSync;
 
       config.output.protocol = ESC_PROTOCOL_SANITIZE(config.output.protocol);
@@ -380,6 +420,8 @@ class Model
       // only few beeper modes allowed
       config.buzzer.beeperMask &=
         1 << (BEEPER_GYRO_CALIBRATED - 1) |
+        1 << (BEEPER_ACC_CALIBRATION - 1) |
+        1 << (BEEPER_ACC_CALIBRATION_FAIL - 1) |
         1 << (BEEPER_SYSTEM_INIT - 1) |
         1 << (BEEPER_RX_LOST - 1) |
         1 << (BEEPER_RX_SET - 1) |
@@ -471,28 +513,50 @@ class Model
         pidScale[AXIS_PITCH] = 20.f; // ROBOT
       }
 
+      PidBank& pid = state.innerPid;
+      pid.rate = state.loopTimer.rate;
       for(size_t i = 0; i <= AXIS_YAW; i++) // rpy
       {
         const PidConfig& pc = config.pid[i];
-        Pid& pid = state.innerPid[i];
-        pid.Kp = (float)pc.P * PTERM_SCALE * pidScale[i];
-        pid.Ki = (float)pc.I * ITERM_SCALE * pidScale[i];
-        pid.Kd = (float)pc.D * DTERM_SCALE * pidScale[i];
-        pid.Kf = (float)pc.F * FTERM_SCALE * pidScale[i];
-        pid.iLimit = 0.15f;
-        pid.oLimit = 0.5f;
-        pid.rate = state.loopTimer.rate;
-        pid.dtermNotchFilter.begin(config.dtermNotchFilter, pidFilterRate);
+        pid.Kp[i] = (float)pc.P * PTERM_SCALE * pidScale[i];
+        pid.Ki[i] = (float)pc.I * ITERM_SCALE * pidScale[i];
+        pid.Kd[i] = (float)pc.D * DTERM_SCALE * pidScale[i];
+        pid.Kf[i] = (float)pc.F * FTERM_SCALE * pidScale[i];
+        pid.iLimit[i] = 0.15f;
+        pid.oLimit[i] = 0.5f;
+        pid.dtermNotchFilter[i].begin(config.dtermNotchFilter, pidFilterRate);
         if(config.dtermDynLpfFilter.cutoff > 0) {
-          pid.dtermFilter.begin(FilterConfig((FilterType)config.dtermFilter.type, config.dtermDynLpfFilter.cutoff), pidFilterRate);
+          pid.dtermFilter[i].begin(FilterConfig((FilterType)config.dtermFilter.type, config.dtermDynLpfFilter.cutoff), pidFilterRate);
         } else {
-          pid.dtermFilter.begin(config.dtermFilter, pidFilterRate);
+          pid.dtermFilter[i].begin(config.dtermFilter, pidFilterRate);
         }
-        pid.dtermFilter2.begin(config.dtermFilter2, pidFilterRate);
-        pid.ftermFilter.begin(config.input.filterDerivative, pidFilterRate);
-        if(i == AXIS_YAW) pid.ptermFilter.begin(config.yawFilter, pidFilterRate);
-        pid.begin();
+        pid.dtermFilter2[i].begin(config.dtermFilter2, pidFilterRate);
+        pid.ftermFilter[i].begin(config.input.filterDerivative, pidFilterRate);
+        if(i == AXIS_YAW) pid.ptermFilter[i].begin(config.yawFilter, pidFilterRate);
+        pid.itermRelaxFilter[i].begin(FilterConfig(FILTER_PT1, config.itermRelaxCutoff), pidFilterRate);
+        // d-min active only when below full D
+        pid.dMinPercent[i] = pc.D > 0 && config.dMin[i] < pc.D ? (float)config.dMin[i] / pc.D : 0.f;
+        pid.dMinFactor[i] = 1.f;
+        pid.dMinRangeFilter[i].begin(FilterConfig(FILTER_PT2, DMIN_RANGE_HZ), pidFilterRate);
+        pid.dMinFilter[i].begin(FilterConfig(FILTER_PT2, DMIN_LOWPASS_HZ), pidFilterRate);
+      }
+      pid.feedforwardMask = config.mixerType != MIXER_GIMBAL ? (1u << AXIS_ROLL) | (1u << AXIS_PITCH) | (1u << AXIS_YAW) : 0;
+      pid.dMinMask = 0;
+      for(size_t i = 0; i <= AXIS_YAW; i++)
+      {
+        if(pid.dMinPercent[i] > 0.f && config.dMinGain > 0) pid.dMinMask |= (1u << i);
       }
+      // betaflight gains are for deg/s, derivative per second for gyro and per loop for setpoint
+      pid.dMinGyroGain = Math::toDeg(config.dMinGain * DMIN_GAIN_FACTOR / DMIN_LOWPASS_HZ);
+      pid.dMinSetpointGain = Math::toDeg(config.dMinGain * DMIN_SETPOINT_GAIN_FACTOR * config.dMinAdvance * pid.rate / (100 * DMIN_LOWPASS_HZ));
+      pid.itermRelaxMask = 0;
+      if(config.itermRelax >= ITERM_RELAX_RP && config.itermRelaxCutoff > 0) pid.itermRelaxMask |= (1u << AXIS_ROLL) | (1u << AXIS_PITCH);
+      if(config.itermRelax >= ITERM_RELAX_RPY && config.itermRelaxCutoff > 0) pid.itermRelaxMask |= (1u << AXIS_YAW);
+      pid.antiGravityMask = config.antiGravityGain > 0 ? (1u << AXIS_ROLL) | (1u << AXIS_PITCH) : 0;
+      pid.antiGravityGain = config.antiGravityGain * 0.1f;
+      pid.antiGravityFilter.begin(FilterConfig(FILTER_PT2, config.antiGravityCutoff), pidFilterRate);
+      pid.begin();
+      state.tpa.begin(config);
 
       for(size_t i = 0; i < AXIS_YAW; i++)
       {
@@ -511,6 +575,8 @@ class Model
         pid.begin();
       }
       state.customMixer = MixerConfig(config.customMixerCount, config.customMixes);
+      state.currentMixer = Output::Mixers::getMixer((MixerType)config.mixerType, state.customMixer);
+      state.mixerMatrix.compile(state.currentMixer);
 
       state.telemetry = config.telemetry;
       state.baroAltitudeBiasSamples = 200;
@@ -527,8 +593,11 @@ class Model
       {
         state.gyroBias.set(i, config.gyroBias[i] / 1000.0f);
         state.accelBias.set(i, config.accelBias[i] / 1000.0f);
+        state.accelCalibrationScale.set(i, config.accelCalibrationScale[i] / 1000.0f);
+        state.accelCalibrationCross.set(i, config.accelCalibrationCross[i] / 1000.0f);
         state.magCalibrationOffset.set(i, config.magCalibrationOffset[i] / 10.0f);
         state.magCalibrationScale.set(i, config.magCalibrationScale[i] / 1000.0f);
+        state.magCalibrationCross.set(i, config.magCalibrationCross[i] / 1000.0f);
       }
     }
 
@@ -539,8 +608,11 @@ class Model
       {
         config.gyroBias[i] = lrintf(state.gyroBias[i] * 1000.0f);
         config.accelBias[i] = lrintf(state.accelBias[i] * 1000.0f);
+        config.accelCalibrationScale[i] = lrintf(state.accelCalibrationScale[i] * 1000.0f);
+        config.accelCalibrationCross[i] = lrintf(state.accelCalibrationCross[i] * 1000.0f);
         config.magCalibrationOffset[i] = lrintf(state.magCalibrationOffset[i] * 10.0f);
         config.magCalibrationScale[i] = lrintf(state.magCalibrationScale[i] * 1000.0f);
+        config.magCalibrationCross[i] = lrintf(state.magCalibrationCross[i] * 1000.0f);
       }
     }
 
@@ -25,6 +25,20 @@ enum GyroDlpf {
   GYRO_DLPF_EX  = 0x07,
 };
 
+enum GyroDecimation {
+  GYRO_DECIM_NONE = 0x00, // moving average or gyro_lpf2
+  GYRO_DECIM_CIC1 = 0x01,
+  GYRO_DECIM_CIC2 = 0x02,
+  GYRO_DECIM_CIC3 = 0x03,
+};
+
+enum GyroSelect {
+  GYRO_SELECT_FIRST  = 0x00,
+  GYRO_SELECT_SECOND = 0x01,
+  GYRO_SELECT_BOTH   = 0x02, // average
+  GYRO_SELECT_AUTO   = 0x03, // average, failover on error
+};
+
 enum GyroGain {
   GYRO_FS_250  = 0x00,
   GYRO_FS_500  = 0x01,
@@ -66,6 +80,7 @@ enum FusionMode {
   FUSION_LERP,
   FUSION_SIMPLE,
   FUSION_EXPERIMENTAL,
+  FUSION_EKF,
   FUSION_MAX,
 };
 
@@ -86,7 +101,7 @@ class FusionConfig
     {
       static const char* modeChoices[] = {
         PSTR("NONE"), PSTR("MADGWICK"), PSTR("MAHONY"), PSTR("COMPLEMENTARY"), PSTR("KALMAN"),
-        PSTR("RTQF"), PSTR("LERP"), PSTR("SIMPLE"), PSTR("EXPERIMENTAL"),
+        PSTR("RTQF"), PSTR("LERP"), PSTR("SIMPLE"), PSTR("EXPERIMENTAL"), PSTR("EKF"),
         NULL };
       return modeChoices;
     }
@@ -98,6 +113,7 @@ enum FlightMode {
   MODE_AIRMODE,
   MODE_BUZZER,
   MODE_FAILSAFE,
+  MODE_HORIZON,
   MODE_COUNT
 };
 
@@ -191,6 +207,7 @@ enum DebugMode {
   DEBUG_BLACKBOX_OUTPUT,
   DEBUG_GYRO_SAMPLE,
   DEBUG_RX_TIMING,
+  DEBUG_MIXER_SATURATION, // espfc only, betaflight 4.2+ has D_LPF at this index and log viewers label slots as such
   DEBUG_COUNT
 };
 
@@ -236,7 +253,16 @@ enum InputFilterType : uint8_t {
   INPUT_FILTER
 };
 
+enum ItermRelaxType {
+  ITERM_RELAX_OFF,
+  ITERM_RELAX_RP,
+  ITERM_RELAX_RPY,
+};
+
 const size_t MODEL_NAME_LEN  = 16;
+const size_t TPA_CURVE_POINTS = 5;
+const uint8_t TPA_CURVE_MAX  = 200; // [%]
+const uint8_t TPA_WEIGHT_MAX = 100; // [%]
 const size_t AXES            = 4;
 const size_t INPUT_CHANNELS  = AXIS_COUNT;
 const size_t OUTPUT_CHANNELS = ESC_CHANNEL_COUNT;
@@ -452,6 +478,9 @@ class OutputConfig
     int8_t throttleLimitType = 0;
     int8_t throttleLimitPercent = 100;
     int8_t motorLimit = 100;
+    int8_t thrustLinear = 0;         // [%], motor thrust curve, 0 is linear
+    int8_t vbatSagCompensation = 0;  // [%], boost motor output as battery voltage drops
+    int8_t yawPriority = 30;         // [%], yaw authority kept on saturation before roll and pitch are reduced
 
     OutputChannelConfig channel[ESPFC_OUTPUT_COUNT];
 };
@@ -548,6 +577,9 @@ class ModelConfig
     int8_t gyroDlpf;
     int8_t gyroFsr;
     int8_t gyroAlign;
+    int8_t gyroDecimation;
+    int8_t gyroSelect;
+    int8_t gyro2Align;
     FilterConfig gyroFilter;
     FilterConfig gyroFilter2;
     FilterConfig gyroFilter3;
@@ -594,9 +626,20 @@ class ModelConfig
 
     int16_t dtermSetpointWeight;
     int8_t itermWindupPointPercent;
+    int8_t itermRelax;
+    int8_t itermRelaxCutoff;
+    int16_t antiGravityGain;
+    int8_t antiGravityCutoff;
+    uint8_t dMin[3];
+    uint8_t dMinGain;
+    uint8_t dMinAdvance;
+    int8_t feedforwardAveraging;
+    uint8_t feedforwardBoost;
+    uint8_t feedforwardJitter;
 
     int8_t angleLimit;
     int16_t angleRateLimit;
+    uint8_t horizonLimitSticks;
 
     int8_t loopSync;
     int8_t mixerSync;
@@ -619,18 +662,24 @@ class ModelConfig
 
     int16_t gyroBias[3];
     int16_t accelBias[3];
+    int16_t accelCalibrationScale[3];
+    int16_t accelCalibrationCross[3];
     int16_t magCalibrationScale[3];
     int16_t magCalibrationOffset[3];
+    int16_t magCalibrationCross[3];
 
     char modelName[MODEL_NAME_LEN + 1];
 
     int8_t vbatCellWarning;
+    int8_t vbatCellFull;
     uint8_t vbatScale;
     uint8_t vbatResDiv;
     uint8_t vbatResMult;
     uint8_t vbatSource;
 
     uint8_t ibatSource;
+    int16_t ibatScale;
+    int16_t ibatOffset;
 
     int8_t debugMode;
     uint8_t debugAxis;
@@ -643,6 +692,9 @@ class ModelConfig
     bool serialRxGuard;
     int8_t tpaScale;
     int16_t tpaBreakpoint;
+    uint8_t tpaCurve[TPA_CURVE_POINTS];
+    uint8_t tpaP[3];
+    uint8_t tpaD[3];
 
     int8_t customMixerCount;
     MixerEntry customMixes[MIXER_RULE_MAX];
@@ -714,6 +766,9 @@ class ModelConfig
       gyroAlign = ALIGN_DEFAULT;
       gyroDlpf = GYRO_DLPF_256;
       gyroFsr  = GYRO_FS_2000;
+      gyroDecimation = GYRO_DECIM_NONE;
+      gyroSelect = GYRO_SELECT_FIRST;
+      gyro2Align = ALIGN_DEFAULT;
 
       loopSync = 8; // MPU 1000Hz
       mixerSync = 1;
@@ -915,10 +970,23 @@ class ModelConfig
       pid[PID_VEL]   = { .P = 0, .I =  0, .D =  0, .F = 0 };
 
       itermWindupPointPercent = 30;
+      itermRelax = ITERM_RELAX_RP;
+      itermRelaxCutoff = 15; // Hz
+      antiGravityGain = 80;  // 8.0 iterm boost per unit of throttle derivative
+      antiGravityCutoff = 5; // Hz
+      dMin[AXIS_ROLL] = 18;
+      dMin[AXIS_PITCH] = 20;
+      dMin[AXIS_YAW] = 0;
+      dMinGain = 37;
+      dMinAdvance = 20;
+      feedforwardAveraging = 1; // 2 point
+      feedforwardBoost = 15;
+      feedforwardJitter = 7;
       dtermSetpointWeight = 30;
 
       angleLimit = 55;  // deg
       angleRateLimit = 300;  // deg
+      horizonLimitSticks = 75; // %
 
       featureMask = ESPFC_FEATURE_MASK;
 
@@ -928,6 +996,10 @@ class ModelConfig
 
       tpaScale = 10;
       tpaBreakpoint = 1650;
+      // gain percent at 0, 25, 50, 75 and 100% throttle
+      for(size_t i = 0; i < TPA_CURVE_POINTS; i++) tpaCurve[i] = 100;
+      // percent of attenuation applied to pterm and dterm per axis
+      for(size_t i = 0; i <= AXIS_YAW; i++) tpaP[i] = tpaD[i] = 100;
 
       for(size_t i = 0; i < ACTUATOR_CONDITIONS; i++)
       {
@@ -960,20 +1032,32 @@ class ModelConfig
       accelBias[0] = 0;
       accelBias[1] = 0;
       accelBias[2] = 0;
+      accelCalibrationScale[0] = 1000;
+      accelCalibrationScale[1] = 1000;
+      accelCalibrationScale[2] = 1000;
+      accelCalibrationCross[0] = 0;
+      accelCalibrationCross[1] = 0;
+      accelCalibrationCross[2] = 0;
       magCalibrationOffset[0] = 0;
       magCalibrationOffset[1] = 0;
       magCalibrationOffset[2] = 0;
       magCalibrationScale[0] = 1000;
       magCalibrationScale[1] = 1000;
       magCalibrationScale[2] = 1000;
+      magCalibrationCross[0] = 0;
+      magCalibrationCross[1] = 0;
+      magCalibrationCross[2] = 0;
 
       vbatScale = 100;
       vbatResDiv = 16;
       vbatResMult = 1;
       vbatCellWarning = 35;
+      vbatCellFull = 42;
       vbatSource = 0;
 
       ibatSource = 0;
+      ibatScale = 400;  // [0.1mV/A]
+      ibatOffset = 0;   // [mV]
 
       buzzer.inverted = true;
 
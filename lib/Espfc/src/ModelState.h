@@ -11,6 +11,9 @@
 #include "Stats.h"
 #include "helper_3dmath.h"
 #include "Pid.h"
+#include "Control/PidBank.h"
+#include "Control/Tpa.h"
+#include "Output/MixerMatrix.h"
 #include "Kalman.h"
 #include "Filter.h"
 #include "Stats.h"
@@ -33,6 +36,12 @@ class CliCmd
     size_t index;
 };
 
+enum MixerSaturationFlag {
+  MIXER_SATURATION_RP     = 1 << 0, // roll and pitch scaled down
+  MIXER_SATURATION_YAW    = 1 << 1, // yaw limited
+  MIXER_SATURATION_THRUST = 1 << 2, // thrust moved to fit outputs
+};
+
 class SerialPortState
 {
   public:
@@ -94,10 +103,16 @@ class BatteryState
     }
 
     int16_t rawVoltage;
-    uint8_t voltage;
-    uint8_t cellVoltage;
+    int16_t rawCurrent;
+    uint8_t voltage;           // [0.1V]
+    uint8_t cellVoltage;       // [0.1V], sag compensated
     int8_t cells;
     int8_t samples;
+    float vbat;                // [V]
+    float vbatCompensated;     // [V], estimated resting voltage
+    float current;             // [A]
+    float mahDrawn;
+    float resistance;          // [Ohm], estimated internal resistance
     Timer timer;
 };
 
@@ -109,6 +124,12 @@ enum CalibrationState {
   CALIBRATION_SAVE   = 4,
 };
 
+enum AccelCalibrationMode {
+  ACCEL_CALIBRATION_LEVEL      = 0, // offset only, board level
+  ACCEL_CALIBRATION_SIX        = 1, // offset and scale, six orientations
+  ACCEL_CALIBRATION_SIX_CROSS  = 2, // offset, scale and cross-axis terms
+};
+
 enum FailsafePhase {
   FAILSAFE_IDLE = 0,
   FAILSAFE_RX_LOSS_DETECTED,
@@ -134,6 +155,7 @@ class FailsafeState
 struct ModelState
 {
   Device::GyroDevice* gyroDev;
+  Device::GyroDevice* gyroDev2;
   Device::MagDevice* magDev;
   Device::BaroDevice* baroDev;
 
@@ -161,8 +183,7 @@ struct ModelState
   VectorFloat pose;
   Quaternion poseQ;
 
-  VectorFloat angle;
-  Quaternion angleQ;
+  Quaternion angleQ; // attitude, body to earth, euler angles on demand by Model::getAngle()
 
   Filter gyroFilter[3];
   Filter gyroFilter2[3];
@@ -178,6 +199,7 @@ struct ModelState
   Filter inputFilter[4];
 
   VectorFloat velocity;
+  float altitude;
   VectorFloat desiredVelocity;
 
   VectorFloat desiredAngle;
@@ -185,7 +207,8 @@ struct ModelState
 
   float desiredRate[AXES];
 
-  Pid innerPid[AXES];
+  PidBank innerPid;
+  Tpa tpa;
   Pid outerPid[AXES];
 
   size_t inputChannelCount;
@@ -223,11 +246,18 @@ struct ModelState
   float accelBiasAlpha;
   int accelBiasSamples;
   int accelCalibrationState;
+  int accelCalibrationMode;
+  uint8_t accelCalibrationPoints; // bit per collected orientation
+  VectorFloat accelCalibrationScale = VectorFloat(1.f, 1.f, 1.f);
+  VectorFloat accelCalibrationCross; // xy, xz, yz
 
   float gyroScale;
   VectorFloat gyroBias;
-  float gyroBiasAlpha;
+  VectorFloat gyroBiasEstimate; // residual bias tracked by attitude ekf
   int gyroBiasSamples;
+  float gyroCalibrationNoise;
+  int gyroCalibrationRestarts;
+  bool gyroCalibrationFailed;
   int gyroCalibrationState;
   int gyroCalibrationRate;
 
@@ -256,10 +286,12 @@ struct ModelState
   int magCalibrationState;
   bool magCalibrationValid;
 
-  VectorFloat magCalibrationMin;
-  VectorFloat magCalibrationMax;
   VectorFloat magCalibrationScale;
   VectorFloat magCalibrationOffset;
+  VectorFloat magCalibrationCross; // xy, xz, yz
+  float magCalibrationError;
+  int magCalibrationCoverage;
+  int magCalibrationOutliers;
   
   bool telemetry;
   Timer telemetryTimer;
@@ -281,11 +313,13 @@ struct ModelState
 
   MixerConfig currentMixer;
   MixerConfig customMixer;
+  Output::MixerMatrix mixerMatrix;
 
   int16_t i2cErrorCount;
   int16_t i2cErrorDelta;
 
   bool gyroPresent;
+  uint8_t gyroFault; // bit per gyro, read error or stuck output
   bool accelPresent;
   bool magPresent;
   bool baroPresent;
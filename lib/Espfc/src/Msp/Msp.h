@@ -10,6 +10,10 @@ extern "C" {
 #include "msp/msp_protocol_v2_betaflight.h"
 }
 
+// espfc specific, outside of reserved common (0x1000), inav (0x2000) and betaflight (0x3000) blocks
+#define MSP2_ESPFC_TPA_CURVE        0x4100
+#define MSP2_ESPFC_SET_TPA_CURVE    0x4101
+
 namespace Espfc {
 
 namespace Msp {
@@ -124,7 +124,7 @@ static int8_t toIbatSource(uint8_t t)
 {
   switch(t) {
     case 0: return 0; // none
-    //case 1: return 1; // internal adc, not yet
+    case 1: return 1; // internal adc
     default: return 0;
   }
 }
@@ -261,7 +261,7 @@ class MspProcessor
           break;
 
         case MSP_BOXNAMES:
-          r.writeString(F("ARM;ANGLE;AIRMODE;BUZZER;FAILSAFE;"));
+          r.writeString(F("ARM;ANGLE;AIRMODE;BUZZER;FAILSAFE;HORIZON;"));
           break;
 
         case MSP_BOXIDS:
@@ -270,6 +270,7 @@ class MspProcessor
           r.writeU8(MODE_AIRMODE);
           r.writeU8(MODE_BUZZER);
           r.writeU8(MODE_FAILSAFE);
+          r.writeU8(MODE_HORIZON);
           break;
 
         case MSP_MODE_RANGES:
@@ -316,10 +317,10 @@ class MspProcessor
 
         case MSP_ANALOG:
           r.writeU8(_model.state.battery.voltage);  // voltage
-          r.writeU16(0); // mah drawn
+          r.writeU16(std::min(lrintf(_model.state.battery.mahDrawn), 0xffffl)); // mah drawn
           r.writeU16(_model.getRssi()); // rssi
-          r.writeU16(0); // amperage
-          r.writeU16(_model.state.battery.voltage * 10);  // voltage: TODO to volts
+          r.writeU16(lrintf(_model.state.battery.current * 100.f)); // amperage [0.01A]
+          r.writeU16(lrintf(_model.state.battery.vbat * 100.f));  // voltage [0.01V]
           break;
 
         case MSP_FEATURE_CONFIG:
@@ -365,12 +366,12 @@ class MspProcessor
 
           // battery state
           r.writeU8(_model.state.battery.voltage); // in 0.1V steps
-          r.writeU16(0); // milliamp hours drawn from battery
-          r.writeU16(0); // send current in 0.01 A steps, range is -320A to 320A
+          r.writeU16(std::min(lrintf(_model.state.battery.mahDrawn), 0xffffl)); // milliamp hours drawn from battery
+          r.writeU16(lrintf(_model.state.battery.current * 100.f)); // send current in 0.01 A steps, range is -320A to 320A
 
           // battery alerts
           r.writeU8(0);
-          r.writeU16(_model.state.battery.voltage * 10); // FIXME: in volts
+          r.writeU16(lrintf(_model.state.battery.vbat * 100.f)); // in 0.01V steps
           break;
 
         case MSP_VOLTAGE_METERS:
@@ -382,6 +383,32 @@ class MspProcessor
           break;
 
         case MSP_CURRENT_METERS:
+          if(_model.config.ibatSource == 1)
+          {
+            r.writeU8(10);  // meter id (10-19 ibat adc)
+            r.writeU16(std::min(lrintf(_model.state.battery.mahDrawn), 0xffffl)); // mah drawn
+            r.writeU16(constrain(lrintf(_model.state.battery.current * 1000.f), 0l, 0xffffl)); // amperage [mA]
+          }
+          break;
+
+        case MSP_CURRENT_METER_CONFIG:
+          r.writeU8(1); // num current sensors
+          r.writeU8(6); // frame size (6)
+          r.writeU8(10); // id (10-19 ibat adc)
+          r.writeU8(1); // type adc
+          r.writeU16(_model.config.ibatScale); // scale [0.1mV/A]
+          r.writeU16(_model.config.ibatOffset); // offset [mV]
+          break;
+
+        case MSP_SET_CURRENT_METER_CONFIG:
+          {
+            int id = m.readU8();
+            if(id == 10 + 0) // id (10-19 ibat adc, allow only 10)
+            {
+              _model.config.ibatScale = m.readU16();
+              _model.config.ibatOffset = m.readU16();
+            }
+          }
           break;
 
         case MSP_VOLTAGE_METER_CONFIG:
@@ -594,14 +621,17 @@ class MspProcessor
           break;
 
         case MSP_ATTITUDE:
-          r.writeU16(lrintf(degrees(_model.state.angle.x) * 10.f)); // roll  [decidegrees]
-          r.writeU16(lrintf(degrees(_model.state.angle.y) * 10.f)); // pitch [decidegrees]
-          r.writeU16(lrintf(degrees(-_model.state.angle.z)));       // yaw   [degrees]
+          {
+            const VectorFloat angle = _model.getAngle();
+            r.writeU16(lrintf(degrees(angle.x) * 10.f)); // roll  [decidegrees]
+            r.writeU16(lrintf(degrees(angle.y) * 10.f)); // pitch [decidegrees]
+            r.writeU16(lrintf(degrees(-angle.z)));       // yaw   [degrees]
+          }
           break;
 
         case MSP_ALTITUDE:
-          r.writeU32(lrintf(_model.state.baroAltitude * 100.f));    // alt [cm]
-          r.writeU16(0); // vario
+          r.writeU32(lrintf(_model.state.altitude * 100.f));    // alt [cm]
+          r.writeU16(lrintf(_model.state.velocity.z * 100.f));  // vario [cm/s]
           break;
 
         case MSP_BEEPER_CONFIG:
@@ -834,6 +864,39 @@ class MspProcessor
 
           break;
 
+        case MSP2_ESPFC_TPA_CURVE:
+          r.writeU8(TPA_CURVE_POINTS);
+          for(size_t i = 0; i < TPA_CURVE_POINTS; i++)
+          {
+            r.writeU8(_model.config.tpaCurve[i]); // gain percent, evenly spread over throttle
+          }
+          for(size_t i = 0; i <= AXIS_YAW; i++)
+          {
+            r.writeU8(_model.config.tpaP[i]); // pterm weight percent
+            r.writeU8(_model.config.tpaD[i]); // dterm weight percent
+          }
+          break;
+
+        case MSP2_ESPFC_SET_TPA_CURVE:
+          if(m.remain() >= (int)(1 + TPA_CURVE_POINTS + 6) && m.readU8() == TPA_CURVE_POINTS)
+          {
+            for(size_t i = 0; i < TPA_CURVE_POINTS; i++)
+            {
+              _model.config.tpaCurve[i] = Math::clamp(m.readU8(), (uint8_t)0, TPA_CURVE_MAX);
+            }
+            for(size_t i = 0; i <= AXIS_YAW; i++)
+            {
+              _model.config.tpaP[i] = Math::clamp(m.readU8(), (uint8_t)0, TPA_WEIGHT_MAX);
+              _model.config.tpaD[i] = Math::clamp(m.readU8(), (uint8_t)0, TPA_WEIGHT_MAX);
+            }
+            _model.reload();
+          }
+          else
+          {
+            r.result = -1;
+          }
+          break;
+
         case MSP_SET_RC_TUNING:
           if(m.remain() >= 10)
           {
@@ -1092,12 +1155,12 @@ class MspProcessor
           r.writeU8(_model.config.angleLimit); // levelAngleLimit;
           r.writeU8(0); // was pidProfile.levelSensitivity
           r.writeU16(0); // itermThrottleThreshold;
-          r.writeU16(0); // itermAcceleratorGain; anti_gravity_gain
+          r.writeU16(_model.config.antiGravityGain); // itermAcceleratorGain; anti_gravity_gain
           r.writeU16(_model.config.dtermSetpointWeight);
           r.writeU8(0); // iterm rotation
           r.writeU8(0); // smart feed forward
-          r.writeU8(0); // iterm relax
-          r.writeU8(0); // iterm ralx type
+          r.writeU8(_model.config.itermRelax); // iterm relax
+          r.writeU8(1); // iterm ralx type, setpoint
           r.writeU8(0); // abs control gain
           r.writeU8(0); // throttle boost
           r.writeU8(0); // acro trainer max angle
@@ -1106,15 +1169,15 @@ class MspProcessor
           r.writeU16(_model.config.pid[PID_YAW].F); //pid yaw f
           r.writeU8(0); // antigravity mode
           // 1.41+
-          r.writeU8(0); // d min roll
-          r.writeU8(0); // d min pitch
-          r.writeU8(0); // d min yaw
-          r.writeU8(0); // d min gain
-          r.writeU8(0); // d min advance
+          r.writeU8(_model.config.dMin[AXIS_ROLL]); // d min roll
+          r.writeU8(_model.config.dMin[AXIS_PITCH]); // d min pitch
+          r.writeU8(_model.config.dMin[AXIS_YAW]); // d min yaw
+          r.writeU8(_model.config.dMinGain); // d min gain
+          r.writeU8(_model.config.dMinAdvance); // d min advance
           r.writeU8(0); // use_integrated_yaw
           r.writeU8(0); // integrated_yaw_relax
           // 1.42+
-          r.writeU8(0); // iterm_relax_cutoff
+          r.writeU8(_model.config.itermRelaxCutoff); // iterm_relax_cutoff
           // 1.43+
           r.writeU8(_model.config.output.motorLimit); // motor_output_limit
           r.writeU8(0); // auto_profile_cell_count
@@ -1140,8 +1203,8 @@ class MspProcessor
               m.readU8(); // was pidProfile.levelSensitivity
           }
           if (m.remain() >= 4) {
-              m.readU16();
-              m.readU16();
+              m.readU16(); // itermThrottleThreshold
+              _model.config.antiGravityGain = m.readU16(); // itermAcceleratorGain; anti_gravity_gain
           }
           if (m.remain() >= 2) {
             _model.config.dtermSetpointWeight = m.readU16();
@@ -1149,7 +1212,7 @@ class MspProcessor
           if (m.remain() >= 14) {
             m.readU8(); //iterm rotation
             m.readU8(); //smart feed forward
-            m.readU8(); //iterm relax
+            _model.config.itermRelax = m.readU8(); //iterm relax
             m.readU8(); //iterm ralx type
             m.readU8(); //abs control gain
             m.readU8(); //throttle boost
@@ -1161,17 +1224,17 @@ class MspProcessor
           }
           // 1.41+
           if (m.remain() >= 7) {
-            m.readU8(); // d min roll
-            m.readU8(); // d min pitch
-            m.readU8(); // g min yaw
-            m.readU8(); // d min gain
-            m.readU8(); // d min advance
+            _model.config.dMin[AXIS_ROLL] = m.readU8(); // d min roll
+            _model.config.dMin[AXIS_PITCH] = m.readU8(); // d min pitch
+            _model.config.dMin[AXIS_YAW] = m.readU8(); // d min yaw
+            _model.config.dMinGain = m.readU8(); // d min gain
+            _model.config.dMinAdvance = m.readU8(); // d min advance
             m.readU8(); // use_integrated_yaw
             m.readU8(); // integrated_yaw_relax
           }
           // 1.42+
           if (m.remain() >= 1) {
-            m.readU8(); // iterm_relax_cutoff
+            _model.config.itermRelaxCutoff = m.readU8(); // iterm_relax_cutoff
           }
           // 1.43+
           if (m.remain() >= 3) {
@@ -3,6 +3,7 @@
 
 #include "Model.h"
 #include "Output/Mixers.h"
+#include "Output/MixerMatrix.h"
 #include "EscDriver.h"
 
 namespace Espfc {
@@ -12,7 +13,7 @@ namespace Output {
 class Mixer
 {
   public:
-    Mixer(Model& model): _model(model), _motor(NULL), _servo(NULL) {}
+    Mixer(Model& model): _model(model), _thrustLinear(0.f), _thrustLinearInv(0.f), _thrustLinearB(0.f), _sagFactor(1.f), _sagThrustFactor(1.f), _motor(NULL), _servo(NULL) {}
 
     int begin()
     {
@@ -53,7 +54,11 @@ class Mixer
         _model.state.minThrottle = (_model.config.output.dshotIdle * 0.1f) + 1001.f;
         _model.state.maxThrottle = 2000.f;
       }
-      _model.state.currentMixer = Mixers::getMixer((MixerType)_model.config.mixerType, _model.state.customMixer);
+
+      // thrust = (1 - k) * u + k * u^2, inverted in motorOutput
+      _thrustLinear = Math::clamp((int)_model.config.output.thrustLinear, 0, 100) * 0.01f;
+      _thrustLinearInv = _thrustLinear > 0.f ? 1.f / _thrustLinear : 0.f;
+      _thrustLinearB = _thrustLinear > 0.f ? (1.f - _thrustLinear) / (2.f * _thrustLinear) : 0.f;
       return 1;
     }
 
@@ -79,13 +84,13 @@ class Mixer
       float outputs[OUTPUT_CHANNELS];
       const MixerConfig& mixer = _model.state.currentMixer;
 
-      updateMixer(mixer, outputs);
+      updateMixer(_model.state.mixerMatrix, outputs);
       writeOutput(mixer, outputs);
 
       return 1;
     }
 
-    void updateMixer(const MixerConfig& mixer, float * outputs)
+    void updateMixer(const MixerMatrix& mixer, float * outputs)
     {
       Stats::Measure mixerMeasure(_model.state.stats, COUNTER_MIXER);
 
@@ -106,67 +111,80 @@ class Mixer
       {
         sources[MIXER_SOURCE_RC_AUX1 + i] = _model.state.input[AXIS_AUX_1 + i];
       }
-      
-      for(size_t i = 0; i < OUTPUT_CHANNELS; i++)
+
+      for(size_t i = mixer.count; i < OUTPUT_CHANNELS; i++)
       {
         outputs[i] = 0.f;
       }
 
-      // mix stabilized sources first
-      const MixerEntry * entry = mixer.mixes;
-      const MixerEntry * end = mixer.mixes + MIXER_RULE_MAX;
-      while(entry != end)
+      // mix stabilized sources first, yaw kept apart for saturation resolver
+      float yaw[OUTPUT_CHANNELS];
+      for(size_t i = 0; i < mixer.count; i++)
+      {
+        const float * row = mixer.m[i];
+        outputs[i] = row[MIXER_SOURCE_ROLL] * sources[MIXER_SOURCE_ROLL]
+                   + row[MIXER_SOURCE_PITCH] * sources[MIXER_SOURCE_PITCH];
+        yaw[i] = row[MIXER_SOURCE_YAW] * sources[MIXER_SOURCE_YAW];
+      }
+
+      // battery sag compensation boosts motor commands u' = g * u. Applied before saturation handling
+      // as demand gain G, so resolver sees boosted span. Demand 1 maps to u = 1 / g, motorOutput restores
+      // the demand, linearizes and applies g, so with linear thrust G = g.
+      float thrust = limitThrust(sources[MIXER_SOURCE_THRUST], (ThrottleLimitType)_model.config.output.throttleLimitType, _model.config.output.throttleLimitPercent);
+      _sagFactor = getSagFactor();
+      _sagThrustFactor = 1.f / thrustCurve(1.f / _sagFactor);
+      if(_sagFactor != 1.f)
       {
-        if(entry->src == MIXER_SOURCE_NULL) break; // break on terminator
-        if(entry->src <= MIXER_SOURCE_YAW && entry->dst < mixer.count && entry->rate != 0)
+        for(size_t i = 0; i < mixer.count; i++)
         {
-          outputs[entry->dst] += sources[entry->src] * (entry->rate * 0.01f);
+          if(_model.config.output.channel[i].servo) continue;
+          outputs[i] *= _sagThrustFactor;
+          yaw[i] *= _sagThrustFactor;
         }
-        entry++;
+        thrust = (thrust + 1.f) * _sagThrustFactor - 1.f;
       }
 
       // airmode logic
-      float thrust = limitThrust(sources[MIXER_SOURCE_THRUST], (ThrottleLimitType)_model.config.output.throttleLimitType, _model.config.output.throttleLimitPercent);
       if(_model.isAirModeActive())
       {
-        float min = 0.f, max = 0.f;
-        for(size_t i = 0; i < mixer.count; i++)
+        const float yawMin = Math::clamp((int)_model.config.output.yawPriority, 0, 100) * 0.01f;
+        const float thrustIn = thrust;
+        uint8_t flags = 0;
+        thrust = resolveSaturation(outputs, yaw, mixer.count, thrust, yawMin, flags);
+        if(_model.config.debugMode == DEBUG_MIXER_SATURATION)
         {
-          max = std::max(max, outputs[i]);
-          min = std::min(min, outputs[i]);
+          _model.state.debug[0] = flags; // MixerSaturationFlag bits
+          _model.state.debug[1] = lrintf(thrustIn * 1000);
+          _model.state.debug[2] = lrintf(thrust * 1000);
         }
-        float range = (max - min) * 0.5f;
-        if(range > 1.f)
+      }
+      else
+      {
+        for(size_t i = 0; i < mixer.count; i++)
         {
-          for(size_t i = 0; i < mixer.count; i++)
-          {
-            outputs[i] /= range;
-          }
-          thrust = 0.f; //limitThrust(0.f);
+          outputs[i] += yaw[i];
         }
-        else
+        if(_model.config.debugMode == DEBUG_MIXER_SATURATION)
         {
-          thrust = Math::clamp(thrust, -1.f + range, 1.f - range);
+          _model.state.debug[0] = 0;
+          _model.state.debug[1] = 0;
+          _model.state.debug[2] = 0;
         }
       }
 
-      // apply other channels
-      entry = mixer.mixes;
-      while(entry != end)
+      // apply other channels, servos get thrust without sag boost
+      const float servoThrust = (thrust + 1.f) / _sagThrustFactor - 1.f;
+      for(size_t i = 0; i < mixer.count; i++)
       {
-        if(entry->src == MIXER_SOURCE_NULL) break; // break on terminator
-        if(entry->dst < mixer.count)
+        const float * row = mixer.m[i];
+        outputs[i] += row[MIXER_SOURCE_THRUST] * (_model.config.output.channel[i].servo ? servoThrust : thrust);
+        if(mixer.rcSources)
         {
-          if(entry->src == MIXER_SOURCE_THRUST)
-          {
-            outputs[entry->dst] += thrust * (entry->rate * 0.01f);
-          }
-          else if(entry->src > MIXER_SOURCE_THRUST && entry->src < MIXER_SOURCE_MAX)
+          for(size_t j = MIXER_SOURCE_RC_ROLL; j < MIXER_SOURCE_MAX; j++)
           {
-            outputs[entry->dst] += sources[entry->src] * (entry->rate * 0.01f);
+            outputs[i] += row[j] * sources[j];
           }
         }
-        entry++;
       }
 
       for(size_t i = 0; i < mixer.count; i++)
@@ -175,6 +193,80 @@ class Mixer
       }
     }
 
+    // Fits roll, pitch and yaw into output span, keeping roll and pitch authority first.
+    // On entry outputs hold roll and pitch mix, on exit full stabilized mix. Yaw is scaled
+    // down to yawMin before everything is scaled together, then thrust is moved into
+    // the room left. Returns thrust, saturation flags are or-ed into flags.
+    float resolveSaturation(float * outputs, const float * yaw, size_t count, float thrust, float yawMin, uint8_t& flags) const
+    {
+      if(!count) return thrust;
+
+      float rpMin = outputs[0], rpMax = outputs[0];
+      for(size_t i = 1; i < count; i++)
+      {
+        rpMin = std::min(rpMin, outputs[i]);
+        rpMax = std::max(rpMax, outputs[i]);
+      }
+
+      float yawScale = 1.f;
+      if(rpMax - rpMin > 2.f)
+      {
+        // roll and pitch alone do not fit, no room for yaw
+        const float scale = 2.f / (rpMax - rpMin);
+        for(size_t i = 0; i < count; i++)
+        {
+          outputs[i] *= scale;
+        }
+        yawScale = 0.f;
+        flags |= MIXER_SATURATION_RP;
+      }
+      else
+      {
+        // largest yaw scale keeping every pair of outputs within span
+        for(size_t i = 0; i < count; i++)
+        {
+          for(size_t j = 0; j < count; j++)
+          {
+            const float dy = yaw[i] - yaw[j];
+            if(dy <= 0.f) continue;
+            yawScale = std::min(yawScale, (2.f - (outputs[i] - outputs[j])) / dy);
+          }
+        }
+        yawScale = std::max(yawScale, yawMin);
+      }
+      if(yawScale < 1.f) flags |= MIXER_SATURATION_YAW;
+
+      for(size_t i = 0; i < count; i++)
+      {
+        outputs[i] += yaw[i] * yawScale;
+      }
+      float min = outputs[0], max = outputs[0];
+      for(size_t i = 1; i < count; i++)
+      {
+        min = std::min(min, outputs[i]);
+        max = std::max(max, outputs[i]);
+      }
+
+      // yaw limited to minimum and still saturated, scale all together
+      if(max - min > 2.f)
+      {
+        const float scale = 2.f / (max - min);
+        for(size_t i = 0; i < count; i++)
+        {
+          outputs[i] *= scale;
+        }
+        min *= scale;
+        max *= scale;
+        flags |= MIXER_SATURATION_RP;
+      }
+
+      // move thrust into remaining room
+      const float lo = -1.f - min, hi = 1.f - max;
+      const float adjusted = lo < hi ? Math::clamp(thrust, lo, hi) : (lo + hi) * 0.5f;
+      if(adjusted != thrust) flags |= MIXER_SATURATION_THRUST;
+      return adjusted;
+    }
+
     float limitThrust(float thrust, ThrottleLimitType type, int8_t limit)
     {
       if(type == THROTTLE_LIMIT_TYPE_NONE || limit >= 100 || limit < 1) return thrust;
@@ -209,6 +301,37 @@ class Mixer
       }
     }
 
+    // thrust [0, 1] to motor command [0, 1], nominal voltage
+    float linearizeThrust(float thrust) const
+    {
+      if(_thrustLinear <= 0.f || thrust <= 0.f) return std::max(thrust, 0.f);
+      return sqrtf(thrust * _thrustLinearInv + _thrustLinearB * _thrustLinearB) - _thrustLinearB;
+    }
+
+    // motor command gain keeping thrust as battery sags below full cell voltage
+    float getSagFactor() const
+    {
+      const BatteryState& b = _model.state.battery;
+      if(_model.config.output.vbatSagCompensation <= 0 || b.voltage < 20) return 1.f; // off or no battery
+      const float full = _model.config.vbatCellFull * 0.1f;
+      const float cell = std::max(b.vbat / Math::clamp((int)b.cells, 1, 6), full * 0.7f);
+      if(cell >= full) return 1.f;
+      return 1.f + (full / cell - 1.f) * Math::clamp((int)_model.config.output.vbatSagCompensation, 0, 100) * 0.01f;
+    }
+
+    // thrust of motor command u in [0, 1], inverse of linearizeThrust
+    float thrustCurve(float u) const
+    {
+      return (1.f - _thrustLinear) * u + _thrustLinear * u * u;
+    }
+
+    // motor output [-1, 1] with thrust linearization and sag compensation applied
+    float motorOutput(float out) const
+    {
+      const float thrust = (Math::clamp(out, -1.f, 1.f) + 1.f) * 0.5f / _sagThrustFactor;
+      return std::min(linearizeThrust(thrust) * _sagFactor, 1.f) * 2.f - 1.f;
+    }
+
     void writeOutput(const MixerConfig& mixer, float * out)
     {
       Stats::Measure mixerMeasure(_model.state.stats, COUNTER_MIXER_WRITE);
@@ -230,7 +353,7 @@ class Mixer
           }
           else
           {
-            float v = Math::clamp(out[i], -1.f, 1.f);
+            const float v = motorOutput(out[i]);
             _model.state.outputUs[i] = lrintf(Math::map(v, -1.f, 1.f, _model.state.minThrottle, _model.state.maxThrottle));
           }
         }
@@ -264,6 +387,11 @@ class Mixer
     }
 
     Model& _model;
+    float _thrustLinear;
+    float _thrustLinearInv;
+    float _thrustLinearB;
+    float _sagFactor;
+    float _sagThrustFactor;
     EscDriver * _motor;
     EscDriver * _servo;
 
@@ -0,0 +1,50 @@
+#ifndef _ESPFC_OUTPUT_MIXER_MATRIX_H_
+#define _ESPFC_OUTPUT_MIXER_MATRIX_H_
+
+#include "ModelConfig.h"
+
+namespace Espfc {
+
+namespace Output {
+
+// Mixer rules compiled to dense outputs x sources matrix, rates pre-scaled.
+// Duplicated rules accumulate, rules past terminator or out of range are dropped.
+class MixerMatrix
+{
+  public:
+    MixerMatrix(): count(0), rcSources(false) {}
+
+    void compile(const MixerConfig& mixer)
+    {
+      count = std::min((size_t)mixer.count, OUTPUT_CHANNELS);
+      rcSources = false;
+      for(size_t i = 0; i < OUTPUT_CHANNELS; i++)
+      {
+        for(size_t j = 0; j < MIXER_SOURCE_MAX; j++)
+        {
+          m[i][j] = 0.f;
+        }
+      }
+      if(!mixer.mixes) return;
+
+      const MixerEntry * entry = mixer.mixes;
+      const MixerEntry * end = mixer.mixes + MIXER_RULE_MAX;
+      for(; entry != end && entry->src != MIXER_SOURCE_NULL; entry++)
+      {
+        if(entry->src < 0 || entry->src >= MIXER_SOURCE_MAX) continue;
+        if(entry->dst < 0 || (size_t)entry->dst >= count) continue;
+        m[entry->dst][entry->src] += entry->rate * 0.01f;
+        if(entry->src > MIXER_SOURCE_THRUST && entry->rate != 0) rcSources = true;
+      }
+    }
+
+    size_t count;
+    bool rcSources;
+    float m[OUTPUT_CHANNELS][MIXER_SOURCE_MAX];
+};
+
+}
+
+}
+
+#endif
@@ -3,6 +3,10 @@
 
 #include "BaseSensor.h"
 #include "Device/GyroDevice.h"
+#include "Math/Welford.h"
+#include "Math/SixPointCalibration.h"
+
+#define ESPFC_ACCEL_CALIB_MOTION 0.5f // max deviation from mean [m/s^2]
 
 namespace Espfc {
 
@@ -11,7 +15,7 @@ namespace Sensor {
 class AccelSensor: public BaseSensor
 {
   public:
-    AccelSensor(Model& model): _model(model) {}
+    AccelSensor(Model& model): _model(model), _face(-1) {}
     
     int begin()
     {
@@ -90,23 +94,59 @@ class AccelSensor: public BaseSensor
   private:
     void calibrate()
     {
+      const VectorFloat raw = _model.state.accel;
+      _model.state.accel = Math::SixPointCalibration::apply(_model.state.accelCalibrationScale, _model.state.accelCalibrationCross, raw);
+      const bool sixPoint = _model.state.accelCalibrationMode != ACCEL_CALIBRATION_LEVEL;
+
       switch(_model.state.accelCalibrationState)
       {
         case CALIBRATION_IDLE:
           _model.state.accel -= _model.state.accelBias;
           break;
         case CALIBRATION_START:
-          _model.state.accelBias = VectorFloat(0, 0, ACCEL_G);
-          _model.state.accelBiasSamples = 2 * _model.state.accelTimer.rate;
+          if(sixPoint)
+          {
+            _six.reset();
+            _window.reset();
+            _face = -1;
+            _model.state.accelCalibrationPoints = 0;
+            _model.state.accelBiasSamples = _model.state.accelTimer.rate;
+          }
+          else
+          {
+            _model.state.accelBias = VectorFloat(0, 0, ACCEL_G);
+            _model.state.accelBiasSamples = 2 * _model.state.accelTimer.rate;
+          }
           _model.state.accelCalibrationState = CALIBRATION_UPDATE;
           break;
         case CALIBRATION_UPDATE:
+          if(sixPoint)
+          {
+            updateSixPoint(raw);
+            break;
+          }
           _model.state.accelBias += (_model.state.accel - _model.state.accelBias) * _model.state.accelBiasAlpha;
           _model.state.accelBiasSamples--;
           if(_model.state.accelBiasSamples <= 0) _model.state.accelCalibrationState = CALIBRATION_APPLY;
           break;
         case CALIBRATION_APPLY:
-          _model.state.accelBias.z -= ACCEL_G;
+          if(sixPoint)
+          {
+            VectorFloat scale, cross, bias;
+            if(!_six.solve(ACCEL_G, _model.state.accelCalibrationMode == ACCEL_CALIBRATION_SIX_CROSS, scale, cross, bias))
+            {
+              _model.state.buzzer.push(BEEPER_ACC_CALIBRATION_FAIL);
+              _model.state.accelCalibrationState = CALIBRATION_IDLE;
+              break;
+            }
+            _model.state.accelCalibrationScale = scale;
+            _model.state.accelCalibrationCross = cross;
+            _model.state.accelBias = bias;
+          }
+          else
+          {
+            _model.state.accelBias.z -= ACCEL_G;
+          }
           _model.state.accelCalibrationState = CALIBRATION_SAVE;
           break;
         case CALIBRATION_SAVE:
@@ -119,9 +159,37 @@ class AccelSensor: public BaseSensor
       }
     }
 
+    // collect one second of still samples per orientation, side order is free
+    void updateSixPoint(const VectorFloat& raw)
+    {
+      int face = Math::SixPointCalibration::face(raw, ACCEL_G);
+      VectorFloat deviation = raw;
+      deviation -= _window.mean();
+      bool motion = _window.count() && deviation.getMagnitude() > ESPFC_ACCEL_CALIB_MOTION;
+      if(face != _face || motion)
+      {
+        _window.reset();
+        _face = face;
+      }
+      if(face < 0 || _six.has(face)) return;
+
+      _window.update(raw);
+      _model.state.accelBiasSamples = _model.state.accelTimer.rate - _window.count();
+      if(_model.state.accelBiasSamples > 0) return;
+
+      _six.set(face, _window.mean());
+      _window.reset();
+      _model.state.accelCalibrationPoints = _six.mask();
+      _model.state.buzzer.push(BEEPER_ACC_CALIBRATION);
+      if(_six.complete()) _model.state.accelCalibrationState = CALIBRATION_APPLY;
+    }
+
     Model& _model;
     Device::GyroDevice * _gyro;
     Filter _filter[3];
+    Math::SixPointCalibration _six;
+    Math::Welford<VectorFloat> _window;
+    int _face;
 };
 
 }
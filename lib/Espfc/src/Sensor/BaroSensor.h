@@ -4,6 +4,7 @@
 #include "BaseSensor.h"
 #include "Device/BaroDevice.h"
 #include "Filter.h"
+#include <algorithm>
 
 namespace Espfc {
 
@@ -17,9 +18,10 @@ class BaroSensor: public BaseSensor
       BARO_STATE_INIT,
       BARO_STATE_TEMP_GET,
       BARO_STATE_PRESS_GET,
+      BARO_STATE_CONTINUOUS_GET,
     };
 
-    BaroSensor(Model& model): _model(model), _state(BARO_STATE_INIT), _counter(0) {}
+    BaroSensor(Model& model): _model(model), _state(BARO_STATE_INIT), _counter(0), _next(0), _ticks(1), _denom(1), _phase(0), _cost(0) {}
 
     int begin()
     {
@@ -28,10 +30,18 @@ class BaroSensor: public BaseSensor
       _baro = _model.state.baroDev;
       if(!_baro) return 0;
 
-      _baro->setMode(BARO_MODE_TEMP);
+      if(!_baro->isContinuous()) _baro->setMode(BARO_MODE_TEMP);
+
+      // baro steps go to gyro iterations between loop iterations, whole cycle is a multiple of loop sync
+      _denom = std::max(_model.state.loopTimer.denom, (uint32_t)1);
+      _phase = _denom / 2;
       int delay = _baro->getDelay();
       int toGyroRate = (delay / _model.state.gyroTimer.interval) + 1; // number of gyro readings per cycle
-      int interval = _model.state.gyroTimer.interval * toGyroRate;
+      _ticks = ((toGyroRate + _denom - 1) / _denom) * _denom;
+      _next = _model.state.gyroTimer.iteration;
+      _state = BARO_STATE_INIT;
+
+      int interval = _model.state.gyroTimer.interval * _ticks;
       int rate = 1000000 / interval;
       _model.state.baroRate = rate;
 
@@ -39,7 +49,7 @@ class BaroSensor: public BaseSensor
       _pressureFilter.begin(FilterConfig(FILTER_MEDIAN3, 10), rate);
       _altitudeFilter.begin(_model.config.baroFilter, rate);
 
-      _model.logger.info().log(F("BARO INIT")).log(FPSTR(Device::BaroDevice::getName(_baro->getType()))).log(toGyroRate).log(rate).logln(_model.config.baroFilter.freq);
+      _model.logger.info().log(F("BARO INIT")).log(FPSTR(Device::BaroDevice::getName(_baro->getType()))).log(_ticks).log(rate).logln(_model.config.baroFilter.freq);
 
       return 1;
     }
@@ -54,29 +64,71 @@ class BaroSensor: public BaseSensor
     int read()
     {
       if(!_baro || !_model.baroActive()) return 0;
-      
+      if(!ready()) return 0;
+
       Stats::Measure measure(_model.state.stats, COUNTER_BARO);
-      
-      if(_wait > micros()) return 0;
+      const uint32_t start = micros();
+      int status = step();
+      const uint32_t cost = micros() - start;
+      _cost = std::max(cost, _cost - (_cost >> 3));
+
+      return status;
+    }
 
+  private:
+    // due slot reached and remaining time in current gyro iteration fits a step,
+    // a step postponed for whole conversion time is forced
+    bool ready() const
+    {
+      const Timer& gyro = _model.state.gyroTimer;
+      const int32_t late = gyro.iteration - _next;
+      if(late < 0) return false;
+      const uint32_t elapsed = micros() - gyro.last;
+      if(elapsed + _cost > gyro.interval && late < (int32_t)_ticks) return false;
+      return true;
+    }
+
+    // next step one conversion later, aligned to slot phase
+    void schedule()
+    {
+      _next = _model.state.gyroTimer.iteration + _ticks;
+      _next += (_phase + _denom - _next % _denom) % _denom;
+    }
+
+    // returns 1 when new value is available, pending transfers are polled in following iterations
+    int step()
+    {
       switch(_state)
       {
         case BARO_STATE_INIT:
-          _baro->setMode(BARO_MODE_TEMP);
-          _state = BARO_STATE_TEMP_GET;
-          _wait = micros() + _baro->getDelay();
+          if(_baro->isContinuous())
+          {
+            _state = BARO_STATE_CONTINUOUS_GET;
+          }
+          else
+          {
+            _baro->setMode(BARO_MODE_TEMP);
+            _state = BARO_STATE_TEMP_GET;
+          }
+          schedule();
           return 0;
+        case BARO_STATE_CONTINUOUS_GET:
+          if(!readTemperaturePressure()) return 0;
+          updateTemperature();
+          updateAltitude();
+          schedule();
+          return 1;
         case BARO_STATE_TEMP_GET:
-          readTemperature();
+          if(!readTemperature()) return 0;
           updateTemperature();
           updateAltitude();
           _baro->setMode(BARO_MODE_PRESS);
           _state = BARO_STATE_PRESS_GET;
-          _wait = micros() + _baro->getDelay();
           _counter = 9;
+          schedule();
           return 1;
         case BARO_STATE_PRESS_GET:
-          readPressure();
+          if(!readPressure()) return 0;
           updateAltitude();
           if(--_counter > 0)
           {
@@ -88,9 +140,8 @@ class BaroSensor: public BaseSensor
             _baro->setMode(BARO_MODE_TEMP);
             _state = BARO_STATE_TEMP_GET;
           }
-          _wait = micros() + _baro->getDelay();
+          schedule();
           return 1;
-          break;
         default:
           _state = BARO_STATE_INIT;
           break;
@@ -99,10 +150,10 @@ class BaroSensor: public BaseSensor
       return 0;
     }
 
-  private:
-    void readTemperature()
+    // returns false while transfer is pending, on error last value is kept
+    bool readTemperature()
     {
-      _model.state.baroTemperatureRaw = _baro->readTemperature();
+      return _baro->readTemperatureAsync(_model.state.baroTemperatureRaw) != 0;
     }
 
     void updateTemperature()
@@ -110,9 +161,14 @@ class BaroSensor: public BaseSensor
       _model.state.baroTemperature = _temperatureFilter.update(_model.state.baroTemperatureRaw);
     }
 
-    void readPressure()
+    bool readPressure()
+    {
+      return _baro->readPressureAsync(_model.state.baroPressureRaw) != 0;
+    }
+
+    bool readTemperaturePressure()
     {
-      _model.state.baroPressureRaw = _baro->readPressure();
+      return _baro->readTemperaturePressureAsync(_model.state.baroTemperatureRaw, _model.state.baroPressureRaw) != 0;
     }
 
     void updateAltitude()
@@ -133,8 +189,12 @@ class BaroSensor: public BaseSensor
     Filter _temperatureFilter;
     Filter _pressureFilter;
     Filter _altitudeFilter;
-    uint32_t _wait;
     int32_t _counter;
+    uint32_t _next;
+    uint32_t _ticks;
+    uint32_t _denom;
+    uint32_t _phase;
+    uint32_t _cost;
 };
 
 }
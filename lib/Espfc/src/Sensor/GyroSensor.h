@@ -4,6 +4,8 @@
 #include "BaseSensor.h"
 #include "Device/GyroDevice.h"
 #include "Math/Sma.h"
+#include "Math/Cic.h"
+#include "Math/Welford.h"
 #include "Math/FreqAnalyzer.h"
 #ifdef ESPFC_DSP
 #include "Math/FFTAnalyzer.h"
@@ -11,6 +13,10 @@
 
 #define ESPFC_FUZZY_ACCEL_ZERO 0.05
 #define ESPFC_FUZZY_GYRO_ZERO  0.20
+#define ESPFC_GYRO_STUCK_COUNT 100
+#define ESPFC_GYRO_CALIB_NOISE  0.01f // max std deviation [rad/s]
+#define ESPFC_GYRO_CALIB_MOTION 0.05f // max deviation from mean [rad/s]
+#define ESPFC_GYRO_CALIB_TIMEOUT 10     // give up after [s], stored bias is kept
 
 namespace Espfc {
 
@@ -19,7 +25,7 @@ namespace Sensor {
 class GyroSensor: public BaseSensor
 {
   public:
-    GyroSensor(Model& model): _dyn_notch_denom(1), _model(model) {}
+    GyroSensor(Model& model): _dyn_notch_denom(1), _model(model), _gyro2(nullptr) {}
 
     int begin()
     {
@@ -38,11 +44,27 @@ class GyroSensor: public BaseSensor
       }
       _gyro->setFullScaleGyroRange(_model.config.gyroFsr);
 
+      _gyro2 = _model.state.gyroDev2;
+      if(_gyro2)
+      {
+        _gyro2->setDLPFMode(_model.config.gyroDlpf);
+        _gyro2->setRate(_gyro2->getRate());
+        _gyro2->setFullScaleGyroRange(_model.config.gyroFsr);
+      }
+      _model.state.gyroFault = 0;
+      _stuck[0] = _stuck[1] = 0;
+
       _model.state.gyroCalibrationState = CALIBRATION_START; // calibrate gyro on start
       _model.state.gyroCalibrationRate = _model.state.loopTimer.rate;
-      _model.state.gyroBiasAlpha = 5.0f / _model.state.gyroCalibrationRate;
+      _calib_min = std::max(10, _model.state.gyroCalibrationRate / 10); // 100ms
+      _calib_max = 2 * _model.state.gyroCalibrationRate;
+      _calib_timeout = ESPFC_GYRO_CALIB_TIMEOUT * _model.state.gyroCalibrationRate;
 
       _sma.begin(_model.config.loopSync);
+      for(size_t i = 0; i < 3; i++)
+      {
+        _cic[i].begin(_model.config.gyroDecimation, _model.config.loopSync);
+      }
       _dyn_notch_denom = std::max((uint32_t)1, _model.state.loopTimer.rate / 1000);
       _dyn_notch_sma.begin(_dyn_notch_denom);
 
@@ -73,9 +95,27 @@ class GyroSensor: public BaseSensor
 
       Stats::Measure measure(_model.state.stats, COUNTER_GYRO_READ);
 
-      _gyro->readGyro(_model.state.gyroRaw);
+      if(_gyro2)
+      {
+        readDual();
+      }
+      else
+      {
+        _gyro->readGyro(_model.state.gyroRaw);
+        align(_model.state.gyroRaw, _model.config.gyroAlign);
+      }
 
-      align(_model.state.gyroRaw, _model.config.gyroAlign);
+      if(_model.config.gyroDecimation != GYRO_DECIM_NONE)
+      {
+        // integer anti-alias filter at gyro rate, output on loop sync
+        bool decimate = _model.state.gyroTimer.iteration % _model.state.loopTimer.denom == 0;
+        for(size_t i = 0; i < 3; ++i)
+        {
+          _cic[i].update(_model.state.gyroRaw[i]);
+          if(decimate) _model.state.gyroSampled.set(i, _cic[i].decimate() * _model.state.gyroScale);
+        }
+        return 1;
+      }
 
       VectorFloat input = (VectorFloat)_model.state.gyroRaw * _model.state.gyroScale;
 
@@ -161,6 +201,90 @@ class GyroSensor: public BaseSensor
     }
 
   private:
+    // both sensors are sampled back to back in the same gyro cycle
+    void readDual()
+    {
+      VectorInt16 raw[2];
+      int status[2];
+      status[0] = _gyro->readGyro(raw[0]);
+      status[1] = _gyro2->readGyro(raw[1]);
+      align(raw[0], _model.config.gyroAlign);
+      align(raw[1], _model.config.gyro2Align);
+
+      for(size_t i = 0; i < 2; i++)
+      {
+        checkFault(i, status[i], raw[i]);
+      }
+
+      bool fault0 = _model.state.gyroFault & 1;
+      bool fault1 = _model.state.gyroFault & 2;
+      switch(_model.config.gyroSelect)
+      {
+        case GYRO_SELECT_SECOND:
+          _model.state.gyroRaw = raw[1];
+          break;
+        case GYRO_SELECT_AUTO:
+          if(fault0 && !fault1) _model.state.gyroRaw = raw[1];
+          else if(fault1 && !fault0) _model.state.gyroRaw = raw[0];
+          else average(raw[0], raw[1]);
+          break;
+        case GYRO_SELECT_BOTH:
+          average(raw[0], raw[1]);
+          break;
+        default:
+          _model.state.gyroRaw = raw[0];
+          break;
+      }
+
+      switch(_model.config.debugMode)
+      {
+        case DEBUG_DUAL_GYRO_RAW:
+          _model.state.debug[0] = raw[0].x;
+          _model.state.debug[1] = raw[0].y;
+          _model.state.debug[2] = raw[1].x;
+          _model.state.debug[3] = raw[1].y;
+          break;
+        case DEBUG_DUAL_GYRO_SCALED:
+          _model.state.debug[0] = lrintf(degrees(raw[0].x * _model.state.gyroScale));
+          _model.state.debug[1] = lrintf(degrees(raw[0].y * _model.state.gyroScale));
+          _model.state.debug[2] = lrintf(degrees(raw[1].x * _model.state.gyroScale));
+          _model.state.debug[3] = lrintf(degrees(raw[1].y * _model.state.gyroScale));
+          break;
+        case DEBUG_DUAL_GYRO_DIFF:
+          for(size_t i = 0; i < 3; i++)
+          {
+            _model.state.debug[i] = lrintf(degrees((raw[0][i] - raw[1][i]) * _model.state.gyroScale));
+          }
+          break;
+        default:
+          break;
+      }
+    }
+
+    void average(const VectorInt16& a, const VectorInt16& b)
+    {
+      _model.state.gyroRaw.x = ((int32_t)a.x + b.x) / 2;
+      _model.state.gyroRaw.y = ((int32_t)a.y + b.y) / 2;
+      _model.state.gyroRaw.z = ((int32_t)a.z + b.z) / 2;
+    }
+
+    // read error or identical samples for too long marks gyro as faulty
+    void checkFault(size_t i, int status, const VectorInt16& v)
+    {
+      const uint8_t mask = 1 << i;
+      bool same = v.x == _last[i].x && v.y == _last[i].y && v.z == _last[i].z;
+      _last[i] = v;
+      _stuck[i] = same ? std::min(_stuck[i] + 1, ESPFC_GYRO_STUCK_COUNT) : 0;
+      if(!status || _stuck[i] >= ESPFC_GYRO_STUCK_COUNT)
+      {
+        _model.state.gyroFault |= mask;
+      }
+      else
+      {
+        _model.state.gyroFault &= ~mask;
+      }
+    }
+
     void filterDynNotch()
     {
       bool dynamicFilterEnabled = _model.isActive(FEATURE_DYNAMIC_FILTER);
@@ -231,6 +355,13 @@ class GyroSensor: public BaseSensor
       }
     }
 
+    void restartCalibration()
+    {
+      _calib.reset();
+      _model.state.gyroBiasSamples = _calib_min;
+      _model.state.gyroCalibrationRestarts++;
+    }
+
     void calibrate()
     {
       switch(_model.state.gyroCalibrationState)
@@ -239,20 +370,60 @@ class GyroSensor: public BaseSensor
           _model.state.gyro -= _model.state.gyroBias;
           break;
         case CALIBRATION_START:
-          //_model.state.gyroBias = VectorFloat();
-          _model.state.gyroBiasSamples = 2 * _model.state.gyroCalibrationRate;
+          _calib.reset();
+          _calib_elapsed = 0;
+          _model.state.gyroBiasSamples = _calib_min;
+          _model.state.gyroCalibrationRestarts = 0;
+          _model.state.gyroCalibrationFailed = false;
           _model.state.gyroCalibrationState = CALIBRATION_UPDATE;
           break;
         case CALIBRATION_UPDATE:
           {
+            // restart window on motion, finish as soon as noise is low enough,
+            // board not still within timeout keeps previous bias
+            if(++_calib_elapsed > _calib_timeout)
+            {
+              _model.state.gyroBiasSamples = 0;
+              _model.state.gyroCalibrationFailed = true;
+              _model.state.gyroCalibrationState = CALIBRATION_IDLE;
+              _model.logger.err().logln(F("GYRO CALIBRATION FAILED"));
+              break;
+            }
+
             VectorFloat deltaAccel = _model.state.accel - _model.state.accelPrev;
             _model.state.accelPrev = _model.state.accel;
-            if(deltaAccel.getMagnitude() < ESPFC_FUZZY_ACCEL_ZERO && _model.state.gyro.getMagnitude() < ESPFC_FUZZY_GYRO_ZERO)
+            VectorFloat deviation = _model.state.gyro;
+            deviation -= _calib.mean();
+            bool motion = deltaAccel.getMagnitude() >= ESPFC_FUZZY_ACCEL_ZERO || (_calib.count() && deviation.getMagnitude() > ESPFC_GYRO_CALIB_MOTION);
+            if(motion)
+            {
+              restartCalibration();
+              break;
+            }
+
+            _calib.update(_model.state.gyro);
+            if((int)_calib.count() < _calib_min)
+            {
+              _model.state.gyroBiasSamples = _calib_min - _calib.count();
+              break;
+            }
+
+            // steady rotation is not a bias
+            if(_calib.mean().getMagnitude() >= ESPFC_FUZZY_GYRO_ZERO)
+            {
+              restartCalibration();
+              break;
+            }
+
+            const VectorFloat variance = _calib.variance();
+            const float noise = sqrtf(std::max(variance.x, std::max(variance.y, variance.z)));
+            _model.state.gyroCalibrationNoise = noise;
+            if(noise < ESPFC_GYRO_CALIB_NOISE || (int)_calib.count() >= _calib_max) // full window accepted as is, noise reported as quality
             {
-              _model.state.gyroBias += (_model.state.gyro - _model.state.gyroBias) * _model.state.gyroBiasAlpha;
-              _model.state.gyroBiasSamples--;
+              _model.state.gyroBias = _calib.mean();
+              _model.state.gyroBiasSamples = 0;
+              _model.state.gyroCalibrationState = CALIBRATION_APPLY;
             }
-            if(_model.state.gyroBiasSamples <= 0) _model.state.gyroCalibrationState = CALIBRATION_APPLY;
           }
           break;
         case CALIBRATION_APPLY:
@@ -269,11 +440,20 @@ class GyroSensor: public BaseSensor
     }
 
     Math::Sma<VectorFloat, 8> _sma;
+    Math::Cic _cic[3];
+    Math::Welford<VectorFloat> _calib;
+    int _calib_min;
+    int _calib_max;
+    int _calib_timeout;
+    int _calib_elapsed;
     Math::Sma<VectorFloat, 8> _dyn_notch_sma;
     size_t _dyn_notch_denom;
 
     Model& _model;
     Device::GyroDevice * _gyro;
+    Device::GyroDevice * _gyro2;
+    VectorInt16 _last[2];
+    int _stuck[2];
 
 #ifdef ESPFC_DSP
     Math::FFTAnalyzer<128> _fft[3];
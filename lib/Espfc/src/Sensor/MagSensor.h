@@ -3,9 +3,14 @@
 
 #include "BaseSensor.h"
 #include "Device/MagDevice.h"
+#include "Math/EllipsoidFit.h"
 
 #include <math.h>
 
+#define ESPFC_MAG_CALIB_OUTLIER  0.25f // max relative radius deviation
+#define ESPFC_MAG_CALIB_ERROR    0.02f // rms radius error to finish early
+#define ESPFC_MAG_CALIB_COVERAGE 22    // of 26 directions to finish early
+
 namespace Espfc {
 
 namespace Sensor {
@@ -13,7 +18,7 @@ namespace Sensor {
 class MagSensor: public BaseSensor
 {
   public:
-    MagSensor(Model& model): _model(model) {}
+    MagSensor(Model& model): _model(model), _pending(false), _fitValid(false), _sectors(0), _rejected(0) {}
 
     int begin()
     {
@@ -44,22 +49,26 @@ class MagSensor: public BaseSensor
 
     int read()
     {
-      if(!_mag || !_model.magActive() || !_model.state.magTimer.check()) return 0;
+      if(!_mag || !_model.magActive()) return 0;
+      if(!_pending && !_model.state.magTimer.check()) return 0;
 
       Stats::Measure measure(_model.state.stats, COUNTER_MAG_READ);
-      _mag->readMag(_model.state.magRaw);
+      int status = _mag->readMagAsync(_model.state.magRaw);
+      _pending = status == 0;
 
-      return 1;
+      return status > 0;
     }
 
     int filter()
     {
-      if(!_mag || !_model.magActive() || !_model.state.magTimer.check()) return 0;
+      if(!_mag || !_model.magActive()) return 0;
 
       Stats::Measure measure(_model.state.stats, COUNTER_MAG_FILTER);
 
-      align(_model.state.magRaw, _model.config.magAlign);
-      _model.state.mag = _mag->convert(_model.state.magRaw);
+      // aligned copy, raw sample stays untouched
+      VectorInt16 raw = _model.state.magRaw;
+      align(raw, _model.config.magAlign);
+      _model.state.mag = _mag->convert(raw);
 
       for(size_t i = 0; i < 3; i++)
       {
@@ -79,8 +88,11 @@ class MagSensor: public BaseSensor
         case CALIBRATION_IDLE:
           if(_model.state.magCalibrationValid)
           {
-            _model.state.mag -= _model.state.magCalibrationOffset;
-            _model.state.mag *= _model.state.magCalibrationScale;
+            const VectorFloat& s = _model.state.magCalibrationScale;
+            const VectorFloat& c = _model.state.magCalibrationCross;
+            VectorFloat m = _model.state.mag;
+            m -= _model.state.magCalibrationOffset;
+            _model.state.mag = VectorFloat(s.x * m.x + c.x * m.y + c.y * m.z, c.x * m.x + s.y * m.y + c.z * m.z, c.y * m.x + c.z * m.y + s.z * m.z);
           }
           break;
         case CALIBRATION_START:
@@ -109,60 +121,90 @@ class MagSensor: public BaseSensor
 
     void resetCalibration()
     {
-      _model.state.magCalibrationMin = VectorFloat();
-      _model.state.magCalibrationMax = VectorFloat();
+      _fit.reset();
+      _fitValid = false;
+      _sectors = 0;
+      _rejected = 0;
+      _model.state.magCalibrationCoverage = 0;
+      _model.state.magCalibrationError = 0;
+      _model.state.magCalibrationOutliers = 0;
       _model.state.magCalibrationValid = false;
     }
 
     void updateCalibration()
     {
-      for(int i = 0; i < 3; i++)
+      const VectorFloat& mag = _model.state.mag;
+
+      // reject spikes against previous sample and, once available, samples far from current fit
+      // early fit from partial data may be wrong, so rejecting stops after a second in a row
+      VectorFloat corrected;
+      VectorFloat jump = mag;
+      jump -= _lastSample;
+      const float range = _fitValid ? _fitResult.radius : _lastSample.getMagnitude();
+      bool outlier = _fit.count() > 0 && jump.getMagnitude() > ESPFC_MAG_CALIB_OUTLIER * range;
+      _lastSample = mag;
+      if(_fitValid)
       {
-        if(_model.state.mag[i] < _model.state.magCalibrationMin[i]) _model.state.magCalibrationMin.set(i, _model.state.mag[i]);
-        if(_model.state.mag[i] > _model.state.magCalibrationMax[i]) _model.state.magCalibrationMax.set(i, _model.state.mag[i]);
+        corrected = Math::EllipsoidFit::apply(_fitResult, mag);
+        outlier |= std::abs(corrected.getMagnitude() - _fitResult.radius) > ESPFC_MAG_CALIB_OUTLIER * _fitResult.radius;
       }
-    }
-
-    void applyCalibration()
-    {
-      const float EPSILON = 0.001f;
+      if(outlier && _rejected < _model.state.magTimer.rate)
+      {
+        _model.state.magCalibrationOutliers++;
+        _rejected++;
+        return;
+      }
+      _rejected = 0;
 
-      // verify calibration data and find biggest range
-      float maxRange = -1;
-      for(int i = 0; i < 3; i++)
+      if(_fitValid)
       {
-        if(_model.state.magCalibrationMin[i] > -EPSILON) return;
-        if(_model.state.magCalibrationMax[i] <  EPSILON) return;
-        if((_model.state.magCalibrationMax[i] - _model.state.magCalibrationMin[i]) > maxRange)
-        {
-          maxRange = _model.state.magCalibrationMax[i] - _model.state.magCalibrationMin[i];
-        }
+        int sector = Math::EllipsoidFit::sector(corrected);
+        if(sector >= 0) _sectors |= 1ul << sector;
       }
+      _fit.update(mag);
 
-      // probably incomplete data, must be positive
-      if(maxRange <= 0) return;
+      // refit once per second, solve is cheap but not needed per sample
+      if(_fit.count() % _model.state.magTimer.rate != 0) return;
 
-      VectorFloat scale(1.f, 1.f, 1.f);
-      VectorFloat offset(0.f, 0.f, 0.f);
+      Math::EllipsoidFit::Result result;
+      if(!_fit.solve(result)) return;
 
-      for (int i = 0; i < 3; i++)
-      {
-        const float range = (_model.state.magCalibrationMax[i] - _model.state.magCalibrationMin[i]);
-        const float bias  = (_model.state.magCalibrationMax[i] + _model.state.magCalibrationMin[i]) * 0.5f;
+      // directions are relative to center, start over if it moved
+      VectorFloat shift = result.offset;
+      shift -= _fitResult.offset;
+      if(!_fitValid || shift.getMagnitude() > 0.1f * result.radius) _sectors = 0;
+
+      _fitResult = result;
+      _fitValid = true;
+      _model.state.magCalibrationError = result.error;
+      _model.state.magCalibrationCoverage = __builtin_popcount(_sectors);
 
-        if(abs(range) < EPSILON) return;    // incomplete data
-        
-        scale.set(i, maxRange / range);     // makes everything the same range
-        offset.set(i, bias);                // level bias
+      if(_model.state.magCalibrationCoverage >= ESPFC_MAG_CALIB_COVERAGE && result.error < ESPFC_MAG_CALIB_ERROR)
+      {
+        _model.state.magCalibrationState = CALIBRATION_APPLY;
       }
+    }
 
-      _model.state.magCalibrationScale = scale;
-      _model.state.magCalibrationOffset = offset;
+    void applyCalibration()
+    {
+      // keep previous calibration if fit failed
       _model.state.magCalibrationValid = true;
+      if(!_fitValid) return;
+
+      _model.state.magCalibrationOffset = _fitResult.offset;
+      _model.state.magCalibrationScale = _fitResult.scale;
+      _model.state.magCalibrationCross = _fitResult.cross;
     }
 
     Model& _model;
     Device::MagDevice * _mag;
+    bool _pending;
+    Math::EllipsoidFit _fit;
+    Math::EllipsoidFit::Result _fitResult;
+    bool _fitValid;
+    uint32_t _sectors;
+    uint32_t _rejected;
+    VectorFloat _lastSample;
 };
 
 }
@@ -3,8 +3,19 @@
 
 #include "Model.h"
 #include "BaseSensor.h"
+#include "Filter.h"
 #include <algorithm>
 
+#define ESPFC_ADC_SAMPLE_RATE 400  // single conversion per call, channels interleaved
+#define ESPFC_ADC_OVERSAMPLING 8   // conversions averaged per value
+#define ESPFC_VBAT_SAG_ALPHA 0.02f // resistance estimator smoothing, per voltage update
+#define ESPFC_VBAT_SAG_MIN_VAR 1.f // min current variance to update resistance [A^2]
+#define ESPFC_VBAT_SAG_MAX_R 0.5f  // [Ohm]
+
+#ifndef ESPFC_ADC_SCALE
+#define ESPFC_ADC_SCALE (3300.f / 4096) // [mV/LSB]
+#endif
+
 namespace Espfc {
 
 namespace Sensor {
@@ -12,56 +23,166 @@ namespace Sensor {
 class VoltageSensor: public BaseSensor
 {
   public:
-    VoltageSensor(Model& model): _model(model) {}
+    enum State {
+      VBAT,
+      IBAT,
+    };
+
+    VoltageSensor(Model& model): _model(model), _state(VBAT), _vbatSum(0), _vbatCount(0), _ibatSum(0), _ibatCount(0), _ibatLast(0),
+      _meanI(0), _meanV(0), _covIV(0), _varI(0) {}
 
     int begin()
     {
-      _model.state.battery.timer.setRate(20);
-      _model.state.battery.samples = 40;
+      BatteryState& b = _model.state.battery;
+      b.timer.setRate(ESPFC_ADC_SAMPLE_RATE);
+      b.samples = 50;
+      b.vbat = b.vbatCompensated = b.current = b.mahDrawn = b.resistance = 0;
+
+      // channels share sample rate
+      const int channels = (vbatActive() ? 1 : 0) + (ibatActive() ? 1 : 0);
+      const int rate = ESPFC_ADC_SAMPLE_RATE / ESPFC_ADC_OVERSAMPLING / std::max(channels, 1);
+      _vbatFilter.begin(FilterConfig(FILTER_PT1, 5), rate);
+      _ibatFilter.begin(FilterConfig(FILTER_PT1, 5), rate);
 
       return 1;
     }
 
+    // one conversion per call, keeps each call short and spreads adc work over slots
     int update()
     {
-      if(_model.config.vbatSource != 1 || _model.config.pin[PIN_INPUT_ADC_0] == -1)
+      if(!vbatActive() && !ibatActive()) return 0;
+      if(!_model.state.battery.timer.check()) return 0;
+
+      switch(_state)
       {
-        return 0;
+        case VBAT:
+          _state = IBAT;
+          if(vbatActive()) return sampleVoltage();
+          return sampleCurrent();
+        case IBAT:
+          _state = VBAT;
+          if(ibatActive()) return sampleCurrent();
+          return sampleVoltage();
       }
 
-      if(!_model.state.battery.timer.check()) return 0;
+      return 0;
+    }
+
+  private:
+    bool vbatActive() const
+    {
+      return _model.config.vbatSource == 1 && _model.config.pin[PIN_INPUT_ADC_0] != -1;
+    }
+
+    bool ibatActive() const
+    {
+#ifdef ESPFC_ADC_1
+      return _model.config.ibatSource == 1 && _model.config.pin[PIN_INPUT_ADC_1] != -1;
+#else
+      return false;
+#endif
+    }
+
+    // returns 1 when new value is available
+    int sampleVoltage()
+    {
+      if(!vbatActive()) return 0;
+
+      _vbatSum += analogRead(_model.config.pin[PIN_INPUT_ADC_0]);
+      if(++_vbatCount < ESPFC_ADC_OVERSAMPLING) return 0;
+
+      BatteryState& b = _model.state.battery;
+      b.rawVoltage = _vbatSum / ESPFC_ADC_OVERSAMPLING;
+
+      // vbatScale / 10 * resMult / resDiv gives 0.1V per lsb
+      const float scale = (float)_model.config.vbatScale * _model.config.vbatResMult / (100.f * _model.config.vbatResDiv * ESPFC_ADC_OVERSAMPLING);
+      b.vbat = _vbatFilter.update(_vbatSum * scale);
+      b.voltage = (uint8_t)constrain(lrintf(b.vbat * 10.f), 0l, 255l);
+      _vbatSum = 0;
+      _vbatCount = 0;
 
-      // wemos d1 mini has divider 3.2:1 (220k:100k)
-      // additionaly I've used divider 5.7:1 (4k7:1k)
-      // total should equals ~18.24:1, 73:4 resDiv:resMult should be ideal,
-      // but ~52:1 is real, did I miss something?
-      const float alpha = 0.33f;
-      float val = _model.state.battery.rawVoltage = analogRead(_model.config.pin[PIN_INPUT_ADC_0]);
-      val *= (int)_model.config.vbatScale;
-      val /= 10.f;
-      val *= _model.config.vbatResMult;
-      val /= _model.config.vbatResDiv;
-      val = constrain(val, 0.f, 255.f);
-      val = (val * alpha + _model.state.battery.voltage * (1.f - alpha)); // smooth
-      _model.state.battery.voltage = (uint8_t)lrintf(val);
+      updateSag();
 
       // cell count detection
-      if(_model.state.battery.samples > 0)
+      if(b.samples > 0)
       {
-        _model.state.battery.cells = ((int)_model.state.battery.voltage + 40) / 42;  // round
-        _model.state.battery.samples--;
+        b.cells = ((int)b.voltage + 40) / 42;  // round
+        b.samples--;
       }
-      _model.state.battery.cellVoltage = _model.state.battery.voltage / constrain(_model.state.battery.cells, 1, 6);
+      b.cellVoltage = (uint8_t)constrain(lrintf(b.vbatCompensated * 10.f / constrain(b.cells, 1, 6)), 0l, 255l);
 
       return 1;
     }
 
-  private:
+    int sampleCurrent()
+    {
+      if(!ibatActive()) return 0;
+
+#ifdef ESPFC_ADC_1
+      _ibatSum += analogRead(_model.config.pin[PIN_INPUT_ADC_1]);
+#endif
+      if(++_ibatCount < ESPFC_ADC_OVERSAMPLING) return 0;
+
+      BatteryState& b = _model.state.battery;
+      b.rawCurrent = _ibatSum / ESPFC_ADC_OVERSAMPLING;
+
+      // ibatScale in 0.1mV/A, ibatOffset in mV
+      const float mv = _ibatSum * (ESPFC_ADC_SCALE / ESPFC_ADC_OVERSAMPLING) - _model.config.ibatOffset;
+      const float scale = _model.config.ibatScale ? 10.f / _model.config.ibatScale : 0.f;
+      b.current = _ibatFilter.update(mv * scale);
+      _ibatSum = 0;
+      _ibatCount = 0;
+
+      // mAh = A * s / 3.6
+      const uint32_t now = b.timer.last;
+      if(_ibatLast) b.mahDrawn += std::max(b.current, 0.f) * (now - _ibatLast) * (0.000001f / 3.6f);
+      _ibatLast = now;
+
+      return 1;
+    }
+
+    // internal resistance from slope of voltage over current, exponentially weighted
+    void updateSag()
+    {
+      BatteryState& b = _model.state.battery;
+      if(!ibatActive())
+      {
+        b.vbatCompensated = b.vbat;
+        return;
+      }
+
+      const float a = ESPFC_VBAT_SAG_ALPHA;
+      _meanI += (b.current - _meanI) * a;
+      _meanV += (b.vbat - _meanV) * a;
+      const float di = b.current - _meanI;
+      const float dv = b.vbat - _meanV;
+      _covIV += (di * dv - _covIV) * a;
+      _varI += (di * di - _varI) * a;
+
+      if(_varI > ESPFC_VBAT_SAG_MIN_VAR)
+      {
+        b.resistance = constrain(-_covIV / _varI, 0.f, ESPFC_VBAT_SAG_MAX_R);
+      }
+      b.vbatCompensated = b.vbat + std::max(b.current, 0.f) * b.resistance;
+    }
+
     Model& _model;
+    State _state;
+    int32_t _vbatSum;
+    int32_t _vbatCount;
+    int32_t _ibatSum;
+    int32_t _ibatCount;
+    uint32_t _ibatLast;
+    float _meanI;
+    float _meanV;
+    float _covIV;
+    float _varI;
+    Filter _vbatFilter;
+    Filter _ibatFilter;
 };
 
 }
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -5,6 +5,7 @@
 #include "Model.h"
 #include "Filter.h"
 #include "Fusion.h"
+#include "AltitudeEstimator.h"
 #include "Hardware.h"
 #include "Sensor/GyroSensor.h"
 #include "Sensor/AccelSensor.h"
@@ -17,7 +18,7 @@ namespace Espfc {
 class SensorManager
 {
   public:
-    SensorManager(Model& model): _model(model), _gyro(model), _accel(model), _mag(model), _baro(model), _voltage(model), _fusion(model) {}
+    SensorManager(Model& model): _model(model), _gyro(model), _accel(model), _mag(model), _baro(model), _voltage(model), _fusion(model), _altitude(model) {}
 
     int begin()
     {
@@ -27,6 +28,7 @@ class SensorManager
       _baro.begin();
       _voltage.begin();
       _fusion.begin();
+      _altitude.begin();
       
       return 1;
     }
@@ -50,10 +52,14 @@ class SensorManager
         case EVENT_MAG_READ:
           _mag.filter();
           return 1;
+        case EVENT_BARO_READ:
+          _altitude.correct();
+          return 1;
         case EVENT_SENSOR_READ:
           if(_model.state.imuUpdate)
           {
             _fusion.update();
+            _altitude.update();
             _model.state.imuUpdate = false;
           }
           _model.state.appQueue.send(Event(EVENT_IMU_UPDATED));
@@ -80,22 +86,22 @@ class SensorManager
         _model.state.appQueue.send(Event(EVENT_ACCEL_READ));
       }
 
-      if (!status)
+      if(!status)
       {
         status = _mag.read();
-      }
-      if(status)
-      {
-        _model.state.appQueue.send(Event(EVENT_MAG_READ));
+        if(status)
+        {
+          _model.state.appQueue.send(Event(EVENT_MAG_READ));
+        }
       }
 
       if(!status)
       {
         status = _baro.update();
-      }
-      if(status)
-      {
-        _model.state.appQueue.send(Event(EVENT_BARO_READ));
+        if(status)
+        {
+          _model.state.appQueue.send(Event(EVENT_BARO_READ));
+        }
       }
 
       if(!status)
@@ -138,11 +144,16 @@ class SensorManager
       if(status)
       {
         _fusion.update();
+        _altitude.update();
       }
 
       if(!status)
       {
         status = _baro.update();
+        if(status)
+        {
+          _altitude.correct();
+        }
       }
 
       if(!status)
@@ -160,6 +171,7 @@ class SensorManager
     Sensor::BaroSensor _baro;
     Sensor::VoltageSensor _voltage;
     Fusion _fusion;
+    AltitudeEstimator _altitude;
 };
 
 }
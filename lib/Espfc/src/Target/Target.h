@@ -16,7 +16,9 @@
 
 #include "Queue.h"
 
-#if defined(ESPFC_I2C_0)
+#if defined(UNIT_TEST)
+  // buses are emulated by Device::BusMock
+#elif defined(ESPFC_I2C_0)
   #if defined(ESPFC_I2C_0_SOFT)
     #include "EspWire.h"
     #define WireClass EspTwoWire
@@ -31,7 +33,7 @@
   #endif
 #endif
 
-#if defined(ESPFC_SPI_0)
+#if defined(ESPFC_SPI_0) && !defined(UNIT_TEST)
   #include <SPI.h>
   #if !defined(ESPFC_SPI_0_DEV)
     #define ESPFC_SPI_0_DEV SPI
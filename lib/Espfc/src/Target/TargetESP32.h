@@ -72,6 +72,7 @@
 
 #define ESPFC_ADC_1
 #define ESPFC_ADC_1_PIN 39
+#define ESPFC_ADC_SCALE (3300.f / 4096) // [mV/LSB]
 
 #define ESPFC_FEATURE_MASK (FEATURE_RX_SERIAL | FEATURE_DYNAMIC_FILTER)
 
@@ -46,6 +46,7 @@
 
 #define ESPFC_ADC_0
 #define ESPFC_ADC_0_PIN 17   // A0
+#define ESPFC_ADC_SCALE (1000.f / 1024) // [mV/LSB]
 
 #define ESPFC_FEATURE_MASK (FEATURE_RX_PPM | FEATURE_DYNAMIC_FILTER)
 
@@ -62,6 +62,7 @@
 
 #define ESPFC_ADC_1
 #define ESPFC_ADC_1_PIN 27
+#define ESPFC_ADC_SCALE (3300.f / 1024) // [mV/LSB]
 
 #define ESPFC_FEATURE_MASK (FEATURE_RX_SERIAL | FEATURE_DYNAMIC_FILTER)
 
@@ -9,8 +9,71 @@
 #define ESPFC_OUTPUT_2 3
 #define ESPFC_OUTPUT_3 4
 
+// buses are emulated by Device::BusMock
+#define ESPFC_SPI_0
+#define ESPFC_SPI_0_SCK 5
+#define ESPFC_SPI_0_MOSI 6
+#define ESPFC_SPI_0_MISO 7
+#define ESPFC_SPI_CS_GYRO 8
+#define ESPFC_SPI_CS_BARO 9
+
+#define ESPFC_I2C_0
+#define ESPFC_I2C_0_SCL 10
+#define ESPFC_I2C_0_SDA 11
+
+#define ESPFC_ADC_0
+#define ESPFC_ADC_0_PIN 12
+
+#define ESPFC_ADC_1
+#define ESPFC_ADC_1_PIN 13
+
 #define ESPFC_OUTPUT_PROTOCOL ESC_PROTOCOL_DISABLED
 #define ESPFC_FEATURE_MASK (0)
 
 #define ESPFC_GUARD 1
-#define ESPFC_GYRO_DENOM_MAX 1
\ No newline at end of file
+#define ESPFC_GYRO_DENOM_MAX 1
+
+namespace Espfc {
+
+template<typename T>
+inline int targetSPIInit(T& dev, int8_t sck, int8_t mosi, int8_t miso, int8_t ss)
+{
+  return 1;
+}
+
+template<typename T>
+inline int targetI2CInit(T& dev, int8_t sda, int8_t scl, int speed)
+{
+  return 1;
+}
+
+inline uint32_t getBoardId0()
+{
+  return 0;
+}
+
+inline uint32_t getBoardId1()
+{
+  return 0;
+}
+
+inline uint32_t getBoardId2()
+{
+  return 0;
+}
+
+inline void targetReset()
+{
+}
+
+inline uint32_t targetCpuFreq()
+{
+  return 0;
+}
+
+inline uint32_t targetFreeHeap()
+{
+  return 0;
+}
+
+};
@@ -7,6 +7,9 @@
 #define USE_DYN_LPF
 #define USE_D_MIN
 #define USE_DYN_NOTCH_FILTER
+#define USE_ITERM_RELAX
+#define USE_FEEDFORWARD
+#define USE_BATTERY_VOLTAGE_SAG_COMPENSATION
 
 #include <stdbool.h>
 #include <stdint.h>
@@ -634,6 +637,16 @@ typedef struct pidProfile_s {
     uint8_t d_min[XYZ_AXIS_COUNT];          // Minimum D value on each axis
     uint8_t d_min_gain;                     // Gain factor for amount of gyro / setpoint activity required to boost D
     uint8_t d_min_advance;                  // Percentage multiplier for setpoint input to boost algorithm
+    uint8_t iterm_relax;                    // Enable iterm suppression during stick input
+    uint8_t iterm_relax_type;               // Specifies type of relax algorithm
+    uint8_t iterm_relax_cutoff;             // This cutoff frequency specifies a low pass filter which predicts average response of the quad to setpoint
+    uint8_t feedforward_transition;         // Feedforward attenuation around centre sticks
+    uint8_t feedforward_averaging;          // Number of packets to average when averaging is on
+    uint8_t feedforward_smooth_factor;      // Amount of lowpass type smoothing for feedforward steps
+    uint8_t feedforward_jitter_factor;      // Number of RC steps below which to attenuate feedforward
+    uint8_t feedforward_boost;              // amount of setpoint acceleration to add to feedforward, 10 means 100% added
+    uint8_t feedforward_max_rate_limit;     // Maximum setpoint rate percentage for feedforward
+    uint8_t vbat_sag_compensation;          // Reduce motor output by this percentage of the maximum compensation amount
 } pidProfile_t;
 
 PG_DECLARE_ARRAY(pidProfile_t, MAX_PROFILE_COUNT, pidProfiles);
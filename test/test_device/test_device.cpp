@@ -0,0 +1,691 @@
+#include <unity.h>
+#include <ArduinoFake.h>
+#include "Model.h"
+#include "Hardware.h"
+#include "SensorManager.h"
+#include "Sensor/GyroSensor.h"
+#include "Sensor/AccelSensor.h"
+#include "Sensor/MagSensor.h"
+#include "Sensor/BaroSensor.h"
+#include "Sensor/VoltageSensor.h"
+#include "Device/BusMock.h"
+#include "Device/GyroMPU6050.h"
+#include "Device/MagHMC5338L.h"
+#include "Device/MagAK8963.h"
+#include "Device/BaroBMP280.h"
+#include "Device/BaroBMP085.h"
+
+using namespace fakeit;
+using namespace Espfc;
+using namespace Espfc::Device;
+
+void setUp(void)
+{
+  ArduinoFakeReset();
+  When(Method(ArduinoFake(), micros)).AlwaysReturn(1000);
+  When(Method(ArduinoFake(), millis)).AlwaysReturn(1);
+  When(Method(ArduinoFake(), delay)).AlwaysReturn();
+  When(Method(ArduinoFake(), pinMode)).AlwaysReturn();
+  When(Method(ArduinoFake(), digitalWrite)).AlwaysReturn();
+}
+
+void test_bus_mock_read_write()
+{
+  BusMock bus;
+  uint8_t data[2] = { 0x12, 0x34 };
+  uint8_t res[2] = { 0, 0 };
+
+  bus.addSlave(0x10);
+  TEST_ASSERT_TRUE(bus.write(0x10, 0x20, 2, data));
+  TEST_ASSERT_EQUAL_INT8(2, bus.read(0x10, 0x20, 2, res));
+
+  TEST_ASSERT_EQUAL_UINT8(0x12, res[0]);
+  TEST_ASSERT_EQUAL_UINT8(0x34, res[1]);
+  TEST_ASSERT_EQUAL_UINT8(0x34, bus.getRegister(0x10, 0x21));
+  TEST_ASSERT_EQUAL_UINT32(2, bus.transactionCount);
+  TEST_ASSERT_EQUAL_UINT32(6, bus.byteCount);
+  TEST_ASSERT_EQUAL_UINT32(2, bus.getTransactions().size());
+  TEST_ASSERT_TRUE(bus.getTransactions()[0].write);
+  TEST_ASSERT_FALSE(bus.getTransactions()[1].write);
+  TEST_ASSERT_EQUAL_UINT32(1000, bus.getTransactions()[1].time);
+}
+
+void test_bus_mock_missing_slave()
+{
+  BusMock bus;
+  uint8_t res = 0x55;
+  int errors = 0;
+  bus.onError = [&errors]() { errors++; };
+
+  TEST_ASSERT_EQUAL_INT8(0, bus.read(0x10, 0x20, 1, &res));
+  TEST_ASSERT_FALSE(bus.writeByte(0x10, 0x20, 1));
+  TEST_ASSERT_EQUAL_INT(2, errors);
+  TEST_ASSERT_FALSE(bus.getTransactions()[0].ack);
+}
+
+void test_bus_mock_sample_stream()
+{
+  BusMock bus;
+  uint8_t res[6];
+
+  bus.pushSample(0x68, 0x43, 1, 2, 3);
+  bus.pushSample(0x68, 0x43, -1, 256, 0);
+  TEST_ASSERT_EQUAL_UINT32(2, bus.pendingSamples(0x68, 0x43));
+
+  bus.read(0x68, 0x43, 6, res);
+  TEST_ASSERT_EQUAL_UINT8(0, res[0]);
+  TEST_ASSERT_EQUAL_UINT8(1, res[1]);
+  TEST_ASSERT_EQUAL_UINT8(3, res[5]);
+
+  bus.read(0x68, 0x43, 6, res);
+  TEST_ASSERT_EQUAL_UINT8(0xff, res[0]);
+  TEST_ASSERT_EQUAL_UINT8(0xff, res[1]);
+  TEST_ASSERT_EQUAL_UINT8(0x01, res[2]);
+
+  // last sample is held
+  bus.read(0x68, 0x43, 6, res);
+  TEST_ASSERT_EQUAL_UINT8(0x01, res[2]);
+  TEST_ASSERT_EQUAL_UINT32(0, bus.pendingSamples(0x68, 0x43));
+}
+
+void test_bus_mock_replay()
+{
+  BusMock rec;
+  uint8_t res[2];
+  rec.pushSample(0x10, 0x01, { 1, 2 });
+  rec.pushSample(0x10, 0x01, { 3, 4 });
+  rec.read(0x10, 0x01, 2, res);
+  rec.read(0x10, 0x01, 2, res);
+
+  BusMock bus;
+  bus.replay(rec.getTransactions());
+  bus.read(0x10, 0x01, 2, res);
+  TEST_ASSERT_EQUAL_UINT8(1, res[0]);
+  bus.read(0x10, 0x01, 2, res);
+  TEST_ASSERT_EQUAL_UINT8(4, res[1]);
+}
+
+void test_gyro_mpu6050_begin_read()
+{
+  BusMock bus;
+  GyroMPU6050 gyro;
+  VectorInt16 v;
+
+  TEST_ASSERT_FALSE(gyro.begin(&bus));
+
+  bus.addGyro(GYRO_MPU6050, 0x68);
+  TEST_ASSERT_TRUE(gyro.begin(&bus));
+
+  bus.pushSample(0x68, MPU6050_RA_GYRO_XOUT_H, 100, -200, 300);
+  bus.reset();
+  gyro.readGyro(v);
+
+  TEST_ASSERT_EQUAL_INT16(100, v.x);
+  TEST_ASSERT_EQUAL_INT16(-200, v.y);
+  TEST_ASSERT_EQUAL_INT16(300, v.z);
+  TEST_ASSERT_EQUAL_UINT32(1, bus.transactionCount);
+  TEST_ASSERT_EQUAL_UINT32(7, bus.byteCount);
+}
+
+void test_mag_hmc5883_read_async()
+{
+  BusMock bus;
+  MagHMC5338L mag;
+  VectorInt16 v;
+  BusTransfer other;
+  uint8_t res;
+
+  bus.addMag(MAG_HMC5883, 0x1E);
+  TEST_ASSERT_TRUE(mag.begin(&bus));
+
+  bus.setAsync(true);
+  bus.pushSample(0x1E, HMC5883L_RA_DATAX_H, 10, 20, 30); // x, z, y order
+  other.prepare(0x1E, HMC5883L_RA_ID_A, 1, &res, false);
+  bus.submit(other);
+
+  TEST_ASSERT_EQUAL_INT(0, mag.readMagAsync(v));
+  TEST_ASSERT_EQUAL_INT(BUS_TRANSFER_DONE, other.state);
+  TEST_ASSERT_EQUAL_INT(1, mag.readMagAsync(v));
+
+  TEST_ASSERT_EQUAL_INT16(10, v.x);
+  TEST_ASSERT_EQUAL_INT16(30, v.y);
+  TEST_ASSERT_EQUAL_INT16(20, v.z);
+}
+
+void test_mag_ak8963_via_mpu9250()
+{
+  BusMock bus;
+  MagAK8963 mag;
+  VectorInt16 v;
+
+  bus.addGyro(GYRO_MPU9250, 0x68);
+  bus.addMag(MAG_AK8963, 0x68);
+  TEST_ASSERT_TRUE(mag.begin(&bus));
+
+  bus.pushSample(0x0C, AK8963_HXL, 100, 200, 300, false);
+  mag.readMag(v);
+
+  // CW90_FLIP
+  TEST_ASSERT_EQUAL_INT16(200, v.x);
+  TEST_ASSERT_EQUAL_INT16(100, v.y);
+  TEST_ASSERT_EQUAL_INT16(-300, v.z);
+}
+
+void test_baro_bmp280_begin_read()
+{
+  BusMock bus;
+  BaroBMP280 baro;
+
+  bus.addBaro(BARO_BMP280, 0x77);
+  TEST_ASSERT_TRUE(baro.begin(&bus));
+
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 25.08f, baro.readTemperature());
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 100653.27f, baro.readPressure());
+}
+
+class BaroBMP280Int32: public BaroBMP280
+{
+  public:
+    uint32_t pressure32(int32_t adc) { return compensatePressure32(adc); }
+    uint32_t pressure64(int32_t adc) { return compensatePressure64(adc); }
+};
+
+void test_baro_bmp280_integer_compensation()
+{
+  BusMock bus;
+  BaroBMP280Int32 baro;
+
+  bus.addBaro(BARO_BMP280, 0x77);
+  TEST_ASSERT_TRUE(baro.begin(&bus));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 25.08f, baro.readTemperature());
+
+  // datasheet example, adc_P = 415148
+  TEST_ASSERT_UINT32_WITHIN(12, 25767237, baro.pressure64(415148 << 4)); // 100653.27Pa in Q24.8
+  TEST_ASSERT_EQUAL_UINT32(100656, baro.pressure32(415148 << 4)); // datasheet 32 bit result
+}
+
+void test_baro_bmp085_compensation()
+{
+  BusMock bus;
+  BaroBMP085 baro;
+
+  bus.addBaro(BARO_BMP085, 0x77);
+  TEST_ASSERT_TRUE(baro.begin(&bus));
+
+  // datasheet example, UT = 27898, UP = 23843 at oss 0
+  const uint8_t ut[] = { 0x6C, 0xFA };
+  bus.setRegisters(0x77, 0xF6, ut, sizeof(ut));
+  baro.setMode(BARO_MODE_TEMP);
+  float t = 0;
+  for(size_t i = 0; i < 16; i++) t = baro.readTemperature(); // filtered over last samples
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 15.0f, t);
+
+  const uint8_t up[] = { 0x5D, 0x23, 0x00 };
+  bus.setRegisters(0x77, 0xF6, up, sizeof(up));
+  baro.setMode(BARO_MODE_PRESS);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 69964.f, baro.readPressure());
+}
+
+void test_baro_altitude_table()
+{
+  BaroBMP280 baro;
+  const float p0 = 101325.f;
+  for(float p = 40000.f; p < 115000.f; p += 37.f)
+  {
+    const float expected = 44330.f * (1.f - powf(p / p0, 0.1903f));
+    TEST_ASSERT_FLOAT_WITHIN(0.02f, expected, baro.getAltitude(p));
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.f, baro.getAltitude(p0));
+  TEST_ASSERT_FLOAT_WITHIN(0.02f, 44330.f * (1.f - powf(99000.f / 100000.f, 0.1903f)), baro.getAltitude(99000.f, 100000.f));
+}
+
+void test_baro_sensor_continuous_slots()
+{
+  BusMock bus;
+  BaroBMP280 baro;
+  bus.addBaro(BARO_BMP280, 0x77);
+  TEST_ASSERT_TRUE(baro.begin(&bus));
+
+  Model model;
+  model.config.baroDev = BARO_BMP280;
+  model.state.baroDev = &baro;
+  model.state.baroPresent = true;
+  model.state.gyroTimer.setRate(2000);
+  model.state.loopTimer.setRate(2000, 2);
+
+  Sensor::BaroSensor sensor(model);
+  TEST_ASSERT_EQUAL_INT(1, sensor.begin());
+  bus.reset();
+
+  // 500us gyro slots, 9.3ms conversion rounded up to 20 slots
+  uint32_t last = 0;
+  size_t reads = 0;
+  for(uint32_t i = 1; i <= 200; i++)
+  {
+    const uint32_t now = 1000 + i * 500;
+    When(Method(ArduinoFake(), micros)).AlwaysReturn(now + 100);
+    model.state.gyroTimer.update(now);
+    if(!sensor.update()) continue;
+
+    TEST_ASSERT_EQUAL_UINT32(1, model.state.gyroTimer.iteration % 2); // never with loop iteration
+    if(reads > 0) TEST_ASSERT_EQUAL_UINT32(20, model.state.gyroTimer.iteration - last);
+    last = model.state.gyroTimer.iteration;
+    reads++;
+  }
+
+  TEST_ASSERT_EQUAL_INT(100, model.state.baroRate);
+  TEST_ASSERT_EQUAL_UINT32(9, reads);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 25.08f, model.state.baroTemperatureRaw);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 100653.27f, model.state.baroPressureRaw);
+
+  // results only read out, no conversion triggers
+  for(const auto& t: bus.getTransactions())
+  {
+    TEST_ASSERT_FALSE(t.write);
+    TEST_ASSERT_EQUAL_UINT8(0xF7, t.regAddr);
+    TEST_ASSERT_EQUAL_UINT32(6, t.data.size());
+  }
+  TEST_ASSERT_EQUAL_UINT32(9, bus.getTransactions().size());
+}
+
+void test_hardware_detect_i2c()
+{
+  i2cBus.addGyro(GYRO_MPU6050, 0x68);
+  i2cBus.addMag(MAG_HMC5883, 0x1E);
+  i2cBus.addBaro(BARO_BMP280, 0x77);
+
+  Model model;
+  model.config.magDev = MAG_DEFAULT;
+  model.config.baroDev = BARO_DEFAULT;
+  Hardware hardware(model);
+  hardware.begin();
+
+  TEST_ASSERT_NOT_NULL(model.state.gyroDev);
+  TEST_ASSERT_EQUAL_INT(GYRO_MPU6050, model.state.gyroDev->getType());
+  TEST_ASSERT_TRUE(model.state.gyroPresent);
+  TEST_ASSERT_NOT_NULL(model.state.magDev);
+  TEST_ASSERT_EQUAL_INT(MAG_HMC5883, model.state.magDev->getType());
+  TEST_ASSERT_NOT_NULL(model.state.baroDev);
+  TEST_ASSERT_EQUAL_INT(BARO_BMP280, model.state.baroDev->getType());
+
+  i2cBus.removeSlave(0x68);
+  i2cBus.removeSlave(0x1E);
+  i2cBus.removeSlave(0x77);
+}
+
+void test_hardware_detect_spi()
+{
+  spiBus.addGyro(GYRO_ICM20602, ESPFC_SPI_CS_GYRO);
+
+  Model model;
+  model.config.magDev = MAG_DEFAULT;
+  model.config.baroDev = BARO_DEFAULT;
+  Hardware hardware(model);
+  hardware.begin();
+
+  TEST_ASSERT_NOT_NULL(model.state.gyroDev);
+  TEST_ASSERT_EQUAL_INT(GYRO_ICM20602, model.state.gyroDev->getType());
+  TEST_ASSERT_EQUAL_INT(BUS_SPI, model.state.gyroDev->getBus()->getType());
+  TEST_ASSERT_NULL(model.state.magDev);
+  TEST_ASSERT_NULL(model.state.baroDev);
+
+  spiBus.removeSlave(ESPFC_SPI_CS_GYRO);
+}
+
+void test_sensor_manager_gyro_transactions()
+{
+  i2cBus.addGyro(GYRO_MPU6050, 0x68);
+
+  Model model;
+  Hardware hardware(model);
+  hardware.begin();
+  model.begin();
+
+  SensorManager sensor(model);
+  sensor.begin();
+
+  i2cBus.reset();
+  i2cBus.pushSample(0x68, MPU6050_RA_GYRO_XOUT_H, 0, 0, 16);
+  sensor.update();
+
+  TEST_ASSERT_EQUAL_UINT32(1, i2cBus.transactionCount);
+  TEST_ASSERT_EQUAL_UINT32(7, i2cBus.byteCount);
+  TEST_ASSERT_EQUAL_INT16(16, model.state.gyroRaw.z);
+
+  i2cBus.removeSlave(0x68);
+}
+
+void test_hardware_detect_dual_gyro()
+{
+  spiBus.addGyro(GYRO_ICM20602, ESPFC_SPI_CS_GYRO);
+  i2cBus.addGyro(GYRO_MPU6050, 0x68);
+
+  Model model;
+  model.config.gyroSelect = GYRO_SELECT_BOTH;
+  Hardware hardware(model);
+  hardware.begin();
+
+  TEST_ASSERT_NOT_NULL(model.state.gyroDev);
+  TEST_ASSERT_EQUAL_INT(BUS_SPI, model.state.gyroDev->getBus()->getType());
+  TEST_ASSERT_NOT_NULL(model.state.gyroDev2);
+  TEST_ASSERT_EQUAL_INT(GYRO_MPU6050, model.state.gyroDev2->getType());
+  TEST_ASSERT_EQUAL_INT(BUS_I2C, model.state.gyroDev2->getBus()->getType());
+
+  // i2c gyro limits gyro rate
+  model.begin();
+  TEST_ASSERT_EQUAL_INT32(1000, model.state.gyroRate);
+
+  spiBus.removeSlave(ESPFC_SPI_CS_GYRO);
+  i2cBus.removeSlave(0x68);
+}
+
+void test_gyro_sensor_dual_average_failover()
+{
+  i2cBus.addGyro(GYRO_MPU6050, 0x68);
+  i2cBus.addGyro(GYRO_MPU6050, 0x69);
+
+  Model model;
+  model.config.gyroSelect = GYRO_SELECT_AUTO;
+  Hardware hardware(model);
+  hardware.begin();
+  model.begin();
+  TEST_ASSERT_NOT_NULL(model.state.gyroDev2);
+
+  Sensor::GyroSensor gyro(model);
+  gyro.begin();
+
+  i2cBus.pushSample(0x68, MPU6050_RA_GYRO_XOUT_H, 100, 200, -300);
+  i2cBus.pushSample(0x69, MPU6050_RA_GYRO_XOUT_H, 300, 400, -500);
+  gyro.read();
+  TEST_ASSERT_EQUAL_UINT8(0, model.state.gyroFault);
+  TEST_ASSERT_EQUAL_INT16(200, model.state.gyroRaw.x);
+  TEST_ASSERT_EQUAL_INT16(300, model.state.gyroRaw.y);
+  TEST_ASSERT_EQUAL_INT16(-400, model.state.gyroRaw.z);
+
+  // second gyro stops responding
+  i2cBus.removeSlave(0x69);
+  i2cBus.pushSample(0x68, MPU6050_RA_GYRO_XOUT_H, 10, 20, 30);
+  gyro.read();
+  TEST_ASSERT_EQUAL_UINT8(2, model.state.gyroFault);
+  TEST_ASSERT_EQUAL_INT16(10, model.state.gyroRaw.x);
+  TEST_ASSERT_EQUAL_INT16(30, model.state.gyroRaw.z);
+
+  // first gyro output gets stuck
+  i2cBus.addGyro(GYRO_MPU6050, 0x69);
+  for(size_t i = 0; i < ESPFC_GYRO_STUCK_COUNT; i++)
+  {
+    i2cBus.pushSample(0x69, MPU6050_RA_GYRO_XOUT_H, 7 + (i & 1), 0, 0);
+    gyro.read();
+  }
+  TEST_ASSERT_EQUAL_UINT8(1, model.state.gyroFault);
+  TEST_ASSERT_EQUAL_INT16(8, model.state.gyroRaw.x);
+
+  i2cBus.removeSlave(0x68);
+  i2cBus.removeSlave(0x69);
+}
+
+void test_gyro_sensor_calibration()
+{
+  i2cBus.addGyro(GYRO_MPU6050, 0x68);
+
+  Model model;
+  Hardware hardware(model);
+  hardware.begin();
+  model.begin();
+
+  Sensor::GyroSensor gyro(model);
+  gyro.begin();
+  const int window = model.state.gyroCalibrationRate / 10;
+
+  // noisy data with bias, interrupted by motion
+  for(int i = 0; i < window / 2; i++)
+  {
+    model.state.gyroSampled = VectorFloat(0.02f + (i & 1 ? 0.004f : -0.004f), -0.01f, 0.f);
+    gyro.filter();
+  }
+  model.state.gyroSampled = VectorFloat(0.5f, 0.f, 0.f);
+  gyro.filter();
+  TEST_ASSERT_EQUAL_INT(1, model.state.gyroCalibrationRestarts);
+
+  for(int i = 0; i < window - 1; i++)
+  {
+    model.state.gyroSampled = VectorFloat(0.02f + (i & 1 ? 0.004f : -0.004f), -0.01f, 0.f);
+    gyro.filter();
+  }
+  TEST_ASSERT_EQUAL_INT(CALIBRATION_UPDATE, model.state.gyroCalibrationState);
+  TEST_ASSERT_EQUAL_INT(1, model.state.gyroBiasSamples);
+
+  model.state.gyroSampled = VectorFloat(0.02f, -0.01f, 0.f);
+  gyro.filter();
+  TEST_ASSERT_EQUAL_INT(0, model.state.gyroBiasSamples);
+
+  TEST_ASSERT_EQUAL_INT(CALIBRATION_APPLY, model.state.gyroCalibrationState);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.02f, model.state.gyroBias.x);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, -0.01f, model.state.gyroBias.y);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.f, model.state.gyroBias.z);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.004f, model.state.gyroCalibrationNoise);
+
+  i2cBus.removeSlave(0x68);
+}
+
+void test_gyro_sensor_calibration_noisy()
+{
+  i2cBus.addGyro(GYRO_MPU6050, 0x68);
+
+  Model model;
+  Hardware hardware(model);
+  hardware.begin();
+  model.begin();
+
+  Sensor::GyroSensor gyro(model);
+  gyro.begin();
+
+  // noise above threshold, full window accepted with noise reported
+  const int samples = 2 * model.state.gyroCalibrationRate + 2;
+  for(int i = 0; i < samples && model.state.gyroCalibrationState != CALIBRATION_APPLY; i++)
+  {
+    model.state.gyroSampled = VectorFloat(0.05f + (i & 1 ? 0.02f : -0.02f), -0.01f, 0.f);
+    gyro.filter();
+  }
+  TEST_ASSERT_EQUAL_INT(CALIBRATION_APPLY, model.state.gyroCalibrationState);
+  TEST_ASSERT_EQUAL_INT(0, model.state.gyroCalibrationRestarts);
+  TEST_ASSERT_FALSE(model.state.gyroCalibrationFailed);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.05f, model.state.gyroBias.x);
+  TEST_ASSERT_TRUE(model.state.gyroCalibrationNoise > ESPFC_GYRO_CALIB_NOISE);
+
+  i2cBus.removeSlave(0x68);
+}
+
+void test_gyro_sensor_calibration_rotation()
+{
+  i2cBus.addGyro(GYRO_MPU6050, 0x68);
+
+  Model model;
+  Hardware hardware(model);
+  hardware.begin();
+  model.begin();
+
+  Sensor::GyroSensor gyro(model);
+  gyro.begin();
+  model.state.gyroBias = VectorFloat(0.01f, 0.02f, 0.f);
+
+  // slow steady rotation never becomes bias, gives up and keeps stored one
+  const int samples = (ESPFC_GYRO_CALIB_TIMEOUT + 1) * model.state.gyroCalibrationRate;
+  for(int i = 0; i < samples && model.state.gyroCalibrationState != CALIBRATION_IDLE; i++)
+  {
+    model.state.gyroSampled = VectorFloat(0.3f, 0.f, 0.f);
+    gyro.filter();
+  }
+  TEST_ASSERT_EQUAL_INT(CALIBRATION_IDLE, model.state.gyroCalibrationState);
+  TEST_ASSERT_TRUE(model.state.gyroCalibrationFailed);
+  TEST_ASSERT_EQUAL_INT(0, model.state.gyroBiasSamples);
+  TEST_ASSERT_TRUE(model.state.gyroCalibrationRestarts > 0);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.01f, model.state.gyroBias.x);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.02f, model.state.gyroBias.y);
+
+  i2cBus.removeSlave(0x68);
+}
+
+void test_accel_sensor_six_point_calibration()
+{
+  i2cBus.addGyro(GYRO_MPU6050, 0x68);
+
+  Model model;
+  model.config.accelFsr = ACCEL_FS_2;
+  Hardware hardware(model);
+  hardware.begin();
+  model.begin();
+
+  Sensor::AccelSensor accel(model);
+  accel.begin();
+  model.calibrateAccel(false);
+
+  // 2g range, 16384 lsb/g, offset on x and z, scale error on y
+  const int16_t one = 16384;
+  const VectorInt16 sides[] = {
+    VectorInt16(one + 164, 0, 200), VectorInt16(-one + 164, 0, 200),
+    VectorInt16(164, one + 328, 200), VectorInt16(164, -one - 328, 200),
+    VectorInt16(164, 0, one + 200), VectorInt16(164, 0, -one + 200),
+  };
+  for(size_t side = 0; side < 6; side++)
+  {
+    for(uint32_t i = 0; i < 2 * model.state.accelTimer.rate && !(model.state.accelCalibrationPoints & (1 << side)); i++)
+    {
+      model.state.accelRaw = sides[side];
+      accel.filter();
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT8(0x3f, model.state.accelCalibrationPoints);
+  TEST_ASSERT_EQUAL_INT(CALIBRATION_APPLY, model.state.accelCalibrationState);
+
+  for(size_t i = 0; i < 100; i++)
+  {
+    model.state.accelRaw = VectorInt16(164, 0, one + 200);
+    accel.filter();
+  }
+  TEST_ASSERT_EQUAL_INT(CALIBRATION_IDLE, model.state.accelCalibrationState);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.f, model.state.accelCalibrationScale.x);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.98f, model.state.accelCalibrationScale.y);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.f, model.state.accelCalibrationScale.z);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.f, model.state.accel.x);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.f, model.state.accel.y);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, ACCEL_G, model.state.accel.z);
+
+  i2cBus.removeSlave(0x68);
+}
+
+void test_mag_sensor_ellipsoid_calibration()
+{
+  i2cBus.addGyro(GYRO_MPU6050, 0x68);
+  i2cBus.addMag(MAG_HMC5883, 0x1E);
+
+  Model model;
+  model.config.magDev = MAG_DEFAULT;
+  model.config.magFilter = FilterConfig(FILTER_NONE, 0);
+  Hardware hardware(model);
+  hardware.begin();
+  model.begin();
+
+  Sensor::MagSensor mag(model);
+  TEST_ASSERT_EQUAL_INT(1, mag.begin());
+  model.calibrateMag();
+
+  // 0.5G field rotated over sphere, soft iron stretch on x/y plane, hard iron offset, few spikes
+  const size_t n = 1500;
+  size_t i = 0;
+  for(; i < n && model.state.magCalibrationState != CALIBRATION_SAVE; i++)
+  {
+    const float z = 1.f - 2.f * (i + 0.5f) / n;
+    const float r = sqrtf(1.f - z * z);
+    const float phi = i * 0.0838f; // 20 turns, continuous path
+    const float x = r * cosf(phi), y = r * sinf(phi);
+    float spike = i % 97 == 50 ? 3.f : 1.f;
+    model.state.magRaw = VectorInt16(
+      lrintf((0.5f * (1.2f * x + 0.1f * y) * spike + 0.2f) * 1090.f),
+      lrintf((0.5f * (0.1f * x + 0.9f * y) + -0.1f) * 1090.f),
+      lrintf((0.5f * z + 0.05f) * 1090.f)
+    );
+    mag.filter();
+  }
+
+  TEST_ASSERT_TRUE(i < n); // finished early
+  TEST_ASSERT_TRUE(model.state.magCalibrationOutliers > 0);
+  TEST_ASSERT_TRUE(model.state.magCalibrationCoverage >= ESPFC_MAG_CALIB_COVERAGE);
+  TEST_ASSERT_TRUE(model.state.magCalibrationError < ESPFC_MAG_CALIB_ERROR);
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, 0.2f, model.state.magCalibrationOffset.x);
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, -0.1f, model.state.magCalibrationOffset.y);
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, 0.05f, model.state.magCalibrationOffset.z);
+  TEST_ASSERT_TRUE(model.state.magCalibrationCross.x < -0.01f);
+
+  i2cBus.removeSlave(0x68);
+  i2cBus.removeSlave(0x1E);
+}
+
+void test_voltage_sensor_current_and_sag()
+{
+  Model model;
+  model.config.vbatSource = 1;
+  model.config.vbatResDiv = 160; // 160 lsb per volt
+  model.config.ibatSource = 1;
+
+  // 4s pack, 30mOhm internal resistance, load switching between 5A and 40A every 2s
+  static float load;
+  load = 5.f;
+  When(Method(ArduinoFake(), analogRead)).AlwaysDo([](uint8_t pin) -> int {
+    if(pin == ESPFC_ADC_0_PIN) return lrintf((16.8f - load * 0.03f) * 160.f);
+    if(pin == ESPFC_ADC_1_PIN) return lrintf(load * 40.f / ESPFC_ADC_SCALE); // 40mV/A
+    return 0;
+  });
+
+  Sensor::VoltageSensor sensor(model);
+  sensor.begin();
+
+  float expectedMah = 0.f;
+  for(uint32_t now = 2500; now < 20000000; now += 2500)
+  {
+    load = (now / 2000000) % 2 ? 40.f : 5.f;
+    When(Method(ArduinoFake(), micros)).AlwaysReturn(now);
+    sensor.update();
+    expectedMah += load * 0.0025f / 3.6f;
+  }
+
+  const BatteryState& b = model.state.battery;
+  TEST_ASSERT_EQUAL_INT(4, b.cells);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 40.f, b.current);
+  TEST_ASSERT_FLOAT_WITHIN(0.02f, 15.6f, b.vbat);
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, 0.03f, b.resistance);
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 16.8f, b.vbatCompensated);
+  TEST_ASSERT_EQUAL_UINT8(42, b.cellVoltage);
+  TEST_ASSERT_FLOAT_WITHIN(expectedMah * 0.02f, expectedMah, b.mahDrawn);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_bus_mock_read_write);
+  RUN_TEST(test_bus_mock_missing_slave);
+  RUN_TEST(test_bus_mock_sample_stream);
+  RUN_TEST(test_bus_mock_replay);
+  RUN_TEST(test_gyro_mpu6050_begin_read);
+  RUN_TEST(test_mag_hmc5883_read_async);
+  RUN_TEST(test_mag_ak8963_via_mpu9250);
+  RUN_TEST(test_baro_bmp280_begin_read);
+  RUN_TEST(test_baro_bmp280_integer_compensation);
+  RUN_TEST(test_baro_bmp085_compensation);
+  RUN_TEST(test_baro_altitude_table);
+  RUN_TEST(test_baro_sensor_continuous_slots);
+  RUN_TEST(test_hardware_detect_i2c);
+  RUN_TEST(test_hardware_detect_spi);
+  RUN_TEST(test_sensor_manager_gyro_transactions);
+  RUN_TEST(test_hardware_detect_dual_gyro);
+  RUN_TEST(test_gyro_sensor_dual_average_failover);
+  RUN_TEST(test_gyro_sensor_calibration);
+  RUN_TEST(test_gyro_sensor_calibration_noisy);
+  RUN_TEST(test_gyro_sensor_calibration_rotation);
+  RUN_TEST(test_accel_sensor_six_point_calibration);
+  RUN_TEST(test_mag_sensor_ellipsoid_calibration);
+  RUN_TEST(test_voltage_sensor_current_and_sag);
+  UNITY_END();
+
+  return 0;
+}
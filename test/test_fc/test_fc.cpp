@@ -3,6 +3,7 @@
 #include "Timer.h"
 #include "Model.h"
 #include "Controller.h"
+#include "Fusion.h"
 #include "Actuator.h"
 #include "Output/Mixer.h"
 using namespace fakeit;
@@ -147,23 +148,23 @@ void test_model_inner_pid_init()
   model.config.pid[PID_YAW]   = { .P = 100u, .I = 100u, .D = 100u, .F = 100 };
   model.begin();
 
-  TEST_ASSERT_FLOAT_WITHIN(   0.1f, 1000.0f, model.state.innerPid[PID_ROLL].rate);
-  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.1835f, model.state.innerPid[PID_ROLL].Kp);
-  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.4002f, model.state.innerPid[PID_ROLL].Ki);
-  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.0030f, model.state.innerPid[PID_ROLL].Kd);
-  TEST_ASSERT_FLOAT_WITHIN(0.000001f, 0.000788f, model.state.innerPid[PID_ROLL].Kf);
-
-  TEST_ASSERT_FLOAT_WITHIN(   0.1f, 1000.0f, model.state.innerPid[PID_PITCH].rate);
-  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.1835f, model.state.innerPid[PID_PITCH].Kp);
-  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.4002f, model.state.innerPid[PID_PITCH].Ki);
-  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.0030f, model.state.innerPid[PID_PITCH].Kd);
-  TEST_ASSERT_FLOAT_WITHIN(0.000001f, 0.000788f, model.state.innerPid[PID_PITCH].Kf);
-
-  TEST_ASSERT_FLOAT_WITHIN(   0.1f, 1000.0f, model.state.innerPid[PID_YAW].rate);
-  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.1835f, model.state.innerPid[PID_YAW].Kp);
-  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.4002f, model.state.innerPid[PID_YAW].Ki);
-  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.0030f, model.state.innerPid[PID_YAW].Kd);
-  TEST_ASSERT_FLOAT_WITHIN(0.000001f, 0.000788f, model.state.innerPid[PID_YAW].Kf);
+  TEST_ASSERT_FLOAT_WITHIN(   0.1f, 1000.0f, model.state.innerPid.rate);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.1835f, model.state.innerPid.Kp[PID_ROLL]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.4002f, model.state.innerPid.Ki[PID_ROLL]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.0030f, model.state.innerPid.Kd[PID_ROLL]);
+  TEST_ASSERT_FLOAT_WITHIN(0.000001f, 0.000788f, model.state.innerPid.Kf[PID_ROLL]);
+
+  TEST_ASSERT_FLOAT_WITHIN(   0.1f, 1000.0f, model.state.innerPid.rate);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.1835f, model.state.innerPid.Kp[PID_PITCH]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.4002f, model.state.innerPid.Ki[PID_PITCH]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.0030f, model.state.innerPid.Kd[PID_PITCH]);
+  TEST_ASSERT_FLOAT_WITHIN(0.000001f, 0.000788f, model.state.innerPid.Kf[PID_PITCH]);
+
+  TEST_ASSERT_FLOAT_WITHIN(   0.1f, 1000.0f, model.state.innerPid.rate);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.1835f, model.state.innerPid.Kp[PID_YAW]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.4002f, model.state.innerPid.Ki[PID_YAW]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.0030f, model.state.innerPid.Kd[PID_YAW]);
+  TEST_ASSERT_FLOAT_WITHIN(0.000001f, 0.000788f, model.state.innerPid.Kf[PID_YAW]);
 }
 
 void test_model_outer_pid_init()
@@ -222,22 +223,22 @@ void test_controller_rates()
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, controller.calculateSetpointRate(AXIS_ROLL, 0.0f));
   TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.76f, controller.calculateSetpointRate(AXIS_ROLL, 0.25f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.08f, controller.calculateSetpointRate(AXIS_ROLL, 0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   4.81f, controller.calculateSetpointRate(AXIS_ROLL, 0.75f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   6.95f, controller.calculateSetpointRate(AXIS_ROLL, 0.85f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  13.57f, controller.calculateSetpointRate(AXIS_ROLL, 1.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  13.57f, controller.calculateSetpointRate(AXIS_ROLL, 1.1f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.04f, controller.calculateSetpointRate(AXIS_ROLL, 0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   4.58f, controller.calculateSetpointRate(AXIS_ROLL, 0.75f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   6.49f, controller.calculateSetpointRate(AXIS_ROLL, 0.85f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  11.92f, controller.calculateSetpointRate(AXIS_ROLL, 1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  11.92f, controller.calculateSetpointRate(AXIS_ROLL, 1.1f));
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, controller.calculateSetpointRate(AXIS_PITCH,  0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -2.08f, controller.calculateSetpointRate(AXIS_PITCH, -0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f, -13.57f, controller.calculateSetpointRate(AXIS_PITCH, -1.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.08f, controller.calculateSetpointRate(AXIS_PITCH,  0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  13.57f, controller.calculateSetpointRate(AXIS_PITCH,  1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -2.04f, controller.calculateSetpointRate(AXIS_PITCH, -0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, -11.92f, controller.calculateSetpointRate(AXIS_PITCH, -1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.04f, controller.calculateSetpointRate(AXIS_PITCH,  0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  11.92f, controller.calculateSetpointRate(AXIS_PITCH,  1.0f));
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, controller.calculateSetpointRate(AXIS_YAW, 0.0f));
   TEST_ASSERT_FLOAT_WITHIN(0.01f,  -1.48f, controller.calculateSetpointRate(AXIS_YAW, 0.3f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -3.65f, controller.calculateSetpointRate(AXIS_YAW, 0.6f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -8.64f, controller.calculateSetpointRate(AXIS_YAW, 1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -3.59f, controller.calculateSetpointRate(AXIS_YAW, 0.6f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -8.29f, controller.calculateSetpointRate(AXIS_YAW, 1.0f));
 }
 
 void test_controller_rates_limit()
@@ -271,20 +272,170 @@ void test_controller_rates_limit()
   controller.begin();
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, controller.calculateSetpointRate(AXIS_ROLL, 0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.08f, controller.calculateSetpointRate(AXIS_ROLL, 0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.04f, controller.calculateSetpointRate(AXIS_ROLL, 0.5f));
   TEST_ASSERT_FLOAT_WITHIN(0.01f,   8.73f, controller.calculateSetpointRate(AXIS_ROLL, 1.0f));
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, controller.calculateSetpointRate(AXIS_PITCH,  0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.08f, controller.calculateSetpointRate(AXIS_PITCH,  0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -2.08f, controller.calculateSetpointRate(AXIS_PITCH, -0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.04f, controller.calculateSetpointRate(AXIS_PITCH,  0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -2.04f, controller.calculateSetpointRate(AXIS_PITCH, -0.5f));
   TEST_ASSERT_FLOAT_WITHIN(0.01f,   8.73f, controller.calculateSetpointRate(AXIS_PITCH,  1.0f));
   TEST_ASSERT_FLOAT_WITHIN(0.01f,  -8.73f, controller.calculateSetpointRate(AXIS_PITCH, -1.0f));
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, controller.calculateSetpointRate(AXIS_YAW, 0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -2.83f, controller.calculateSetpointRate(AXIS_YAW, 0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -2.79f, controller.calculateSetpointRate(AXIS_YAW, 0.5f));
   TEST_ASSERT_FLOAT_WITHIN(0.01f,  -6.98f, controller.calculateSetpointRate(AXIS_YAW, 1.0f));
 }
 
+void test_model_angle_from_quaternion()
+{
+  Model model;
+  model.state.angleQ = VectorFloat(0.3f, -0.2f, 1.0f).eulerToQuaternion();
+
+  const VectorFloat angle = model.getAngle();
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f,  0.3f, angle.x);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, -0.2f, angle.y);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f,  1.0f, angle.z);
+
+  const VectorFloat up = model.getUpVector();
+  const VectorFloat ref = VectorFloat(0.f, 0.f, 1.f).getRotated(model.state.angleQ.getConjugate());
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, ref.x, up.x);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, ref.y, up.y);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, ref.z, up.z);
+
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f,  0.3f, Controller::getRoll(up));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, -0.2f, Controller::getPitch(up));
+}
+
+void test_fusion_complementary_converge()
+{
+  Model model;
+  model.state.gyroClock = 1000;
+  model.config.gyroDlpf = GYRO_DLPF_256;
+  model.config.loopSync = 1;
+  model.config.mixerSync = 1;
+  model.config.accelDev = GYRO_AUTO;
+  model.config.fusion.mode = FUSION_COMPLEMENTARY;
+  model.state.accelPresent = true;
+  model.begin();
+
+  Fusion fusion(model);
+  fusion.begin();
+
+  // static tilt, accel points up in body frame
+  const VectorFloat expected(0.4f, -0.3f, 0.f);
+  model.state.accel = VectorFloat(0.f, 0.f, ACCEL_G).getRotated(expected.eulerToQuaternion().getConjugate());
+  model.state.gyro = VectorFloat();
+  for(size_t i = 0; i < 5000; i++) fusion.update();
+
+  // only tilt is observable from accel
+  const VectorFloat up = model.getUpVector();
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, expected.x, Controller::getRoll(up));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, expected.y, Controller::getPitch(up));
+}
+
+void test_controller_attitude_error()
+{
+  // attitude reached, any heading
+  const Quaternion q = Quaternion(cosf(1.f), 0.f, 0.f, sinf(1.f)) * Controller::getTiltQuaternion(0.3f, -0.2f);
+  VectorFloat e = Controller::getAttitudeError(q, Controller::getDesiredAttitude(q, 0.3f, -0.2f));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.f, e.x);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.f, e.y);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.f, e.z);
+
+  // from level, error equals requested angle
+  const Quaternion level;
+  e = Controller::getAttitudeError(level, Controller::getDesiredAttitude(level, 0.4f, 0.f));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.4f, e.x);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.f, e.y);
+  e = Controller::getAttitudeError(level, Controller::getDesiredAttitude(level, 0.f, -0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.f, e.x);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, -0.5f, e.y);
+
+  // small angles close to euler difference
+  const Quaternion tilted = VectorFloat(0.1f, -0.05f, 1.f).eulerToQuaternion();
+  e = Controller::getAttitudeError(tilted, Controller::getDesiredAttitude(tilted, 0.3f, 0.2f));
+  TEST_ASSERT_FLOAT_WITHIN(0.02f, 0.2f, e.x);
+  TEST_ASSERT_FLOAT_WITHIN(0.02f, 0.25f, e.y);
+
+  // nearly inverted, rolls back the short way without pitch coupling
+  const Quaternion inverted = VectorFloat(radians(170), 0.f, 0.5f).eulerToQuaternion();
+  e = Controller::getAttitudeError(inverted, Controller::getDesiredAttitude(inverted, 0.f, 0.f));
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, -radians(170), e.x);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 0.f, e.y);
+}
+
+void test_controller_horizon_blend()
+{
+  Model model;
+  model.state.gyroClock = 1000;
+  model.config.gyroDlpf = GYRO_DLPF_256;
+  model.config.loopSync = 1;
+  model.config.mixerSync = 1;
+  model.config.mixerType = MIXER_QUADX;
+  model.config.horizonLimitSticks = 80;
+  model.begin();
+
+  Controller controller(model);
+  controller.begin();
+  model.state.modeMask = 1 << MODE_HORIZON;
+  model.state.angleQ = VectorFloat(0.2f, 0.f, 0.f).eulerToQuaternion();
+
+  // center stick levels
+  model.state.input[AXIS_ROLL] = 0.f;
+  for(size_t i = 0; i < 200; i++) controller.outerLoop(); // settle pterm filter
+  const float level = model.state.outerPid[AXIS_ROLL].Kp * -0.2f;
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, level, model.state.desiredRate[AXIS_ROLL]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.f, model.state.desiredRate[AXIS_PITCH]);
+
+  // past stick limit pure rate
+  model.state.input[AXIS_ROLL] = 0.9f;
+  for(size_t i = 0; i < 200; i++) controller.outerLoop();
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, controller.calculateSetpointRate(AXIS_ROLL, 0.9f), model.state.desiredRate[AXIS_ROLL]);
+
+  // half way blended
+  model.state.input[AXIS_ROLL] = 0.4f;
+  for(size_t i = 0; i < 200; i++) controller.outerLoop();
+  const float angle = model.state.outerPid[AXIS_ROLL].Kp * (0.4f * radians(model.config.angleLimit) - 0.2f);
+  const float rate = controller.calculateSetpointRate(AXIS_ROLL, 0.4f);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 0.5f * (angle + rate), model.state.desiredRate[AXIS_ROLL]);
+}
+
+void test_controller_level_dterm_fterm()
+{
+  Model model;
+  model.state.gyroClock = 1000;
+  model.config.gyroDlpf = GYRO_DLPF_256;
+  model.config.loopSync = 1;
+  model.config.mixerSync = 1;
+  model.config.mixerType = MIXER_QUADX;
+  model.config.pid[PID_LEVEL] = { .P = 0, .I = 0, .D = 10, .F = 10 };
+  model.begin();
+
+  Controller controller(model);
+  controller.begin();
+  model.state.modeMask = 1 << MODE_ANGLE;
+  model.state.angleQ = VectorFloat(0.2f, 0.f, 0.f).eulerToQuaternion();
+  model.state.input[AXIS_ROLL] = 0.f;
+  for(size_t i = 0; i < 10; i++) controller.outerLoop();
+  const Pid& pid = model.state.outerPid[AXIS_ROLL];
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.f, pid.dTerm);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.f, pid.fTerm);
+
+  // attitude change damped by dterm, no fterm
+  model.state.angleQ = VectorFloat(0.2001f, 0.f, 0.f).eulerToQuaternion();
+  controller.outerLoop();
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, -pid.Kd * 0.0001f * pid.rate, pid.dTerm);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.f, pid.fTerm);
+
+  // stick change drives fterm, no dterm
+  controller.outerLoop();
+  model.state.input[AXIS_ROLL] = 0.01f;
+  controller.outerLoop();
+  const float step = 0.01f * radians(model.config.angleLimit);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 0.f, pid.dTerm);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, pid.Kf * step * pid.rate, pid.fTerm);
+}
+
 void test_rates_betaflight()
 {
   InputConfig config;
@@ -299,18 +450,18 @@ void test_rates_betaflight()
   rates.begin(config);
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, rates.getSetpoint(AXIS_ROLL, 0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.08f, rates.getSetpoint(AXIS_ROLL, 0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  13.57f, rates.getSetpoint(AXIS_ROLL, 1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.04f, rates.getSetpoint(AXIS_ROLL, 0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  11.92f, rates.getSetpoint(AXIS_ROLL, 1.0f));
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, rates.getSetpoint(AXIS_PITCH,  0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.08f, rates.getSetpoint(AXIS_PITCH,  0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -2.08f, rates.getSetpoint(AXIS_PITCH, -0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  13.57f, rates.getSetpoint(AXIS_PITCH,  1.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f, -13.57f, rates.getSetpoint(AXIS_PITCH, -1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.04f, rates.getSetpoint(AXIS_PITCH,  0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -2.04f, rates.getSetpoint(AXIS_PITCH, -0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  11.92f, rates.getSetpoint(AXIS_PITCH,  1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, -11.92f, rates.getSetpoint(AXIS_PITCH, -1.0f));
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, rates.getSetpoint(AXIS_YAW, 0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.08f, rates.getSetpoint(AXIS_YAW, 0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  13.57f, rates.getSetpoint(AXIS_YAW, 1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.04f, rates.getSetpoint(AXIS_YAW, 0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  11.92f, rates.getSetpoint(AXIS_YAW, 1.0f));
 }
 
 void test_rates_betaflight_expo()
@@ -327,16 +478,16 @@ void test_rates_betaflight_expo()
   rates.begin(config);
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, rates.getSetpoint(AXIS_ROLL, 0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.26f, rates.getSetpoint(AXIS_ROLL, 0.1f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.57f, rates.getSetpoint(AXIS_ROLL, 0.2f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.95f, rates.getSetpoint(AXIS_ROLL, 0.3f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.40f, rates.getSetpoint(AXIS_ROLL, 0.4f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.98f, rates.getSetpoint(AXIS_ROLL, 0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.73f, rates.getSetpoint(AXIS_ROLL, 0.6f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   3.78f, rates.getSetpoint(AXIS_ROLL, 0.7f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   5.37f, rates.getSetpoint(AXIS_ROLL, 0.8f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   8.10f, rates.getSetpoint(AXIS_ROLL, 0.9f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  13.51f, rates.getSetpoint(AXIS_ROLL, 1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.24f, rates.getSetpoint(AXIS_ROLL, 0.1f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.52f, rates.getSetpoint(AXIS_ROLL, 0.2f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.87f, rates.getSetpoint(AXIS_ROLL, 0.3f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.30f, rates.getSetpoint(AXIS_ROLL, 0.4f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.86f, rates.getSetpoint(AXIS_ROLL, 0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.60f, rates.getSetpoint(AXIS_ROLL, 0.6f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   3.63f, rates.getSetpoint(AXIS_ROLL, 0.7f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   5.16f, rates.getSetpoint(AXIS_ROLL, 0.8f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   7.64f, rates.getSetpoint(AXIS_ROLL, 0.9f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  11.90f, rates.getSetpoint(AXIS_ROLL, 1.0f));
 }
 
 void test_rates_raceflight()
@@ -353,16 +504,16 @@ void test_rates_raceflight()
   rates.begin(config);
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, rates.getSetpoint(AXIS_ROLL, 0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.59f, rates.getSetpoint(AXIS_ROLL, 0.2f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.46f, rates.getSetpoint(AXIS_ROLL, 0.4f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.08f, rates.getSetpoint(AXIS_ROLL, 0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.90f, rates.getSetpoint(AXIS_ROLL, 0.6f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   5.75f, rates.getSetpoint(AXIS_ROLL, 0.8f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  13.57f, rates.getSetpoint(AXIS_ROLL, 1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.83f, rates.getSetpoint(AXIS_ROLL, 0.2f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   6.45f, rates.getSetpoint(AXIS_ROLL, 0.4f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   8.55f, rates.getSetpoint(AXIS_ROLL, 0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  10.85f, rates.getSetpoint(AXIS_ROLL, 0.6f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  16.03f, rates.getSetpoint(AXIS_ROLL, 0.8f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  21.83f, rates.getSetpoint(AXIS_ROLL, 1.0f));
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, rates.getSetpoint(AXIS_ROLL,  0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -2.08f, rates.getSetpoint(AXIS_ROLL, -0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f, -13.57f, rates.getSetpoint(AXIS_ROLL, -1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -8.55f, rates.getSetpoint(AXIS_ROLL, -0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, -21.83f, rates.getSetpoint(AXIS_ROLL, -1.0f));
 }
 
 void test_rates_raceflight_expo()
@@ -379,16 +530,16 @@ void test_rates_raceflight_expo()
   rates.begin(config);
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, rates.getSetpoint(AXIS_ROLL, 0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.56f, rates.getSetpoint(AXIS_ROLL, 0.2f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.35f, rates.getSetpoint(AXIS_ROLL, 0.4f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.88f, rates.getSetpoint(AXIS_ROLL, 0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.58f, rates.getSetpoint(AXIS_ROLL, 0.6f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   5.04f, rates.getSetpoint(AXIS_ROLL, 0.8f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  13.44f, rates.getSetpoint(AXIS_ROLL, 1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.29f, rates.getSetpoint(AXIS_ROLL, 0.2f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   5.37f, rates.getSetpoint(AXIS_ROLL, 0.4f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   7.27f, rates.getSetpoint(AXIS_ROLL, 0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   9.46f, rates.getSetpoint(AXIS_ROLL, 0.6f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  14.88f, rates.getSetpoint(AXIS_ROLL, 0.8f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  21.79f, rates.getSetpoint(AXIS_ROLL, 1.0f));
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, rates.getSetpoint(AXIS_ROLL,  0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -1.88f, rates.getSetpoint(AXIS_ROLL, -0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f, -13.44f, rates.getSetpoint(AXIS_ROLL, -1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -7.27f, rates.getSetpoint(AXIS_ROLL, -0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, -21.79f, rates.getSetpoint(AXIS_ROLL, -1.0f));
 
 }
 
@@ -406,16 +557,16 @@ void test_rates_kiss()
   rates.begin(config);
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, rates.getSetpoint(AXIS_ROLL, 0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.59f, rates.getSetpoint(AXIS_ROLL, 0.2f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.46f, rates.getSetpoint(AXIS_ROLL, 0.4f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.08f, rates.getSetpoint(AXIS_ROLL, 0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.90f, rates.getSetpoint(AXIS_ROLL, 0.6f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   5.75f, rates.getSetpoint(AXIS_ROLL, 0.8f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  13.57f, rates.getSetpoint(AXIS_ROLL, 1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.58f, rates.getSetpoint(AXIS_ROLL, 0.2f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.44f, rates.getSetpoint(AXIS_ROLL, 0.4f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.04f, rates.getSetpoint(AXIS_ROLL, 0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.82f, rates.getSetpoint(AXIS_ROLL, 0.6f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   5.43f, rates.getSetpoint(AXIS_ROLL, 0.8f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  11.92f, rates.getSetpoint(AXIS_ROLL, 1.0f));
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, rates.getSetpoint(AXIS_ROLL,  0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -2.08f, rates.getSetpoint(AXIS_ROLL, -0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f, -13.57f, rates.getSetpoint(AXIS_ROLL, -1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -2.04f, rates.getSetpoint(AXIS_ROLL, -0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, -11.92f, rates.getSetpoint(AXIS_ROLL, -1.0f));
 }
 
 void test_rates_kiss_expo()
@@ -432,16 +583,16 @@ void test_rates_kiss_expo()
   rates.begin(config);
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, rates.getSetpoint(AXIS_ROLL, 0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.56f, rates.getSetpoint(AXIS_ROLL, 0.2f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.35f, rates.getSetpoint(AXIS_ROLL, 0.4f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.88f, rates.getSetpoint(AXIS_ROLL, 0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.58f, rates.getSetpoint(AXIS_ROLL, 0.6f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   0.47f, rates.getSetpoint(AXIS_ROLL, 0.2f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.20f, rates.getSetpoint(AXIS_ROLL, 0.4f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   1.73f, rates.getSetpoint(AXIS_ROLL, 0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,   2.46f, rates.getSetpoint(AXIS_ROLL, 0.6f));
   TEST_ASSERT_FLOAT_WITHIN(0.01f,   5.04f, rates.getSetpoint(AXIS_ROLL, 0.8f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  13.45f, rates.getSetpoint(AXIS_ROLL, 1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  11.89f, rates.getSetpoint(AXIS_ROLL, 1.0f));
 
   TEST_ASSERT_FLOAT_WITHIN(0.01f,    0.0f, rates.getSetpoint(AXIS_ROLL,  0.0f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -1.88f, rates.getSetpoint(AXIS_ROLL, -0.5f));
-  TEST_ASSERT_FLOAT_WITHIN(0.01f, -13.45f, rates.getSetpoint(AXIS_ROLL, -1.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f,  -1.73f, rates.getSetpoint(AXIS_ROLL, -0.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, -11.89f, rates.getSetpoint(AXIS_ROLL, -1.0f));
 }
 
 void test_actuator_arming_gyro_motor_calbration()
@@ -501,6 +652,319 @@ void test_actuator_arming_throttle()
   TEST_ASSERT_EQUAL_UINT32(ARMING_DISABLED_THROTTLE, model.state.armingDisabledFlags);
 }
 
+// rule walk the matrix is compiled from, without output limits and airmode
+static void mixReference(Model& model, Output::Mixer& mixer, const MixerConfig& config, float * outputs)
+{
+  float sources[MIXER_SOURCE_MAX] = {
+    0.f, model.state.output[AXIS_ROLL], model.state.output[AXIS_PITCH], -model.state.output[AXIS_YAW], model.state.output[AXIS_THRUST],
+    model.state.input[AXIS_ROLL], model.state.input[AXIS_PITCH], model.state.input[AXIS_YAW], model.state.input[AXIS_THRUST],
+    model.state.input[AXIS_AUX_1], model.state.input[AXIS_AUX_1 + 1], model.state.input[AXIS_AUX_1 + 2],
+  };
+  float yaw[OUTPUT_CHANNELS];
+  for(size_t i = 0; i < OUTPUT_CHANNELS; i++) outputs[i] = yaw[i] = 0.f;
+  for(const MixerEntry * e = config.mixes; e != config.mixes + MIXER_RULE_MAX && e->src != MIXER_SOURCE_NULL; e++)
+  {
+    if(e->dst >= config.count) continue;
+    if(e->src == MIXER_SOURCE_ROLL || e->src == MIXER_SOURCE_PITCH) outputs[e->dst] += sources[e->src] * (e->rate * 0.01f);
+    else if(e->src == MIXER_SOURCE_YAW) yaw[e->dst] += sources[e->src] * (e->rate * 0.01f);
+  }
+  float thrust = mixer.limitThrust(sources[MIXER_SOURCE_THRUST], THROTTLE_LIMIT_TYPE_NONE, 100);
+  for(size_t i = 0; i < config.count; i++) outputs[i] += yaw[i];
+  for(const MixerEntry * e = config.mixes; e != config.mixes + MIXER_RULE_MAX && e->src != MIXER_SOURCE_NULL; e++)
+  {
+    if(e->dst >= config.count) continue;
+    if(e->src == MIXER_SOURCE_THRUST) outputs[e->dst] += thrust * (e->rate * 0.01f);
+    else if(e->src > MIXER_SOURCE_THRUST && e->src < MIXER_SOURCE_MAX) outputs[e->dst] += sources[e->src] * (e->rate * 0.01f);
+  }
+}
+
+void test_mixer_matrix_matches_rules()
+{
+  Model model;
+  model.config.output.throttleLimitType = THROTTLE_LIMIT_TYPE_NONE;
+  model.config.output.motorLimit = 100;
+  model.state.modeMask = 0; // saturation resolver is covered by its own tests
+  Output::Mixer mixer(model);
+
+  MixerEntry customMixes[] = {
+    MixerEntry(MIXER_SOURCE_ROLL, 0, 100), MixerEntry(MIXER_SOURCE_ROLL, 0, -30), MixerEntry(MIXER_SOURCE_PITCH, 1, 80),
+    MixerEntry(MIXER_SOURCE_THRUST, 0, 100), MixerEntry(MIXER_SOURCE_THRUST, 1, 100), MixerEntry(MIXER_SOURCE_RC_AUX2, 2, 50),
+    MixerEntry(MIXER_SOURCE_RC_YAW, 3, -100), MixerEntry(MIXER_SOURCE_YAW, 9, 100), MixerEntry(),
+    MixerEntry(MIXER_SOURCE_ROLL, 1, 100), // past terminator
+  };
+  MixerConfig custom(4, customMixes);
+
+  for(int type = 0; type <= MIXER_QUADX_1234; type++)
+  {
+    const MixerConfig config = type == MIXER_CUSTOM ? custom : Output::Mixers::getMixer((MixerType)type, custom);
+    if(config.count > OUTPUT_CHANNELS) continue;
+    Output::MixerMatrix matrix;
+    matrix.compile(config);
+
+    for(size_t n = 0; n < 40; n++)
+    {
+      for(size_t i = 0; i <= AXIS_THRUST; i++) model.state.output[i] = 0.9f * sinf(n * 0.7f + i);
+      for(size_t i = 0; i < AXIS_COUNT; i++) model.state.input[i] = 0.8f * cosf(n * 0.3f + i);
+
+      float expected[OUTPUT_CHANNELS], outputs[OUTPUT_CHANNELS];
+      mixReference(model, mixer, config, expected);
+      mixer.updateMixer(matrix, outputs);
+      for(size_t i = 0; i < OUTPUT_CHANNELS; i++)
+      {
+        TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected[i], outputs[i]);
+      }
+    }
+  }
+}
+
+void test_mixer_matrix_rebuilt_on_reload()
+{
+  Model model;
+  model.state.gyroClock = 1000;
+  model.config.gyroDlpf = GYRO_DLPF_256;
+  model.config.loopSync = 1;
+  model.config.mixerSync = 1;
+  model.config.mixerType = MIXER_CUSTOM;
+  model.config.customMixerCount = 2;
+  model.config.customMixes[0] = MixerEntry(MIXER_SOURCE_THRUST, 0, 100);
+  model.config.customMixes[1] = MixerEntry(MIXER_SOURCE_THRUST, 1, 100);
+  model.config.customMixes[2] = MixerEntry();
+  model.begin();
+  TEST_ASSERT_EQUAL_UINT32(2, model.state.mixerMatrix.count);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.f, model.state.mixerMatrix.m[1][MIXER_SOURCE_THRUST]);
+
+  model.config.customMixes[1] = MixerEntry(MIXER_SOURCE_THRUST, 1, 50);
+  model.reload();
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.5f, model.state.mixerMatrix.m[1][MIXER_SOURCE_THRUST]);
+}
+
+void test_mixer_saturation_yaw_first()
+{
+  Model model;
+  Output::Mixer mixer(model);
+  const float rp[4]  = {  0.6f, -0.6f,  0.2f, -0.2f };
+  const float yaw[4] = {  0.8f,  0.8f, -0.8f, -0.8f };
+  float out[4];
+  uint8_t flags;
+
+  // fits, nothing changed
+  const float yawSmall[4] = { 0.1f, 0.1f, -0.1f, -0.1f };
+  flags = 0;
+  for(size_t i = 0; i < 4; i++) out[i] = rp[i];
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.1f, mixer.resolveSaturation(out, yawSmall, 4, 0.1f, 0.3f, flags));
+  TEST_ASSERT_EQUAL_UINT8(0, flags);
+  for(size_t i = 0; i < 4; i++) TEST_ASSERT_FLOAT_WITHIN(1e-6f, rp[i] + yawSmall[i], out[i]);
+
+  // yaw limited, roll and pitch kept
+  flags = 0;
+  for(size_t i = 0; i < 4; i++) out[i] = rp[i];
+  const float thrust = mixer.resolveSaturation(out, yaw, 4, 0.f, 0.3f, flags);
+  TEST_ASSERT_EQUAL_UINT8(MIXER_SATURATION_YAW | MIXER_SATURATION_THRUST, flags);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, -0.2f, thrust);
+  const float yawScale = (out[0] - rp[0]) / yaw[0];
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.75f, yawScale); // (2 - 0.8) / 1.6
+  for(size_t i = 0; i < 4; i++)
+  {
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, rp[i] + yaw[i] * yawScale, out[i]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, out[i] + thrust, Math::clamp(out[i] + thrust, -1.f, 1.f));
+  }
+
+  // yaw at minimum, all scaled together
+  flags = 0;
+  for(size_t i = 0; i < 4; i++) out[i] = rp[i];
+  mixer.resolveSaturation(out, yaw, 4, 0.f, 0.9f, flags);
+  TEST_ASSERT_EQUAL_UINT8(MIXER_SATURATION_YAW | MIXER_SATURATION_RP | MIXER_SATURATION_THRUST, flags);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 2.f, out[0] - out[3]);
+
+  // roll and pitch alone saturated, yaw dropped
+  const float rpBig[4] = { 1.5f, -1.5f, 0.5f, -0.5f };
+  flags = 0;
+  for(size_t i = 0; i < 4; i++) out[i] = rpBig[i];
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.f, mixer.resolveSaturation(out, yaw, 4, 0.5f, 0.3f, flags));
+  TEST_ASSERT_EQUAL_UINT8(MIXER_SATURATION_RP | MIXER_SATURATION_YAW | MIXER_SATURATION_THRUST, flags);
+  for(size_t i = 0; i < 4; i++) TEST_ASSERT_FLOAT_WITHIN(1e-5f, rpBig[i] / 1.5f, out[i]);
+}
+
+void test_mixer_saturation_thrust()
+{
+  Model model;
+  Output::Mixer mixer(model);
+  const float rp[4]  = { 0.3f, -0.3f, 0.1f, -0.1f };
+  const float yaw[4] = { 0.f, 0.f, 0.f, 0.f };
+  float out[4];
+  uint8_t flags = 0;
+
+  // high thrust lowered, low thrust raised, asymmetric mix uses all room
+  for(size_t i = 0; i < 4; i++) out[i] = rp[i];
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.7f, mixer.resolveSaturation(out, yaw, 4, 0.9f, 0.3f, flags));
+  TEST_ASSERT_EQUAL_UINT8(MIXER_SATURATION_THRUST, flags);
+  for(size_t i = 0; i < 4; i++) out[i] = rp[i];
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, -0.7f, mixer.resolveSaturation(out, yaw, 4, -1.f, 0.3f, flags));
+
+  const float rpUp[4] = { 0.4f, 0.2f, 0.2f, 0.f };
+  flags = 0;
+  for(size_t i = 0; i < 4; i++) out[i] = rpUp[i];
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.6f, mixer.resolveSaturation(out, yaw, 4, 1.f, 0.3f, flags));
+  for(size_t i = 0; i < 4; i++) out[i] = rpUp[i];
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, -1.f, mixer.resolveSaturation(out, yaw, 4, -1.f, 0.3f, flags));
+}
+
+void test_mixer_saturation_debug()
+{
+  Model model;
+  model.config.debugMode = DEBUG_MIXER_SATURATION;
+  model.config.output.throttleLimitType = THROTTLE_LIMIT_TYPE_NONE;
+  model.config.output.motorLimit = 100;
+  Output::Mixer mixer(model);
+  Output::MixerMatrix matrix;
+  matrix.compile(Output::Mixers::getMixer(MIXER_QUADX, model.state.customMixer));
+  float outputs[OUTPUT_CHANNELS];
+
+  model.state.output[AXIS_ROLL] = 0.8f;
+  model.state.output[AXIS_PITCH] = 0.f;
+  model.state.output[AXIS_YAW] = 0.5f;
+  model.state.output[AXIS_THRUST] = 0.9f;
+  model.state.modeMask = 1 << MODE_AIRMODE;
+  mixer.updateMixer(matrix, outputs);
+  TEST_ASSERT_TRUE(model.state.debug[0] & MIXER_SATURATION_YAW);
+  TEST_ASSERT_EQUAL_INT16(900, model.state.debug[1]);
+  TEST_ASSERT_TRUE(model.state.debug[2] < 900);
+
+  // no stale values once airmode is off
+  model.state.modeMask = 0;
+  mixer.updateMixer(matrix, outputs);
+  TEST_ASSERT_EQUAL_INT16(0, model.state.debug[0]);
+  TEST_ASSERT_EQUAL_INT16(0, model.state.debug[1]);
+  TEST_ASSERT_EQUAL_INT16(0, model.state.debug[2]);
+}
+
+void test_mixer_thrust_linearization()
+{
+  Model model;
+  model.config.output.thrustLinear = 0;
+  Output::Mixer mixer(model);
+  mixer.begin();
+
+  // linear by default
+  for(float v = -1.f; v <= 1.f; v += 0.1f)
+  {
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, v, mixer.motorOutput(v));
+  }
+
+  // command produces requested thrust through quadratic model
+  model.config.output.thrustLinear = 40;
+  mixer.begin();
+  const float k = 0.4f;
+  for(float t = 0.f; t <= 1.f; t += 0.05f)
+  {
+    const float u = mixer.linearizeThrust(t);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, t, (1.f - k) * u + k * u * u);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, -1.f, mixer.motorOutput(-1.f));
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f,  1.f, mixer.motorOutput( 1.f));
+  TEST_ASSERT_GREATER_THAN(0.f, mixer.motorOutput(0.f)); // low end raised
+}
+
+void test_mixer_vbat_sag_compensation()
+{
+  Model model;
+  model.config.vbatCellFull = 42;
+  model.config.output.vbatSagCompensation = 100;
+  model.state.battery.cells = 4;
+  Output::Mixer mixer(model);
+
+  // no battery
+  model.state.battery.voltage = 0;
+  model.state.battery.vbat = 0.f;
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.f, mixer.getSagFactor());
+
+  // full pack
+  model.state.battery.voltage = 168;
+  model.state.battery.vbat = 16.8f;
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.f, mixer.getSagFactor());
+
+  // sagged pack, full and half compensation
+  model.state.battery.voltage = 148;
+  model.state.battery.vbat = 14.8f;
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 4.2f / 3.7f, mixer.getSagFactor());
+  model.config.output.vbatSagCompensation = 50;
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1.f + 0.5f * (4.2f / 3.7f - 1.f), mixer.getSagFactor());
+
+  // boost applied to motor commands, u' = g * u
+  model.config.output.vbatSagCompensation = 100;
+  model.config.output.throttleLimitType = THROTTLE_LIMIT_TYPE_NONE;
+  model.config.output.motorLimit = 100;
+  const float g = mixer.getSagFactor();
+  Output::MixerMatrix matrix;
+  matrix.compile(Output::Mixers::getMixer(MIXER_QUADX, model.state.customMixer));
+  float outputs[OUTPUT_CHANNELS];
+  model.state.output[AXIS_ROLL] = 0.1f;
+  model.state.output[AXIS_PITCH] = 0.f;
+  model.state.output[AXIS_YAW] = 0.f;
+  model.state.output[AXIS_THRUST] = 0.f;
+  mixer.updateMixer(matrix, outputs);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, (0.5f - 0.05f) * g * 2.f - 1.f, outputs[0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, (0.5f + 0.05f) * g * 2.f - 1.f, outputs[2]);
+
+  // at high throttle in airmode roll differential survives, thrust gives way
+  model.state.modeMask = 1 << MODE_AIRMODE;
+  model.state.output[AXIS_THRUST] = 0.9f;
+  mixer.updateMixer(matrix, outputs);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.2f * g, outputs[2] - outputs[0]);
+  for(size_t i = 0; i < 4; i++)
+  {
+    TEST_ASSERT_TRUE(outputs[i] <= 1.f + 1e-5f);
+  }
+}
+
+void test_mixer_vbat_sag_thrust_linear()
+{
+  Model model;
+  model.config.vbatCellFull = 42;
+  model.config.output.thrustLinear = 100;
+  model.config.output.throttleLimitType = THROTTLE_LIMIT_TYPE_NONE;
+  model.config.output.motorLimit = 100;
+  model.state.battery.cells = 4;
+  model.state.battery.voltage = 148;
+  model.state.battery.vbat = 14.8f;
+  Output::Mixer mixer(model);
+  mixer.begin();
+
+  MixerEntry mixes[] = {
+    MixerEntry(MIXER_SOURCE_THRUST, 0, 100), MixerEntry(MIXER_SOURCE_ROLL, 0, 20),
+    MixerEntry(MIXER_SOURCE_THRUST, 1, 100), MixerEntry(MIXER_SOURCE_ROLL, 1, -20),
+    MixerEntry(MIXER_SOURCE_THRUST, 2, 100), MixerEntry(),
+  };
+  model.config.output.channel[2].servo = true;
+  Output::MixerMatrix matrix;
+  matrix.compile(MixerConfig(3, mixes));
+  model.state.output[AXIS_ROLL] = 0.1f;
+  model.state.output[AXIS_PITCH] = 0.f;
+  model.state.output[AXIS_YAW] = 0.f;
+
+  for(float t = -0.6f; t <= 0.31f; t += 0.3f) // below saturation
+  {
+    model.state.output[AXIS_THRUST] = t;
+    float plain[OUTPUT_CHANNELS], boosted[OUTPUT_CHANNELS];
+    model.config.output.vbatSagCompensation = 0;
+    mixer.updateMixer(matrix, plain);
+    const float u0 = (mixer.motorOutput(plain[0]) + 1.f) * 0.5f;
+    const float u1 = (mixer.motorOutput(plain[1]) + 1.f) * 0.5f;
+
+    model.config.output.vbatSagCompensation = 100;
+    mixer.updateMixer(matrix, boosted);
+    const float g = mixer.getSagFactor();
+    TEST_ASSERT_TRUE(g > 1.1f);
+
+    // esc command ratio equals sag gain with thrust linearization on
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, g * u0, (mixer.motorOutput(boosted[0]) + 1.f) * 0.5f);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, g * u1, (mixer.motorOutput(boosted[1]) + 1.f) * 0.5f);
+
+    // servo thrust not boosted
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, plain[2], boosted[2]);
+  }
+}
+
 void test_mixer_throttle_limit_none()
 {
   Model model;
@@ -618,6 +1082,268 @@ void test_mixer_output_limit_servo()
   TEST_ASSERT_FLOAT_WITHIN(0.001f,  0.8f, mixer.limitOutput( 1.0f, servo, 80));
 }
 
+// reference curves [deg/s], written after betaflight rc rates
+static float rateReference(int type, float rate, float expo, float superRate, float x)
+{
+  x = Math::clamp(x, -0.995f, 0.995f);
+  const float a = std::abs(x);
+  switch(type)
+  {
+    case RATES_TYPE_BETAFLIGHT:
+    {
+      const float e = expo / 100.f;
+      const float c = x * a * a * a * e + x * (1.f - e);
+      float rc = rate / 100.f;
+      if(rc > 2.f) rc += 14.54f * (rc - 2.f);
+      return 200.f * rc * c / Math::clamp(1.f - a * superRate / 100.f, 0.01f, 1.f);
+    }
+    case RATES_TYPE_RACEFLIGHT:
+    {
+      const float c = (1.f + 0.01f * expo * (x * x - 1.f)) * x;
+      return 10.f * rate * c * (1.f + a * superRate * 0.01f);
+    }
+    case RATES_TYPE_KISS:
+    {
+      const float e = expo / 100.f;
+      const float c = (x * x * x * e + x * (1.f - e)) * rate / 1000.f;
+      return Math::clamp(2000.f * c / Math::clamp(1.f - a * superRate / 100.f, 0.01f, 1.f), -1998.f, 1998.f);
+    }
+    case RATES_TYPE_ACTUAL:
+    {
+      const float e = expo / 100.f;
+      const float center = rate * 10.f;
+      const float curve = a * (std::pow(x, 5.f) * e + x * (1.f - e));
+      return x * center + std::max(0.f, superRate * 10.f - center) * curve;
+    }
+    case RATES_TYPE_QUICK:
+    {
+      const float rc = rate * 2.f;
+      const float maxRate = std::max(superRate * 10.f, rc);
+      const float e = expo / 100.f;
+      const float curve = a * a * a * e + a * (1.f - e);
+      const float factor = (maxRate - rc) / maxRate;
+      return Math::clamp(x * rc / Math::clamp(1.f - curve * factor, 0.01f, 1.f), -1998.f, 1998.f);
+    }
+  }
+  return 0.f;
+}
+
+void test_rates_curves_reference()
+{
+  const uint8_t params[][3] = {
+    // rate, expo, super
+    {  70,   0,  80 },
+    {  70,  20,  80 },
+    { 120,  50,  70 },
+    {  20,  30,  67 },
+    { 100,  80, 100 },
+  };
+  for(int type = RATES_TYPE_BETAFLIGHT; type <= RATES_TYPE_QUICK; type++)
+  {
+    for(const auto& p: params)
+    {
+      InputConfig config;
+      config.rateType = type;
+      for(size_t axis = 0; axis < 3; axis++)
+      {
+        config.rate[axis] = p[0];
+        config.expo[axis] = p[1];
+        config.superRate[axis] = p[2];
+        config.rateLimit[axis] = axis == AXIS_YAW ? 500 : 1998;
+      }
+
+      Rates rates;
+      rates.begin(config);
+
+      for(size_t axis = 0; axis < 3; axis++)
+      {
+        for(float x = -1.1f; x <= 1.1f; x += 0.001f)
+        {
+          const float limit = config.rateLimit[axis];
+          const float expected = Math::toRad(Math::clamp(rateReference(type, p[0], p[1], p[2], x), -limit, limit));
+          TEST_ASSERT_FLOAT_WITHIN(0.0001f, expected, rates.calculateSetpoint(axis, x));
+          // table is exact at nodes, steep super rate ends are the worst case between them
+          TEST_ASSERT_FLOAT_WITHIN(0.03f * std::abs(expected) + 0.005f, expected, rates.getSetpoint(axis, x));
+        }
+      }
+    }
+  }
+}
+
+void test_feedforward_frame_speed()
+{
+  Feedforward ff;
+  ff.begin(FEEDFORWARD_AVERAGING_OFF, 0, 0);
+
+  // 250Hz frames, setpoint ramps 0.1 rad/s per frame
+  for(size_t n = 1; n <= 10; n++)
+  {
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 25.f, ff.update(0.1f * n, 20, 0.004f));
+  }
+
+  // 2 point averaging halves the first step
+  ff.begin(FEEDFORWARD_AVERAGING_2_POINT, 0, 0);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 12.5f, ff.update(0.1f, 20, 0.004f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 25.f, ff.update(0.2f, 20, 0.004f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 25.f, ff.value());
+
+  // boost adds setpoint acceleration, constant speed is not boosted
+  ff.begin(FEEDFORWARD_AVERAGING_OFF, 15, 0);
+  ff.update(0.1f, 20, 0.004f);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 25.f, ff.update(0.2f, 20, 0.004f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, -25.f * 250.f * 0.01f * 0.015f, ff.update(0.2f, 20, 0.004f));
+}
+
+void test_feedforward_jitter_and_duplicate()
+{
+  Feedforward ff;
+  ff.begin(FEEDFORWARD_AVERAGING_OFF, 0, 7);
+
+  // small stick change is attenuated, larger passes through
+  TEST_ASSERT_LESS_THAN(0.3f * 2.5f, ff.update(0.01f, 2, 0.004f));
+  ff.reset();
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 25.f, ff.update(0.1f, 10, 0.004f));
+
+  // repeated frame while moving holds speed once, then drops
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 25.f, ff.update(0.2f, 10, 0.004f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 25.f, ff.update(0.2f, 0, 0.004f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.f, ff.update(0.2f, 0, 0.004f));
+}
+
+static void feedforwardFrame(Model& model, Controller& controller, int16_t us)
+{
+  model.state.inputBufferPrevious[AXIS_ROLL] = model.state.inputBuffer[AXIS_ROLL];
+  model.state.inputBuffer[AXIS_ROLL] = us;
+  model.state.inputFrameTime = model.state.loopTimer.last;
+  model.state.inputFrameCount++;
+  controller.updateFeedforward();
+}
+
+void test_feedforward_stale_frames()
+{
+  Model model;
+  model.state.gyroClock = 1000;
+  model.config.gyroDlpf = GYRO_DLPF_256;
+  model.config.loopSync = 1;
+  model.config.mixerSync = 1;
+  model.config.mixerType = MIXER_QUADX;
+  model.begin();
+
+  Controller controller(model);
+  controller.begin();
+  model.state.inputFrameDelta = 4000;
+  model.state.loopTimer.last = 100000;
+
+  model.state.inputBuffer[AXIS_ROLL] = 1500;
+  feedforwardFrame(model, controller, 1550);
+  feedforwardFrame(model, controller, 1600);
+  const float speed = model.state.innerPid.feedforward[AXIS_ROLL];
+  TEST_ASSERT_TRUE(speed > 0.f);
+
+  // held between frames
+  model.state.loopTimer.last += 6000;
+  controller.updateFeedforward();
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, speed, model.state.innerPid.feedforward[AXIS_ROLL]);
+
+  // frames stopped
+  model.state.loopTimer.last += 3000;
+  controller.updateFeedforward();
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.f, model.state.innerPid.feedforward[AXIS_ROLL]);
+
+  // first frame after gap is only a reference, no spike
+  feedforwardFrame(model, controller, 1700);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.f, model.state.innerPid.feedforward[AXIS_ROLL]);
+  feedforwardFrame(model, controller, 1750);
+  TEST_ASSERT_TRUE(model.state.innerPid.feedforward[AXIS_ROLL] > 0.f);
+
+  // rx loss
+  model.state.inputRxLoss = true;
+  feedforwardFrame(model, controller, 1800);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.f, model.state.innerPid.feedforward[AXIS_ROLL]);
+}
+
+void test_tpa_legacy_breakpoint()
+{
+  Model model;
+  model.config.tpaScale = 10;
+  model.config.tpaBreakpoint = 1650;
+
+  Tpa tpa;
+  tpa.begin(model.config);
+
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.0f, tpa.getFactor(1000.f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.0f, tpa.getFactor(1625.f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.9f, tpa.getFactor(2000.f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.9f, tpa.getFactor(2100.f));
+  // table node spacing is 62.5us, breakpoint falls between nodes
+  TEST_ASSERT_FLOAT_WITHIN(0.002f, 1.f - 0.1f * 175.f / 350.f, tpa.getFactor(1825.f));
+}
+
+void test_tpa_rebuilt_on_reload()
+{
+  Model model;
+  model.state.gyroClock = 1000;
+  model.config.gyroDlpf = GYRO_DLPF_256;
+  model.config.loopSync = 1;
+  model.config.mixerSync = 1;
+  model.config.tpaScale = 0;
+  model.begin();
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.0f, model.state.tpa.getFactor(2000.f));
+
+  model.config.tpaScale = 20;
+  model.config.tpaBreakpoint = 1500;
+  model.reload();
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.8f, model.state.tpa.getFactor(2000.f));
+}
+
+void test_tpa_curve_axis_weights()
+{
+  Model model;
+  model.config.tpaScale = 0;
+  const uint8_t curve[] = { 130, 110, 100, 90, 60 };
+  for(size_t i = 0; i < TPA_CURVE_POINTS; i++) model.config.tpaCurve[i] = curve[i];
+  model.config.tpaP[AXIS_ROLL] = 100; model.config.tpaD[AXIS_ROLL] = 100;
+  model.config.tpaP[AXIS_PITCH] = 50; model.config.tpaD[AXIS_PITCH] = 100;
+  model.config.tpaP[AXIS_YAW] = 0;    model.config.tpaD[AXIS_YAW] = 0;
+
+  Tpa tpa;
+  tpa.begin(model.config);
+
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.3f, tpa.getFactor(1000.f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.2f, tpa.getFactor(1125.f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.0f, tpa.getFactor(1500.f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.75f, tpa.getFactor(1875.f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.6f, tpa.getFactor(2000.f));
+
+  float p[3], d[3];
+  tpa.update(2000.f, p, d);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.6f, p[AXIS_ROLL]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.6f, d[AXIS_ROLL]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.8f, p[AXIS_PITCH]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.6f, d[AXIS_PITCH]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.0f, p[AXIS_YAW]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.0f, d[AXIS_YAW]);
+}
+
+void test_tpa_curve_limits()
+{
+  // cli accepts up to 255, table is limited the same way as msp
+  Model model;
+  model.config.tpaScale = 0;
+  for(size_t i = 0; i < TPA_CURVE_POINTS; i++) model.config.tpaCurve[i] = 255;
+  for(size_t i = 0; i <= AXIS_YAW; i++) model.config.tpaP[i] = model.config.tpaD[i] = 255;
+
+  Tpa tpa;
+  tpa.begin(model.config);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.0f, tpa.getFactor(1000.f));
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.0f, tpa.getFactor(2000.f));
+
+  float p[3], d[3];
+  tpa.update(1500.f, p, d);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.0f, p[AXIS_ROLL]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.0f, d[AXIS_YAW]);
+}
+
 int main(int argc, char **argv)
 {
   UNITY_BEGIN();
@@ -632,15 +1358,36 @@ int main(int argc, char **argv)
   RUN_TEST(test_model_outer_pid_init);
   RUN_TEST(test_controller_rates);
   RUN_TEST(test_controller_rates_limit);
+  RUN_TEST(test_model_angle_from_quaternion);
+  RUN_TEST(test_fusion_complementary_converge);
+  RUN_TEST(test_controller_attitude_error);
+  RUN_TEST(test_controller_horizon_blend);
+  RUN_TEST(test_controller_level_dterm_fterm);
   RUN_TEST(test_rates_betaflight);
   RUN_TEST(test_rates_betaflight_expo);
   RUN_TEST(test_rates_raceflight);
   RUN_TEST(test_rates_raceflight_expo);
   RUN_TEST(test_rates_kiss);
   RUN_TEST(test_rates_kiss_expo);
+  RUN_TEST(test_rates_curves_reference);
+  RUN_TEST(test_feedforward_frame_speed);
+  RUN_TEST(test_feedforward_jitter_and_duplicate);
+  RUN_TEST(test_feedforward_stale_frames);
+  RUN_TEST(test_tpa_legacy_breakpoint);
+  RUN_TEST(test_tpa_curve_axis_weights);
+  RUN_TEST(test_tpa_curve_limits);
+  RUN_TEST(test_tpa_rebuilt_on_reload);
   RUN_TEST(test_actuator_arming_gyro_motor_calbration);
   RUN_TEST(test_actuator_arming_failsafe);
   RUN_TEST(test_actuator_arming_throttle);
+  RUN_TEST(test_mixer_matrix_matches_rules);
+  RUN_TEST(test_mixer_matrix_rebuilt_on_reload);
+  RUN_TEST(test_mixer_saturation_yaw_first);
+  RUN_TEST(test_mixer_saturation_thrust);
+  RUN_TEST(test_mixer_saturation_debug);
+  RUN_TEST(test_mixer_thrust_linearization);
+  RUN_TEST(test_mixer_vbat_sag_compensation);
+  RUN_TEST(test_mixer_vbat_sag_thrust_linear);
   RUN_TEST(test_mixer_throttle_limit_none);
   RUN_TEST(test_mixer_throttle_limit_scale);
   RUN_TEST(test_mixer_throttle_limit_clip);
@@ -0,0 +1,368 @@
+#include <unity.h>
+#include <ArduinoFake.h>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include "Model.h"
+#include "Fusion.h"
+
+using namespace fakeit;
+using namespace Espfc;
+
+// Synthetic trajectories are fed to each fusion mode, attitude is compared with truth.
+// Results are printed as a table, asserts only guard against regressions of main modes.
+
+struct Truth
+{
+  VectorFloat euler;  // attitude [rad]
+  VectorFloat accel;  // linear acceleration in earth frame [m/s^2]
+};
+
+struct Scenario
+{
+  const char * name;
+  float duration;     // [s]
+  float settle;       // error before this time is excluded from rms [s]
+  std::function<Truth(float)> truth;
+  VectorFloat accelBias;
+  float vibration;    // accel vibration amplitude [m/s^2]
+  bool mag;
+  std::function<VectorFloat(float)> magDisturbance;
+};
+
+struct Result
+{
+  float tiltRms;      // [deg]
+  float tiltMax;      // [deg]
+  float headingRms;   // [deg], total attitude error, only with mag
+  float convergence;  // time when tilt error stays below 2 deg [s]
+  float cost;         // net fusion update time [ns]
+};
+
+static const VectorFloat EARTH_FIELD(0.25f, 0.f, -0.4f);
+
+static uint32_t seed = 1;
+
+static float noise(float amp)
+{
+  seed = seed * 1664525u + 1013904223u;
+  return ((seed >> 8) / 16777216.f - 0.5f) * 2.f * amp;
+}
+
+static VectorFloat upVector(const Quaternion& q)
+{
+  return VectorFloat(0.f, 0.f, 1.f).getRotated(q.getConjugate());
+}
+
+// scale invariant, quaternions are normalized with approximate invSqrt
+static float angleBetween(const Quaternion& a, const Quaternion& b)
+{
+  const Quaternion e = a.getConjugate() * b;
+  return 2.f * atan2f(sqrtf(e.x * e.x + e.y * e.y + e.z * e.z), std::abs(e.w));
+}
+
+static float angleBetween(const VectorFloat& a, const VectorFloat& b)
+{
+  return atan2f(VectorFloat::crossProduct(a, b).getMagnitude(), VectorFloat::dotProduct(a, b));
+}
+
+// body rate that rotates a into b during dt
+static VectorFloat bodyRate(const Quaternion& a, const Quaternion& b, float dt)
+{
+  Quaternion d = a.getConjugate() * b;
+  if(d.w < 0.f) d = d * -1.f;
+  const float s = sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+  if(s < 1e-9f) return VectorFloat();
+  const float k = 2.f * atan2f(s, d.w) / (s * dt);
+  return VectorFloat(d.x * k, d.y * k, d.z * k);
+}
+
+static Result run(const Scenario& s, FusionMode mode)
+{
+  Model model;
+  model.state.gyroClock = 1000;
+  model.config.gyroDlpf = GYRO_DLPF_256;
+  model.config.loopSync = 1;
+  model.config.mixerSync = 1;
+  model.config.accelDev = GYRO_AUTO;
+  model.config.magDev = s.mag ? MAG_HMC5883 : MAG_NONE;
+  model.config.fusion.mode = mode;
+  model.state.accelPresent = true;
+  model.state.magPresent = s.mag;
+  model.state.magRate = 75;
+  model.begin();
+
+  Fusion fusion(model);
+  fusion.begin();
+  fusion.restoreGain();
+
+  seed = 1;
+  const float dt = model.state.accelTimer.intervalf;
+  const size_t steps = s.duration / dt;
+  double tiltSum = 0, headingSum = 0, cost = 0;
+  size_t count = 0;
+  float tiltMax = 0, convergence = 0;
+
+  Quaternion q = s.truth(0.f).euler.eulerToQuaternion();
+  for(size_t i = 0; i < steps; i++)
+  {
+    const float t = i * dt;
+    const Truth next = s.truth(t + dt);
+    const Quaternion qn = next.euler.eulerToQuaternion();
+
+    // gyro measures mean rate over the step, sensors are sampled at its end
+    const VectorFloat rate = bodyRate(q, qn, dt);
+    const float vib = 2.f * PI * 173.f * t;
+    VectorFloat gyro(rate.x + noise(0.005f), rate.y + noise(0.005f), rate.z + noise(0.005f));
+    gyro += VectorFloat(sinf(vib), cosf(vib * 1.1f), sinf(vib * 0.9f)) * (s.vibration * 0.05f);
+
+    VectorFloat force = next.accel;
+    force.z += ACCEL_G;
+    VectorFloat accel = force.getRotated(qn.getConjugate());
+    accel += s.accelBias;
+    accel += VectorFloat(sinf(vib * 1.3f), cosf(vib), sinf(vib * 0.7f)) * s.vibration;
+    accel += VectorFloat(noise(0.1f), noise(0.1f), noise(0.1f));
+
+    model.state.gyro = gyro;
+    model.state.gyroImu = gyro;
+    model.state.accel = accel;
+    if(s.mag)
+    {
+      VectorFloat mag = EARTH_FIELD.getRotated(qn.getConjugate());
+      if(s.magDisturbance) mag += s.magDisturbance(t);
+      model.state.mag = mag;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    fusion.update();
+    cost += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    q = qn;
+
+    const float tilt = degrees(angleBetween(upVector(qn), upVector(model.state.angleQ)));
+    if(tilt > 2.f) convergence = t + dt;
+    if(t < s.settle) continue;
+    tiltSum += tilt * tilt;
+    const float heading = degrees(angleBetween(qn, model.state.angleQ));
+    headingSum += heading * heading;
+    tiltMax = std::max(tiltMax, tilt);
+    count++;
+  }
+
+  Result r;
+  r.tiltRms = sqrt(tiltSum / count);
+  r.tiltMax = tiltMax;
+  r.headingRms = s.mag ? sqrt(headingSum / count) : 0.f;
+  r.convergence = convergence;
+  r.cost = cost / steps;
+  return r;
+}
+
+static const FusionMode MODES[] = {
+  FUSION_MADGWICK, FUSION_MAHONY, FUSION_COMPLEMENTARY, FUSION_KALMAN,
+  FUSION_RTQF, FUSION_SIMPLE, FUSION_EXPERIMENTAL, FUSION_EKF,
+}; // LERP does not publish attitude
+
+static Result results[FUSION_MAX];
+
+static void benchmark(const Scenario& s)
+{
+  const Result base = run(s, FUSION_NONE);
+  printf("\n%s\n", s.name);
+  printf("  %-14s %9s %9s %9s %8s %8s\n", "mode", "tilt rms", "tilt max", "att rms", "conv", "cost");
+  for(FusionMode mode: MODES)
+  {
+    Result r = run(s, mode);
+    r.cost = std::max(0.f, r.cost - base.cost);
+    results[mode] = r;
+    printf("  %-14s %7.2f d %7.2f d %7.2f d %6.2f s %5.0f ns\n",
+      FusionConfig::getModeName(mode), r.tiltRms, r.tiltMax, r.headingRms, r.convergence, r.cost);
+  }
+}
+
+void setUp(void)
+{
+  When(Method(ArduinoFake(), micros)).AlwaysReturn(0);
+}
+
+void test_fusion_static_tilt()
+{
+  Scenario s;
+  s.name = "static tilt, starts level";
+  s.duration = 20.f;
+  s.settle = 10.f;
+  s.truth = [](float t) {
+    return Truth{ VectorFloat(radians(20.f), radians(-15.f), radians(30.f)), VectorFloat() };
+  };
+  s.vibration = 0.f;
+  s.mag = false;
+  benchmark(s);
+
+  TEST_ASSERT_FLOAT_WITHIN(1.f, 0.f, results[FUSION_MADGWICK].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(3.f, 0.f, results[FUSION_MAHONY].tiltRms); // slow integral term
+  TEST_ASSERT_FLOAT_WITHIN(1.f, 0.f, results[FUSION_COMPLEMENTARY].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(1.f, 0.f, results[FUSION_EKF].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 0.f, results[FUSION_EKF].convergence); // starts from accel
+}
+
+void test_fusion_rotation()
+{
+  Scenario s;
+  s.name = "rotation, roll/pitch swings with yaw spin";
+  s.duration = 20.f;
+  s.settle = 2.f;
+  s.truth = [](float t) {
+    return Truth{ VectorFloat(0.8f * sinf(1.7f * t), 0.6f * sinf(2.3f * t + 0.5f), 1.5f * t), VectorFloat() };
+  };
+  s.vibration = 0.f;
+  s.mag = false;
+  benchmark(s);
+
+  TEST_ASSERT_FLOAT_WITHIN(1.5f, 0.f, results[FUSION_MADGWICK].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(3.f, 0.f, results[FUSION_MAHONY].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(1.5f, 0.f, results[FUSION_COMPLEMENTARY].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(1.5f, 0.f, results[FUSION_RTQF].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(1.5f, 0.f, results[FUSION_EKF].tiltRms);
+}
+
+void test_fusion_coordinated_turn()
+{
+  // yaw rate ramps in over 2s, bank follows so that specific force stays on body z
+  // accel only estimators cannot tell centripetal acceleration from gravity and drift
+  // towards level, bank is ~37 deg, only divergence beyond it is checked
+  Scenario s;
+  s.name = "coordinated turn, 15m/s, 0.5rad/s";
+  s.duration = 20.f;
+  s.settle = 0.f;
+  s.truth = [](float t) {
+    const float v = 15.f, w = 0.5f, T = 2.f;
+    const float rate = w * std::min(t / T, 1.f);
+    const float yaw = t < T ? w * t * t / (2.f * T) : w * (t - T * 0.5f);
+    const float a = v * rate;
+    return Truth{ VectorFloat(-atan2f(a, ACCEL_G), 0.f, yaw), VectorFloat(-a * sinf(yaw), a * cosf(yaw), 0.f) };
+  };
+  s.vibration = 0.f;
+  s.mag = false;
+  benchmark(s);
+
+  TEST_ASSERT_FLOAT_WITHIN(50.f, 0.f, results[FUSION_MADGWICK].tiltMax);
+  TEST_ASSERT_FLOAT_WITHIN(50.f, 0.f, results[FUSION_MAHONY].tiltMax);
+  TEST_ASSERT_FLOAT_WITHIN(50.f, 0.f, results[FUSION_EKF].tiltMax);
+}
+
+void test_fusion_vibration()
+{
+  Scenario s;
+  s.name = "hover with 1g vibration at 173Hz";
+  s.duration = 20.f;
+  s.settle = 2.f;
+  s.truth = [](float t) {
+    return Truth{ VectorFloat(0.1f * sinf(0.5f * t), 0.1f * cosf(0.7f * t), 0.f), VectorFloat() };
+  };
+  s.vibration = ACCEL_G;
+  s.mag = false;
+  benchmark(s);
+
+  TEST_ASSERT_FLOAT_WITHIN(2.f, 0.f, results[FUSION_MADGWICK].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(5.f, 0.f, results[FUSION_MAHONY].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(5.f, 0.f, results[FUSION_COMPLEMENTARY].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(5.f, 0.f, results[FUSION_EKF].tiltRms);
+}
+
+void test_fusion_accel_bias()
+{
+  // 0.5m/s^2 horizontal bias is ~3 deg of tilt error for any accel based estimator
+  Scenario s;
+  s.name = "accel bias 0.4, -0.3, 0.2 m/s^2";
+  s.duration = 20.f;
+  s.settle = 5.f;
+  s.truth = [](float t) {
+    return Truth{ VectorFloat(0.2f * sinf(0.5f * t), 0.2f * cosf(0.3f * t), 0.2f * t), VectorFloat() };
+  };
+  s.accelBias = VectorFloat(0.4f, -0.3f, 0.2f);
+  s.vibration = 0.f;
+  s.mag = false;
+  benchmark(s);
+
+  TEST_ASSERT_FLOAT_WITHIN(4.f, 0.f, results[FUSION_MADGWICK].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(4.f, 0.f, results[FUSION_MAHONY].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(4.f, 0.f, results[FUSION_COMPLEMENTARY].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(4.f, 0.f, results[FUSION_EKF].tiltRms);
+}
+
+void test_fusion_mag_disturbance()
+{
+  Scenario s;
+  s.name = "mag, slow yaw, disturbance from 10s to 15s";
+  s.duration = 25.f;
+  s.settle = 5.f;
+  s.truth = [](float t) {
+    return Truth{ VectorFloat(0.15f * sinf(0.4f * t), 0.1f, 0.3f * t), VectorFloat() };
+  };
+  s.vibration = 0.f;
+  s.mag = true;
+  s.magDisturbance = [](float t) {
+    return t >= 10.f && t < 15.f ? VectorFloat(0.15f, 0.1f, 0.f) : VectorFloat();
+  };
+  benchmark(s);
+
+  // mag must not tilt the estimate, heading follows disturbance for a while
+  TEST_ASSERT_FLOAT_WITHIN(3.f, 0.f, results[FUSION_MADGWICK].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(6.f, 0.f, results[FUSION_MAHONY].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(1.f, 0.f, results[FUSION_EKF].tiltRms);
+  TEST_ASSERT_FLOAT_WITHIN(25.f, 0.f, results[FUSION_MADGWICK].headingRms);
+  TEST_ASSERT_FLOAT_WITHIN(25.f, 0.f, results[FUSION_EKF].headingRms);
+}
+
+void test_fusion_ekf_mag_transient()
+{
+  // mag runs slower than fusion, the same sample is corrected against on every accel update,
+  // a short field transient must not drag heading with it
+  Model model;
+  model.state.gyroClock = 1000;
+  model.config.gyroDlpf = GYRO_DLPF_256;
+  model.config.loopSync = 1;
+  model.config.mixerSync = 1;
+  model.config.accelDev = GYRO_AUTO;
+  model.config.magDev = MAG_HMC5883;
+  model.config.fusion.mode = FUSION_EKF;
+  model.state.accelPresent = true;
+  model.state.magPresent = true;
+  model.state.magRate = 75;
+  model.begin();
+
+  Fusion fusion(model);
+  fusion.begin();
+  fusion.restoreGain();
+
+  const float dt = model.state.accelTimer.intervalf;
+  const Quaternion disturbed = VectorFloat(0.f, 0.f, radians(60.f)).eulerToQuaternion();
+  float headingMax = 0.f;
+  for(size_t i = 0; i < (size_t)(6.f / dt); i++)
+  {
+    const float t = i * dt;
+    model.state.gyro = VectorFloat();
+    model.state.gyroImu = VectorFloat();
+    model.state.accel = VectorFloat(0.f, 0.f, ACCEL_G);
+    model.state.mag = t >= 5.f && t < 5.1f ? EARTH_FIELD.getRotated(disturbed) : EARTH_FIELD;
+    fusion.update();
+    if(t >= 5.f) headingMax = std::max(headingMax, (float)degrees(angleBetween(Quaternion(), model.state.angleQ)));
+  }
+  printf("\nekf heading after 100ms mag transient %.2f d\n", headingMax);
+  TEST_ASSERT_FLOAT_WITHIN(5.f, 0.f, headingMax);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_fusion_static_tilt);
+  RUN_TEST(test_fusion_rotation);
+  RUN_TEST(test_fusion_coordinated_turn);
+  RUN_TEST(test_fusion_vibration);
+  RUN_TEST(test_fusion_accel_bias);
+  RUN_TEST(test_fusion_mag_disturbance);
+  RUN_TEST(test_fusion_ekf_mag_transient);
+  UNITY_END();
+
+  return 0;
+}
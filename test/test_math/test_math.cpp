@@ -1,9 +1,18 @@
 #include <unity.h>
 #include <EspGpio.h>
 #include "Math/Utils.h"
+#include "Math/Cic.h"
+#include "Math/Welford.h"
+#include "Math/SixPointCalibration.h"
+#include "Math/EllipsoidFit.h"
+#include "Math/AltitudeKalman.h"
+#include "Math/AttitudeEkf.h"
 #include "helper_3dmath.h"
+#include "Madgwick.h"
+#include "Mahony.h"
 #include "Filter.h"
 #include "Pid.h"
+#include "Control/PidBank.h"
 
 // void setUp(void) {
 // // set stuff up here
@@ -805,6 +814,600 @@ void test_pid_update_sum_limit()
     TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.0f, result);
 }
 
+void test_pid_bank_matches_pid()
+{
+    const float gains[3][4] = {
+      { 0.2f, 1.4f, 0.003f, 0.0008f },
+      { 0.3f, 1.0f, 0.004f, 0.0f },
+      { 0.2f, 2.0f, 0.0f,   0.0005f },
+    };
+    Pid pid[3];
+    PidBank bank;
+    bank.rate = 1000.f;
+    for(size_t i = 0; i < 3; i++)
+    {
+      ensure(pid[i], 1000.f);
+      gain(pid[i], gains[i][0], gains[i][1], gains[i][2], gains[i][3]);
+      bank.Kp[i] = gains[i][0];
+      bank.Ki[i] = gains[i][1];
+      bank.Kd[i] = gains[i][2];
+      bank.Kf[i] = gains[i][3];
+      bank.iLimit[i] = pid[i].iLimit;
+      bank.oLimit[i] = pid[i].oLimit;
+
+      const FilterConfig notch(FILTER_NOTCH, 200, 150), lpf(FILTER_PT1, 100), lpf2(FILTER_BIQUAD, 150), ff(FILTER_PT2, 50);
+      pid[i].dtermNotchFilter.begin(notch, 1000);
+      pid[i].dtermFilter.begin(lpf, 1000);
+      pid[i].dtermFilter2.begin(lpf2, 1000);
+      pid[i].ftermFilter.begin(ff, 1000);
+      bank.dtermNotchFilter[i].begin(notch, 1000);
+      bank.dtermFilter[i].begin(lpf, 1000);
+      bank.dtermFilter2[i].begin(lpf2, 1000);
+      bank.ftermFilter[i].begin(ff, 1000);
+      pid[i].begin();
+    }
+    // yaw only pterm filter, mixed filter types in one stage
+    pid[2].ptermFilter.begin(FilterConfig(FILTER_PT1, 90), 1000);
+    bank.ptermFilter[2].begin(FilterConfig(FILTER_PT1, 90), 1000);
+    bank.begin();
+
+    for(size_t n = 0; n < 600; n++)
+    {
+      // term switched off and back on, filter state must be kept the same way
+      const float dScale = n >= 200 && n < 300 ? 0.f : 1.f;
+      pid[1].dScale = bank.dScale[1] = dScale;
+
+      float setpoint[3], measure[3], output[3];
+      for(size_t i = 0; i < 3; i++)
+      {
+        setpoint[i] = 0.5f * sinf(n * 0.01f * (i + 1));
+        measure[i] = 0.4f * sinf(n * 0.01f * (i + 1) - 0.2f) + 0.02f * sinf(n * 1.3f);
+      }
+      bank.update(setpoint, measure, output);
+
+      for(size_t i = 0; i < 3; i++)
+      {
+        TEST_ASSERT_FLOAT_WITHIN(1e-6f, pid[i].update(setpoint[i], measure[i]), output[i]);
+        TEST_ASSERT_FLOAT_WITHIN(1e-6f, pid[i].pTerm, bank.pTerm[i]);
+        TEST_ASSERT_FLOAT_WITHIN(1e-6f, pid[i].iTerm, bank.iTerm[i]);
+        TEST_ASSERT_FLOAT_WITHIN(1e-6f, pid[i].dTerm, bank.dTerm[i]);
+        TEST_ASSERT_FLOAT_WITHIN(1e-6f, pid[i].fTerm, bank.fTerm[i]);
+      }
+    }
+
+    // single axis path
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, pid[1].update(0.1f, -0.1f), bank.update(1, 0.1f, -0.1f));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, pid[1].dTerm, bank.dTerm[1]);
+}
+
+void test_pid_bank_iterm_relax()
+{
+    PidBank bank;
+    bank.rate = 1000.f;
+    for(size_t i = 0; i < 3; i++)
+    {
+      bank.Ki[i] = 1.f;
+      bank.iLimit[i] = 10.f;
+      bank.itermRelaxFilter[i].begin(FilterConfig(FILTER_PT1, 15), 1000);
+    }
+    bank.itermRelaxMask = (1u << 0); // roll only
+    bank.begin();
+
+    // fast stick move, roll integration is suppressed, pitch is not
+    const float setpoint[3] = { 1.f, 1.f, 0.f };
+    const float measure[3] = { 0.f, 0.f, 0.f };
+    float output[3];
+    bank.update(setpoint, measure, output);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.f, bank.itermRelaxFactor[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.f, bank.iTerm[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.001f, bank.iTerm[1]);
+
+    // steady setpoint, both axes integrate at the same rate
+    for(size_t n = 0; n < 1000; n++) bank.update(setpoint, measure, output);
+    const float roll = bank.iTerm[0], pitch = bank.iTerm[1];
+    bank.update(setpoint, measure, output);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1.f, bank.itermRelaxFactor[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, bank.iTerm[1] - pitch, bank.iTerm[0] - roll);
+    TEST_ASSERT_LESS_THAN(bank.iTerm[1], bank.iTerm[0]);
+}
+
+void test_pid_bank_anti_gravity()
+{
+    PidBank bank;
+    bank.rate = 1000.f;
+    for(size_t i = 0; i < 3; i++)
+    {
+      bank.Ki[i] = 1.f;
+      bank.iLimit[i] = 10.f;
+    }
+    bank.antiGravityMask = (1u << 0) | (1u << 1);
+    bank.antiGravityGain = 8.f;
+    bank.antiGravityFilter.begin(FilterConfig(FILTER_PT2, 5), 1000);
+    bank.begin();
+
+    const float setpoint[3] = { 0.1f, 0.1f, 0.1f };
+    const float measure[3] = { 0.f, 0.f, 0.f };
+    float output[3];
+
+    // steady throttle, no boost
+    for(size_t n = 0; n < 1000; n++)
+    {
+      bank.updateAntiGravity(0.3f);
+      bank.update(setpoint, measure, output);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 1.f, bank.iBoost);
+
+    // throttle chop, roll and pitch integrate faster than yaw
+    float maxBoost = 1.f;
+    for(size_t n = 0; n < 200; n++)
+    {
+      bank.updateAntiGravity(n < 50 ? 0.3f - n * 0.006f : 0.f);
+      bank.update(setpoint, measure, output);
+      maxBoost = std::max(maxBoost, bank.iBoost);
+    }
+    TEST_ASSERT_GREATER_THAN(2.f, maxBoost);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, bank.iTerm[0], bank.iTerm[1]);
+    TEST_ASSERT_GREATER_THAN(bank.iTerm[2] * 1.2f, bank.iTerm[0]);
+
+    // boost decays once throttle settles
+    for(size_t n = 0; n < 2000; n++) bank.updateAntiGravity(0.f);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 1.f, bank.iBoost);
+}
+
+void test_pid_bank_d_min()
+{
+    PidBank bank;
+    bank.rate = 1000.f;
+    for(size_t i = 0; i < 3; i++)
+    {
+      bank.Kd[i] = 0.01f;
+      bank.dMinRangeFilter[i].begin(FilterConfig(FILTER_PT2, DMIN_RANGE_HZ), 1000);
+      bank.dMinFilter[i].begin(FilterConfig(FILTER_PT2, DMIN_LOWPASS_HZ), 1000);
+    }
+    bank.dMinPercent[0] = 0.5f;
+    bank.dMinMask = (1u << 0); // roll only
+    bank.dMinGyroGain = Math::toDeg(37 * DMIN_GAIN_FACTOR / DMIN_LOWPASS_HZ);
+    bank.dMinSetpointGain = Math::toDeg(37 * DMIN_SETPOINT_GAIN_FACTOR * 20 * 1000.f / (100 * DMIN_LOWPASS_HZ));
+    bank.begin();
+
+    float setpoint[3] = { 0.f, 0.f, 0.f };
+    float measure[3], output[3];
+
+    // slow drift, roll dterm runs at d-min
+    for(size_t n = 0; n < 500; n++)
+    {
+      measure[0] = measure[1] = 0.0005f * n;
+      bank.update(setpoint, measure, output);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.5f, bank.dMinFactor[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.5f * bank.dTerm[1], bank.dTerm[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.f, bank.dMinFactor[1]);
+
+    // gyro oscillation, boosted to full D
+    float maxFactor = 0.f;
+    for(size_t n = 0; n < 200; n++)
+    {
+      measure[0] = measure[1] = 2.f * sinf(n * 0.2f);
+      bank.update(setpoint, measure, output);
+      maxFactor = std::max(maxFactor, bank.dMinFactor[0]);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.f, maxFactor);
+
+    // settle back, then a stick move boosts too
+    for(size_t n = 0; n < 500; n++)
+    {
+      measure[0] = measure[1] = 0.f;
+      bank.update(setpoint, measure, output);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.5f, bank.dMinFactor[0]);
+    maxFactor = 0.f;
+    for(size_t n = 0; n < 50; n++)
+    {
+      setpoint[0] = 0.5f * n;
+      bank.update(setpoint, measure, output);
+      maxFactor = std::max(maxFactor, bank.dMinFactor[0]);
+    }
+    TEST_ASSERT_GREATER_THAN(0.7f, maxFactor);
+}
+
+void test_math_cic_dc_gain()
+{
+    Math::Cic cic;
+    cic.begin(3, 8);
+    float result = 0;
+    for(size_t i = 0; i < 80; i++)
+    {
+        cic.update(1000);
+        if((i + 1) % 8 == 0) result = cic.decimate();
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1000.f, result);
+}
+
+void test_math_cic_order_ratio_limit()
+{
+    Math::Cic cic;
+    cic.begin(5, 100);
+    TEST_ASSERT_EQUAL_UINT32(ESPFC_CIC_RATIO_MAX, cic.ratio());
+
+    // full scale input must not overflow registers
+    float result = 0;
+    for(size_t i = 0; i < ESPFC_CIC_RATIO_MAX * 10; i++)
+    {
+        cic.update(-32768);
+        if((i + 1) % ESPFC_CIC_RATIO_MAX == 0) result = cic.decimate();
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, -32768.f, result);
+}
+
+void test_math_cic_off()
+{
+    Math::Cic cic;
+    cic.begin(0, 4);
+    cic.update(10);
+    cic.update(-20);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, -20.f, cic.decimate());
+}
+
+void test_math_cic_reject_nyquist()
+{
+    Math::Cic cic;
+    cic.begin(2, 4);
+    float result = 0;
+    for(size_t i = 0; i < 40; i++)
+    {
+        cic.update(i & 1 ? -1000 : 1000);
+        if((i + 1) % 4 == 0) result = cic.decimate();
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.f, result);
+}
+
+void test_math_welford_mean_variance()
+{
+    Math::Welford<float> w;
+    const float samples[] = { 2, 4, 4, 4, 5, 5, 7, 9 };
+    for(float v: samples) w.update(v);
+
+    TEST_ASSERT_EQUAL_UINT32(8, w.count());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 5.f, w.mean());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 32.f / 7.f, w.variance());
+
+    w.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, w.count());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.f, w.variance());
+}
+
+void test_math_welford_vector()
+{
+    Math::Welford<VectorFloat> w;
+    w.update(VectorFloat(1.f, 10.f, -1.f));
+    w.update(VectorFloat(3.f, 10.f, 1.f));
+
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.f, w.mean().x);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 10.f, w.mean().y);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.f, w.mean().z);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.f, w.variance().x);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.f, w.variance().y);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.f, w.variance().z);
+}
+
+static VectorFloat six_point_sample(size_t face, float g)
+{
+    // inverse gain matrix with cross-axis coupling, and offset
+    const float a[3][3] = { { 0.98f, 0.01f, -0.02f }, { 0.01f, 1.03f, 0.005f }, { -0.02f, 0.005f, 0.99f } };
+    const VectorFloat offset(0.3f, -0.2f, 0.5f);
+    VectorFloat up;
+    up.set(face / 2, face & 1 ? -g : g);
+    return VectorFloat(
+        a[0][0] * up.x + a[0][1] * up.y + a[0][2] * up.z + offset.x,
+        a[1][0] * up.x + a[1][1] * up.y + a[1][2] * up.z + offset.y,
+        a[2][0] * up.x + a[2][1] * up.y + a[2][2] * up.z + offset.z
+    );
+}
+
+void test_math_six_point_face()
+{
+    const float g = 9.80665f;
+    TEST_ASSERT_EQUAL_INT(4, Math::SixPointCalibration::face(VectorFloat(0.1f, -0.2f, 9.7f), g));
+    TEST_ASSERT_EQUAL_INT(1, Math::SixPointCalibration::face(VectorFloat(-9.9f, 0.3f, 0.2f), g));
+    TEST_ASSERT_EQUAL_INT(-1, Math::SixPointCalibration::face(VectorFloat(6.9f, 0.f, 6.9f), g));
+}
+
+void test_math_six_point_solve_cross()
+{
+    const float g = 9.80665f;
+    Math::SixPointCalibration cal;
+    VectorFloat scale, cross, bias;
+
+    for(size_t i = 0; i < 5; i++) cal.set(i, six_point_sample(i, g));
+    TEST_ASSERT_FALSE(cal.solve(g, true, scale, cross, bias));
+    cal.set(5, six_point_sample(5, g));
+    TEST_ASSERT_TRUE(cal.solve(g, true, scale, cross, bias));
+
+    for(size_t i = 0; i < 6; i++)
+    {
+        VectorFloat v = Math::SixPointCalibration::apply(scale, cross, six_point_sample(i, g));
+        v -= bias;
+        VectorFloat up;
+        up.set(i / 2, i & 1 ? -g : g);
+        TEST_ASSERT_FLOAT_WITHIN(0.001f, up.x, v.x);
+        TEST_ASSERT_FLOAT_WITHIN(0.001f, up.y, v.y);
+        TEST_ASSERT_FLOAT_WITHIN(0.001f, up.z, v.z);
+    }
+}
+
+void test_math_six_point_solve_scale()
+{
+    const float g = 9.80665f;
+    Math::SixPointCalibration cal;
+    VectorFloat scale, cross, bias;
+
+    for(size_t i = 0; i < 6; i++) cal.set(i, six_point_sample(i, g));
+    TEST_ASSERT_TRUE(cal.solve(g, false, scale, cross, bias));
+
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.f / 0.98f, scale.x);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.f / 1.03f, scale.y);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.f / 0.99f, scale.z);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.f, cross.x);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.3f / 0.98f, bias.x);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, -0.2f / 1.03f, bias.y);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.5f / 0.99f, bias.z);
+}
+
+// field direction on spiral over the sphere, distorted by rotated soft iron and shifted by hard iron
+static VectorFloat ellipsoid_sample(size_t i, size_t n, VectorFloat& dir)
+{
+    const float z = 1.f - 2.f * (i + 0.5f) / n;
+    const float r = sqrtf(1.f - z * z);
+    const float phi = i * 2.39996f;
+    dir = VectorFloat(r * cosf(phi), r * sinf(phi), z);
+
+    // R(30deg around z) * diag(1.3, 0.8, 1.1) * R', field 0.5
+    const float c = cosf(0.5236f), s = sinf(0.5236f);
+    const float d[3] = { 1.3f, 0.8f, 1.1f };
+    const float u = c * dir.x + s * dir.y, v = -s * dir.x + c * dir.y;
+    const float du = d[0] * u, dv = d[1] * v;
+    return VectorFloat(0.5f * (c * du - s * dv) + 0.12f, 0.5f * (s * du + c * dv) - 0.3f, 0.5f * d[2] * dir.z + 0.05f);
+}
+
+void test_math_ellipsoid_fit_rotated()
+{
+    Math::EllipsoidFit fit;
+    Math::EllipsoidFit::Result r;
+    VectorFloat dir;
+    const size_t n = 500;
+
+    for(size_t i = 0; i < n; i++) fit.update(ellipsoid_sample(i, n, dir));
+    TEST_ASSERT_EQUAL_UINT32(n, fit.count());
+    TEST_ASSERT_TRUE(fit.solve(r));
+
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.12f, r.offset.x);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, -0.3f, r.offset.y);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.05f, r.offset.z);
+    TEST_ASSERT_TRUE(fabsf(r.cross.x) > 0.05f);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.f, r.error);
+
+    // corrected field has constant magnitude and original direction
+    for(size_t i = 0; i < n; i += 37)
+    {
+        VectorFloat m = Math::EllipsoidFit::apply(r, ellipsoid_sample(i, n, dir));
+        TEST_ASSERT_FLOAT_WITHIN(0.001f, r.radius, m.getMagnitude());
+        m /= m.getMagnitude();
+        TEST_ASSERT_FLOAT_WITHIN(0.001f, dir.x, m.x);
+        TEST_ASSERT_FLOAT_WITHIN(0.001f, dir.y, m.y);
+        TEST_ASSERT_FLOAT_WITHIN(0.001f, dir.z, m.z);
+    }
+}
+
+void test_math_ellipsoid_fit_noise_and_sector()
+{
+    Math::EllipsoidFit fit;
+    Math::EllipsoidFit::Result r;
+    VectorFloat dir;
+    const size_t n = 400;
+
+    TEST_ASSERT_FALSE(fit.solve(r));
+    for(size_t i = 0; i < n; i++)
+    {
+        VectorFloat m = ellipsoid_sample(i, n, dir);
+        m *= 1.f + (i & 1 ? 0.01f : -0.01f);
+        fit.update(m);
+    }
+    TEST_ASSERT_TRUE(fit.solve(r));
+    TEST_ASSERT_FLOAT_WITHIN(0.003f, 0.01f, r.error);
+
+    TEST_ASSERT_EQUAL_INT(-1, Math::EllipsoidFit::sector(VectorFloat()));
+    TEST_ASSERT_EQUAL_INT(0, Math::EllipsoidFit::sector(VectorFloat(-1.f, -1.f, -1.f)));
+    TEST_ASSERT_EQUAL_INT(25, Math::EllipsoidFit::sector(VectorFloat(1.f, 1.f, 1.f)));
+    TEST_ASSERT_EQUAL_INT(13, Math::EllipsoidFit::sector(VectorFloat(0.f, 0.f, 1.f)));
+}
+
+void test_math_altitude_kalman_climb()
+{
+  Math::AltitudeKalman kalman;
+  kalman.begin(0.5f, 0.3f, 0.05f);
+  kalman.reset(10.f);
+
+  // 500Hz accel, 50Hz baro, climb accelerating 2m/s^2 from 1s to 2s
+  const float dt = 0.002f;
+  float altitude = 10.f, velocity = 0.f;
+  uint32_t seed = 1;
+  auto noise = [&seed](float amp) {
+    seed = seed * 1664525u + 1013904223u;
+    return ((seed >> 8) / 16777216.f - 0.5f) * 2.f * amp;
+  };
+  for(size_t i = 0; i < 1500; i++)
+  {
+    const float t = i * dt;
+    const float accel = t >= 1.f && t < 2.f ? 2.f : 0.f;
+    altitude += velocity * dt + 0.5f * accel * dt * dt;
+    velocity += accel * dt;
+
+    kalman.predict(accel + noise(0.3f), dt);
+    if(i % 10 == 0) kalman.correct(altitude + noise(0.3f));
+
+    if(i == 499) TEST_ASSERT_FLOAT_WITHIN(0.3f, 0.f, kalman.velocity());
+    if(i == 749) TEST_ASSERT_FLOAT_WITHIN(0.15f, 1.f, kalman.velocity()); // tracks velocity without baro lag
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.2f, velocity, kalman.velocity());
+  TEST_ASSERT_FLOAT_WITHIN(0.2f, altitude, kalman.altitude());
+}
+
+void test_math_altitude_kalman_accel_bias()
+{
+  Math::AltitudeKalman kalman;
+  kalman.begin(0.5f, 0.3f, 0.05f);
+  kalman.reset(0.f);
+
+  // hovering with biased accel, bias is learned from baro
+  for(size_t i = 0; i < 5000; i++)
+  {
+    kalman.predict(0.2f, 0.002f);
+    if(i % 10 == 0) kalman.correct(0.f);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 0.f, kalman.velocity());
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 0.f, kalman.altitude());
+  TEST_ASSERT_FLOAT_WITHIN(0.02f, 0.2f, kalman.bias());
+}
+
+static float attitudeErrorAngle(const Quaternion& a, const Quaternion& b)
+{
+  // scale invariant, quaternions are normalized with approximate invSqrt
+  const Quaternion e = a.getConjugate() * b;
+  return 2.f * atan2f(sqrtf(e.x * e.x + e.y * e.y + e.z * e.z), std::abs(e.w));
+}
+
+void test_math_attitude_ekf_rotation()
+{
+  Math::AttitudeEkf ekf;
+  ekf.begin(0.01f, 0.0005f);
+
+  // tumbling at constant body rate, exact gyro and gravity
+  const float dt = 0.002f;
+  const VectorFloat rate(0.5f, -0.3f, 1.0f);
+  Quaternion truth;
+  for(size_t i = 0; i < 2500; i++)
+  {
+    truth = (truth * Quaternion(1.f, rate.x * dt * 0.5f, rate.y * dt * 0.5f, rate.z * dt * 0.5f)).getNormalized();
+    ekf.predict(rate, dt);
+    ekf.correctAccel(VectorFloat(0.f, 0.f, 9.81f).getRotated(truth.getConjugate()), 0.1f);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.f, attitudeErrorAngle(truth, ekf.attitude()));
+}
+
+void test_math_attitude_ekf_gyro_bias()
+{
+  Math::AttitudeEkf ekf;
+  ekf.begin(0.01f, 0.0005f);
+
+  // static and tilted, biased gyro, noisy accel and mag
+  const Quaternion truth = VectorFloat(0.3f, -0.2f, 0.5f).eulerToQuaternion();
+  const VectorFloat bias(0.02f, -0.01f, 0.015f);
+  const VectorFloat gravity = VectorFloat(0.f, 0.f, 9.81f).getRotated(truth.getConjugate());
+  const VectorFloat field = VectorFloat(0.4f, 0.f, -0.3f).getRotated(truth.getConjugate());
+  uint32_t seed = 1;
+  auto noise = [&seed](float amp) {
+    seed = seed * 1664525u + 1013904223u;
+    return ((seed >> 8) / 16777216.f - 0.5f) * 2.f * amp;
+  };
+
+  ekf.reset(VectorFloat(0.3f, -0.2f, 0.f).eulerToQuaternion());
+  for(size_t i = 0; i < 30000; i++)
+  {
+    ekf.predict(VectorFloat(bias.x + noise(0.01f), bias.y + noise(0.01f), bias.z + noise(0.01f)), 0.002f);
+    ekf.correctAccel(VectorFloat(gravity.x + noise(0.3f), gravity.y + noise(0.3f), gravity.z + noise(0.3f)), 0.1f);
+    ekf.correctMag(VectorFloat(field.x + noise(0.02f), field.y + noise(0.02f), field.z + noise(0.02f)), 0.2f);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.002f, bias.x, ekf.bias().x);
+  TEST_ASSERT_FLOAT_WITHIN(0.002f, bias.y, ekf.bias().y);
+  TEST_ASSERT_FLOAT_WITHIN(0.002f, bias.z, ekf.bias().z);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.f, attitudeErrorAngle(truth, ekf.attitude()));
+}
+
+void test_math_inv_sqrt_accuracy()
+{
+  float err0 = 0.f, err1 = 0.f, err2 = 0.f;
+  for(float x = 1e-6f; x < 1e6f; x *= 1.01f)
+  {
+    const double r = 1.0 / std::sqrt((double)x);
+    err0 = std::max(err0, (float)(std::abs(invSqrtN<0>(x) - r) / r));
+    err1 = std::max(err1, (float)(std::abs(invSqrtN<1>(x) - r) / r));
+    err2 = std::max(err2, (float)(std::abs(invSqrtN<2>(x) - r) / r));
+  }
+  TEST_ASSERT_FLOAT_WITHIN(2e-7f, 0.f, err0);
+  TEST_ASSERT_FLOAT_WITHIN(2e-3f, 0.f, err1);
+  TEST_ASSERT_FLOAT_WITHIN(6e-6f, 0.f, err2);
+
+  // renormalisation after small quaternion step
+  float errNear = 0.f;
+  for(float x = 0.99f; x < 1.01f; x += 0.0001f)
+  {
+    const double r = 1.0 / std::sqrt((double)x);
+    errNear = std::max(errNear, (float)(std::abs(invSqrtNearOne(x) - r) / r));
+  }
+  TEST_ASSERT_FLOAT_WITHIN(4e-5f, 0.f, errNear);
+}
+
+template<typename T>
+static float ahrsTumblingError(bool useMag)
+{
+  T ahrs;
+  ahrs.begin(500.f);
+
+  // tumbling at constant body rate from level, exact gyro, gravity and field
+  const float dt = 0.002f;
+  const VectorFloat rate(0.5f, -0.3f, 1.0f);
+  Quaternion truth;
+  float err = 0.f;
+  for(size_t i = 0; i < 2500; i++)
+  {
+    truth = (truth * Quaternion(1.f, rate.x * dt * 0.5f, rate.y * dt * 0.5f, rate.z * dt * 0.5f)).getNormalized();
+    const VectorFloat a = VectorFloat(0.f, 0.f, 1.f).getRotated(truth.getConjugate());
+    const VectorFloat m = VectorFloat(0.4f, 0.f, -0.3f).getRotated(truth.getConjugate());
+    if(useMag) ahrs.update(rate.x, rate.y, rate.z, a.x, a.y, a.z, m.x, m.y, m.z);
+    else ahrs.update(rate.x, rate.y, rate.z, a.x, a.y, a.z);
+    err = std::max(err, attitudeErrorAngle(truth, ahrs.getQuaternion()));
+  }
+  return err;
+}
+
+template<typename T>
+static float ahrsConvergeError(bool useMag)
+{
+  T ahrs;
+  ahrs.begin(500.f);
+
+  // static, tilted and rotated, filter starts level
+  const Quaternion truth = VectorFloat(0.3f, -0.2f, 0.5f).eulerToQuaternion();
+  const VectorFloat a = VectorFloat(0.f, 0.f, 1.f).getRotated(truth.getConjugate());
+  const VectorFloat m = VectorFloat(0.4f, 0.f, -0.3f).getRotated(truth.getConjugate());
+  for(size_t i = 0; i < 10000; i++)
+  {
+    if(useMag) ahrs.update(0.f, 0.f, 0.f, a.x, a.y, a.z, m.x, m.y, m.z);
+    else ahrs.update(0.f, 0.f, 0.f, a.x, a.y, a.z);
+  }
+  if(useMag) return attitudeErrorAngle(truth, ahrs.getQuaternion());
+
+  // heading is not observable without mag, compare gravity direction
+  const VectorFloat e = VectorFloat(0.f, 0.f, 1.f).getRotated(ahrs.getQuaternion().getConjugate());
+  return acosf(std::min(VectorFloat::dotProduct(a, e), 1.f));
+}
+
+void test_math_ahrs_kernels_tracking()
+{
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, 0.f, ahrsTumblingError<Madgwick>(false));
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, 0.f, ahrsTumblingError<Madgwick>(true));
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, 0.f, ahrsTumblingError<Mahony>(false));
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, 0.f, ahrsTumblingError<Mahony>(true));
+}
+
+void test_math_ahrs_kernels_converge()
+{
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.f, ahrsConvergeError<Madgwick>(false));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.f, ahrsConvergeError<Madgwick>(true));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.f, ahrsConvergeError<Mahony>(false));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.f, ahrsConvergeError<Mahony>(true));
+}
+
 int main(int argc, char **argv)
 {
     UNITY_BEGIN();
@@ -815,6 +1418,24 @@ int main(int argc, char **argv)
     RUN_TEST(test_math_peak_detect_full);
     RUN_TEST(test_math_peak_detect_partial);
     RUN_TEST(test_math_peak_sort);
+    RUN_TEST(test_math_cic_dc_gain);
+    RUN_TEST(test_math_cic_order_ratio_limit);
+    RUN_TEST(test_math_cic_off);
+    RUN_TEST(test_math_cic_reject_nyquist);
+    RUN_TEST(test_math_welford_mean_variance);
+    RUN_TEST(test_math_welford_vector);
+    RUN_TEST(test_math_six_point_face);
+    RUN_TEST(test_math_six_point_solve_cross);
+    RUN_TEST(test_math_six_point_solve_scale);
+    RUN_TEST(test_math_ellipsoid_fit_rotated);
+    RUN_TEST(test_math_ellipsoid_fit_noise_and_sector);
+    RUN_TEST(test_math_altitude_kalman_climb);
+    RUN_TEST(test_math_altitude_kalman_accel_bias);
+    RUN_TEST(test_math_attitude_ekf_rotation);
+    RUN_TEST(test_math_attitude_ekf_gyro_bias);
+    RUN_TEST(test_math_inv_sqrt_accuracy);
+    RUN_TEST(test_math_ahrs_kernels_tracking);
+    RUN_TEST(test_math_ahrs_kernels_converge);
 
     RUN_TEST(test_vector_int16_access);
     RUN_TEST(test_vector_int16_math);
@@ -859,6 +1480,10 @@ int main(int argc, char **argv)
     RUN_TEST(test_pid_update_f);
     RUN_TEST(test_pid_update_sum);
     RUN_TEST(test_pid_update_sum_limit);
+    RUN_TEST(test_pid_bank_matches_pid);
+    RUN_TEST(test_pid_bank_iterm_relax);
+    RUN_TEST(test_pid_bank_anti_gravity);
+    RUN_TEST(test_pid_bank_d_min);
 
     UNITY_END();
 